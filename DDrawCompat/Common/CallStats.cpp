@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <sstream>
+
+#include "Common/CallStats.h"
+
+namespace
+{
+	unsigned int getHistogramBucket(unsigned long long durationNs)
+	{
+		unsigned int bucket = 0;
+		while (durationNs > 1 && bucket < Compat::CallStats::HISTOGRAM_SIZE - 1)
+		{
+			durationNs >>= 1;
+			++bucket;
+		}
+		return bucket;
+	}
+
+	std::string formatNs(unsigned long long ns)
+	{
+		std::ostringstream os;
+		os.setf(std::ios::fixed);
+		os.precision(1);
+		if (ns < 1000)
+		{
+			os << ns << " ns";
+		}
+		else if (ns < 1000000)
+		{
+			os << ns / 1000.0 << " us";
+		}
+		else
+		{
+			os << ns / 1000000.0 << " ms";
+		}
+		return os.str();
+	}
+}
+
+namespace Compat
+{
+	CallStats::CallStats(const std::string& name)
+		: m_name(name)
+		, m_callCount(0)
+		, m_sampleCount(0)
+		, m_totalSampledNs(0)
+		, m_maxSampledNs(0)
+		, m_histogram()
+		, m_next(nullptr)
+	{
+	}
+
+	void CallStats::addSample(unsigned long long durationNs)
+	{
+		++m_sampleCount;
+		m_totalSampledNs += durationNs;
+		m_maxSampledNs = std::max(m_maxSampledNs, durationNs);
+		++m_histogram[getHistogramBucket(durationNs)];
+	}
+
+	unsigned long long CallStats::getAverageNs() const
+	{
+		return 0 == m_sampleCount ? 0 : m_totalSampledNs / m_sampleCount;
+	}
+
+	unsigned long long CallStats::getPercentileNs(unsigned int percent) const
+	{
+		if (0 == m_sampleCount)
+		{
+			return 0;
+		}
+
+		const unsigned long long threshold = (m_sampleCount * percent + 99) / 100;
+		unsigned long long count = 0;
+		for (unsigned int i = 0; i < HISTOGRAM_SIZE; ++i)
+		{
+			count += m_histogram[i];
+			if (count >= threshold)
+			{
+				return i < HISTOGRAM_SIZE - 1 ? std::min((2ull << i) - 1, m_maxSampledNs) : m_maxSampledNs;
+			}
+		}
+		return m_maxSampledNs;
+	}
+
+	CallStats* CallStats::registerFunc(const std::string& name)
+	{
+		CallStats* stats = new CallStats(name);
+		stats->m_next = s_head.load();
+		while (!s_head.compare_exchange_weak(stats->m_next, stats))
+		{
+		}
+		return stats;
+	}
+
+	std::vector<std::string> CallStats::getReport()
+	{
+		std::vector<const CallStats*> calledFuncs;
+		for (const CallStats* stats = s_head.load(); stats; stats = stats->m_next)
+		{
+			if (0 != stats->m_callCount)
+			{
+				calledFuncs.push_back(stats);
+			}
+		}
+
+		std::vector<std::string> report;
+		if (calledFuncs.empty())
+		{
+			return report;
+		}
+
+		std::sort(calledFuncs.begin(), calledFuncs.end(), [](const CallStats* s1, const CallStats* s2)
+		{
+			return s1->getAverageNs() * s1->m_callCount > s2->getAverageNs() * s2->m_callCount;
+		});
+
+		std::ostringstream os;
+		os << "COM call statistics (1 in " << Config::callSamplingInterval << " calls timed):";
+		report.push_back(os.str());
+		for (auto stats : calledFuncs)
+		{
+			os.str(std::string());
+			os << "  " << stats->m_name << ": " << stats->m_callCount << " calls";
+			if (0 != stats->m_sampleCount)
+			{
+				os << ", avg " << formatNs(stats->getAverageNs())
+					<< ", p50 <= " << formatNs(stats->getPercentileNs(50))
+					<< ", p99 <= " << formatNs(stats->getPercentileNs(99));
+			}
+			report.push_back(os.str());
+		}
+		return report;
+	}
+
+	std::atomic<CallStats*> CallStats::s_head(nullptr);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "Config/Config.h"
+
+// Sampled timing statistics of hooked COM calls.
+// This file must stay free of Windows dependencies so the statistics can be tested on any platform.
+
+namespace Compat
+{
+	static_assert(0 != Config::callSamplingInterval &&
+		0 == (Config::callSamplingInterval & (Config::callSamplingInterval - 1)),
+		"Config::callSamplingInterval must be a power of 2");
+
+	class CallStats
+	{
+	public:
+		static const unsigned int HISTOGRAM_SIZE = 32;
+
+		CallStats(const std::string& name);
+
+		// Not synchronized, callers must serialize calls to the same function (e.g. with the DD thread lock)
+		bool beginCall()
+		{
+			return 0 == (++m_callCount & (Config::callSamplingInterval - 1));
+		}
+
+		void addSample(unsigned long long durationNs);
+
+		const std::string& getName() const { return m_name; }
+		unsigned long long getCallCount() const { return m_callCount; }
+		unsigned long long getSampleCount() const { return m_sampleCount; }
+		unsigned long long getAverageNs() const;
+		// Returns an inclusive upper bound of the given percentile of the sampled durations
+		unsigned long long getPercentileNs(unsigned int percent) const;
+		// Bucket i counts the durations in [2^i, 2^(i+1)), except that bucket 0 includes 0 and the last bucket
+		// includes all longer durations
+		const unsigned int* getHistogram() const { return m_histogram; }
+
+		static CallStats* registerFunc(const std::string& name);
+		// Returns the report lines of the called functions, with the most total time first
+		static std::vector<std::string> getReport();
+
+	private:
+		std::string m_name;
+		unsigned long long m_callCount;
+		unsigned long long m_sampleCount;
+		unsigned long long m_totalSampledNs;
+		unsigned long long m_maxSampledNs;
+		unsigned int m_histogram[HISTOGRAM_SIZE];
+		CallStats* m_next;
+
+		static std::atomic<CallStats*> s_head;
+	};
+}
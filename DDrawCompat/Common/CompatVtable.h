@@ -2,10 +2,11 @@
 
 #include <map>
 #include <string>
-#include <vector>
 
+#include "Common/CallStats.h"
 #include "Common/Hook.h"
 #include "Common/Log.h"
+#include "Common/Time.h"
 #include "Common/VtableVisitor.h"
 #include "DDraw/ScopedThreadLock.h"
 
@@ -55,6 +56,37 @@ public:
 	static const Vtable* s_origVtablePtr;
 
 private:
+	template <typename MemberDataPtr, MemberDataPtr ptr>
+	struct FuncCallStats
+	{
+		static Compat::CallStats* s_stats;
+	};
+
+	class ScopedCallSample
+	{
+	public:
+		ScopedCallSample(Compat::CallStats& stats)
+			: m_stats(stats)
+			, m_qpcStart(stats.beginCall() ? Time::queryPerformanceCounter() : 0)
+		{
+		}
+
+		~ScopedCallSample()
+		{
+			if (0 != m_qpcStart)
+			{
+				m_stats.addSample(Time::qpcToNs(Time::queryPerformanceCounter() - m_qpcStart));
+			}
+		}
+
+	private:
+		ScopedCallSample(const ScopedCallSample&) = delete;
+		ScopedCallSample& operator=(const ScopedCallSample&) = delete;
+
+		Compat::CallStats& m_stats;
+		long long m_qpcStart;
+	};
+
 	class DDrawHook
 	{
 	public:
@@ -86,11 +118,12 @@ private:
 		}
 
 		template <typename MemberDataPtr, MemberDataPtr ptr>
-		void visit()
+		void visit(const std::string& vtableTypeName, const std::string& funcName)
 		{
 			m_origVtable.*ptr = m_srcVtable.*ptr;
 			if (s_compatVtable.*ptr)
 			{
+				registerFunc<MemberDataPtr, ptr>(vtableTypeName, funcName);
 				Compat::hookFunction(reinterpret_cast<void*&>(m_origVtable.*ptr),
 					getThreadSafeFuncPtr<MemberDataPtr, ptr>(m_origVtable.*ptr));
 			}
@@ -100,7 +133,7 @@ private:
 		void visitDebug(const std::string& vtableTypeName, const std::string& funcName)
 		{
 			Compat::Log() << "Hooking function: " << vtableTypeName << "::" << funcName;
-			s_funcNames[getKey<MemberDataPtr, ptr>()] = vtableTypeName + "::" + funcName;
+			registerFunc<MemberDataPtr, ptr>(vtableTypeName, funcName);
 
 			m_origVtable.*ptr = m_srcVtable.*ptr;
 			Compat::hookFunction(reinterpret_cast<void*&>(m_origVtable.*ptr),
@@ -112,11 +145,13 @@ private:
 		using FuncPtr = Result(STDMETHODCALLTYPE *)(Params...);
 
 		template <typename MemberDataPtr, MemberDataPtr ptr>
-		static std::vector<unsigned char> getKey()
+		static void registerFunc(const std::string& vtableTypeName, const std::string& funcName)
 		{
-			MemberDataPtr mp = ptr;
-			unsigned char* p = reinterpret_cast<unsigned char*>(&mp);
-			return std::vector<unsigned char>(p, p + sizeof(mp));
+			Compat::CallStats*& stats = FuncCallStats<MemberDataPtr, ptr>::s_stats;
+			if (!stats)
+			{
+				stats = Compat::CallStats::registerFunc(vtableTypeName + "::" + funcName);
+			}
 		}
 
 		template <typename MemberDataPtr, MemberDataPtr ptr, typename Result, typename... Params>
@@ -135,9 +170,11 @@ private:
 			typename Result, typename FirstParam, typename... Params>
 		static Result STDMETHODCALLTYPE threadSafeFunc(FirstParam firstParam, Params... params)
 		{
-			DDraw::ScopedThreadLock lock;
+			Compat::CallStats& stats = *FuncCallStats<MemberDataPtr, ptr>::s_stats;
+			DDraw::ScopedThreadLock lock(stats.getName().c_str());
+			ScopedCallSample callSample(stats);
 #ifdef _DEBUG
-			const char* funcName = s_funcNames[getKey<MemberDataPtr, ptr>()].c_str();
+			const char* funcName = stats.getName().c_str();
 			Compat::LogEnter(funcName, firstParam, params...);
 			Result result = Hook::getCompatFunc<MemberDataPtr, ptr>(firstParam)(firstParam, params...);
 			Compat::LogLeave(funcName, firstParam, params...) << result;
@@ -150,9 +187,11 @@ private:
 		template <typename MemberDataPtr, MemberDataPtr ptr, typename FirstParam, typename... Params>
 		static void STDMETHODCALLTYPE threadSafeFunc(FirstParam firstParam, Params... params)
 		{
-			DDraw::ScopedThreadLock lock;
+			Compat::CallStats& stats = *FuncCallStats<MemberDataPtr, ptr>::s_stats;
+			DDraw::ScopedThreadLock lock(stats.getName().c_str());
+			ScopedCallSample callSample(stats);
 #ifdef _DEBUG
-			const char* funcName = s_funcNames[getKey<MemberDataPtr, ptr>()].c_str();
+			const char* funcName = stats.getName().c_str();
 			Compat::LogEnter(funcName, firstParam, params...);
 			Hook::getCompatFunc<MemberDataPtr, ptr>(firstParam)(firstParam, params...);
 			Compat::LogLeave(funcName, firstParam, params...);
@@ -179,7 +218,6 @@ private:
 	}
 
 	static Vtable s_compatVtable;
-	static std::map<std::vector<unsigned char>, std::string> s_funcNames;
 };
 
 template <typename Vtable>
@@ -195,4 +233,5 @@ template <typename Vtable>
 Vtable CompatVtable<Vtable>::s_compatVtable(getCompatVtable());
 
 template <typename Vtable>
-std::map<std::vector<unsigned char>, std::string> CompatVtable<Vtable>::s_funcNames;
+template <typename MemberDataPtr, MemberDataPtr ptr>
+Compat::CallStats* CompatVtable<Vtable>::FuncCallStats<MemberDataPtr, ptr>::s_stats = nullptr;
@@ -0,0 +1,34 @@
+#include "Common/DeferredInstallation.h"
+
+namespace Compat
+{
+	DeferredInstallation::DeferredInstallation(Installer& installer)
+		: m_installer(installer)
+		, m_state(State::NOT_INSTALLED)
+		, m_installingThreadId()
+	{
+	}
+
+	void DeferredInstallation::run()
+	{
+		State state = State::NOT_INSTALLED;
+		if (m_state.compare_exchange_strong(state, State::INSTALLING))
+		{
+			m_installingThreadId = std::this_thread::get_id();
+			const bool isInstalled = m_installer.install();
+			m_installingThreadId = std::thread::id();
+			m_state = isInstalled ? State::INSTALLED : State::FAILED;
+			return;
+		}
+
+		if (State::INSTALLING != state || std::this_thread::get_id() == m_installingThreadId)
+		{
+			return;
+		}
+
+		while (State::INSTALLING == m_state)
+		{
+			std::this_thread::yield();
+		}
+	}
+}
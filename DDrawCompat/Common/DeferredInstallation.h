@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+// Runs an installation, such as hooking a set of vtables, once on first use.
+// This file must stay free of Windows dependencies so the state machine can be tested on any platform.
+
+namespace Compat
+{
+	class DeferredInstallation
+	{
+	public:
+		enum class State
+		{
+			NOT_INSTALLED,
+			INSTALLING,
+			INSTALLED,
+			FAILED
+		};
+
+		class Installer
+		{
+		public:
+			virtual ~Installer() {}
+
+			// Returns false if the installation failed. It is not retried.
+			virtual bool install() = 0;
+		};
+
+		DeferredInstallation(Installer& installer);
+
+		// The first call runs the installer. Calls from other threads return only after it has finished,
+		// while reentrant calls from the installing thread, made by the installer itself, return immediately.
+		void run();
+
+		State getState() const { return m_state; }
+
+	private:
+		DeferredInstallation(const DeferredInstallation&) = delete;
+		DeferredInstallation& operator=(const DeferredInstallation&) = delete;
+
+		Installer& m_installer;
+		std::atomic<State> m_state;
+		std::atomic<std::thread::id> m_installingThreadId;
+	};
+}
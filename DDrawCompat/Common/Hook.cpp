@@ -13,6 +13,8 @@
 
 #include "Common/Hook.h"
 #include "Common/Log.h"
+#include "Common/PeImage.h"
+#include "Common/PhaseTimer.h"
 
 namespace
 {
@@ -42,37 +44,60 @@ namespace
 		return modules;
 	}
 
-	std::set<void*> getIatHookFunctions(const char* moduleName, const char* funcName)
+	std::vector<std::set<void*>> getIatHookFunctions(const std::vector<Compat::IatHookRedirect>& redirects)
 	{
-		std::set<void*> hookFunctions;
-		if (!moduleName || !funcName)
+		std::vector<std::set<void*>> hookFunctions(redirects.size());
+
+		std::vector<Compat::IatImport> imports;
+		for (const auto& redirect : redirects)
+		{
+			imports.push_back({ redirect.moduleName, redirect.funcName });
+		}
+		const std::size_t getProcAddressIndex = imports.size();
+		imports.push_back({ "kernel32", "GetProcAddress" });
+
+		typedef decltype(GetProcAddress)* GetProcAddressFunc;
+		static const auto origGetProcAddressFunc = reinterpret_cast<GetProcAddressFunc>(
+			Compat::getProcAddress(GetModuleHandle("kernel32"), "GetProcAddress"));
+
+		std::vector<HMODULE> targetModules;
+		for (const auto& redirect : redirects)
 		{
-			return hookFunctions;
+			targetModules.push_back(redirect.moduleName ? GetModuleHandle(redirect.moduleName) : nullptr);
 		}
 
 		auto modules = getProcessModules(GetCurrentProcess());
-		const HMODULE targetModule = GetModuleHandle(moduleName);
+		std::vector<FARPROC*> procs;
 
 		for (auto module : modules)
 		{
-			FARPROC func = Compat::getProcAddressFromIat(module, moduleName, funcName);
-			if (!func)
+			Compat::PhaseTimer::countModuleScan();
+			Compat::findProcAddressesInIat(module, imports, procs);
+
+			auto getProcAddressFunc = procs[getProcAddressIndex]
+				? reinterpret_cast<GetProcAddressFunc>(*procs[getProcAddressIndex]) : nullptr;
+			if (getProcAddressFunc == origGetProcAddressFunc)
 			{
-				typedef decltype(GetProcAddress)* GetProcAddressFunc;
-				static const auto origGetProcAddressFunc = reinterpret_cast<GetProcAddressFunc>(
-					Compat::getProcAddress(GetModuleHandle("kernel32"), "GetProcAddress"));
+				getProcAddressFunc = nullptr;
+			}
 
-				auto getProcAddressFunc = reinterpret_cast<GetProcAddressFunc>(
-					Compat::getProcAddressFromIat(module, "kernel32", "GetProcAddress"));
-				if (getProcAddressFunc && *getProcAddressFunc != origGetProcAddressFunc)
+			for (std::size_t i = 0; i < redirects.size(); ++i)
+			{
+				if (!redirects[i].moduleName || !redirects[i].funcName)
 				{
-					func = getProcAddressFunc(targetModule, funcName);
+					continue;
 				}
-			}
 
-			if (func)
-			{
-				hookFunctions.insert(func);
+				FARPROC func = procs[i] ? *procs[i] : nullptr;
+				if (!func && getProcAddressFunc)
+				{
+					func = getProcAddressFunc(targetModules[i], redirects[i].funcName);
+				}
+
+				if (func)
+				{
+					hookFunctions[i].insert(func);
+				}
 			}
 		}
 
@@ -97,7 +122,7 @@ namespace
 		return ntHeaders;
 	}
 
-	std::string getModuleBaseName(HMODULE module)
+	std::string queryModuleBaseName(HMODULE module)
 	{
 		char path[MAX_PATH] = {};
 		GetModuleFileName(module, path, sizeof(path));
@@ -106,6 +131,52 @@ namespace
 		return baseName;
 	}
 
+	struct ModuleInfo
+	{
+		Compat::PeImage peImage;
+		std::string baseName;
+	};
+
+	std::map<HMODULE, ModuleInfo> g_moduleInfos;
+	SRWLOCK g_moduleInfosLock = SRWLOCK_INIT;
+
+	// Requires g_moduleInfosLock. The parsed headers are cached per module, and a different module loaded
+	// at the address of an unloaded one is detected by its timestamp and image size.
+	ModuleInfo& getModuleInfo(HMODULE module)
+	{
+		PIMAGE_NT_HEADERS ntHeaders = getImageNtHeaders(module);
+		const DWORD timeDateStamp = ntHeaders ? ntHeaders->FileHeader.TimeDateStamp : 0;
+		const DWORD size = ntHeaders ? ntHeaders->OptionalHeader.SizeOfImage : 0;
+
+		auto it = g_moduleInfos.find(module);
+		if (it != g_moduleInfos.end() &&
+			(it->second.peImage.getTimeDateStamp() != timeDateStamp || it->second.peImage.getSize() != size))
+		{
+			g_moduleInfos.erase(it);
+			it = g_moduleInfos.end();
+		}
+
+		if (it == g_moduleInfos.end())
+		{
+			ModuleInfo moduleInfo = { Compat::PeImage(reinterpret_cast<const unsigned char*>(module), size), {} };
+			it = g_moduleInfos.insert({ module, moduleInfo }).first;
+		}
+		return it->second;
+	}
+
+	std::string getModuleBaseName(HMODULE module)
+	{
+		AcquireSRWLockExclusive(&g_moduleInfosLock);
+		ModuleInfo& moduleInfo = getModuleInfo(module);
+		if (moduleInfo.baseName.empty())
+		{
+			moduleInfo.baseName = queryModuleBaseName(module);
+		}
+		const std::string baseName = moduleInfo.baseName;
+		ReleaseSRWLockExclusive(&g_moduleInfosLock);
+		return baseName;
+	}
+
 	void hookFunction(const char* funcName, void*& origFuncPtr, void* newFuncPtr)
 	{
 		const auto it = findOrigFunc(origFuncPtr);
@@ -137,6 +208,7 @@ namespace
 		GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
 			reinterpret_cast<char*>(hookedFuncPtr), &module);
 		g_hookedFunctions[hookedFuncPtr] = { module, origFuncPtr, newFuncPtr };
+		Compat::PhaseTimer::countHook();
 	}
 
 	void unhookFunction(const std::map<void*, HookedFunctionInfo>::iterator& hookedFunc)
@@ -157,23 +229,32 @@ namespace Compat
 {
 	void redirectIatHooks(const char* moduleName, const char* funcName, void* newFunc)
 	{
-		auto hookFunctions(getIatHookFunctions(moduleName, funcName));
+		redirectIatHooks({ { moduleName, funcName, newFunc } });
+	}
+
+	void redirectIatHooks(const std::vector<IatHookRedirect>& redirects)
+	{
+		auto hookFunctions(getIatHookFunctions(redirects));
 
-		for (auto hookFunc : hookFunctions)
+		for (std::size_t i = 0; i < redirects.size(); ++i)
 		{
-			HMODULE module = nullptr;
-			if (!GetModuleHandleEx(
-				GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
-				static_cast<LPCSTR>(hookFunc), &module))
+			for (auto hookFunc : hookFunctions[i])
 			{
-				continue;
-			}
+				HMODULE module = nullptr;
+				if (!GetModuleHandleEx(
+					GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+					static_cast<LPCSTR>(hookFunc), &module))
+				{
+					continue;
+				}
 
-			std::string moduleBaseName(getModuleBaseName(module));
-			if (0 != _stricmp(moduleBaseName.c_str(), moduleName))
-			{
-				Compat::Log() << "Disabling external hook to " << funcName << " in " << moduleBaseName;
-				hookFunction(hookFunc, newFunc);
+				const std::string moduleBaseName = getModuleBaseName(module);
+				if (0 != _stricmp(moduleBaseName.c_str(), redirects[i].moduleName))
+				{
+					Compat::Log() << "Disabling external hook to " << redirects[i].funcName
+						<< " in " << moduleBaseName;
+					hookFunction(hookFunc, redirects[i].newFunc);
+				}
 			}
 		}
 	}
@@ -185,45 +266,33 @@ namespace Compat
 			return nullptr;
 		}
 
-		PIMAGE_NT_HEADERS ntHeaders = getImageNtHeaders(module);
-		if (!ntHeaders)
+		AcquireSRWLockExclusive(&g_moduleInfosLock);
+		const std::size_t iatOffset = getModuleInfo(module).peImage.findImport(importedModuleName, procName);
+		ReleaseSRWLockExclusive(&g_moduleInfosLock);
+		return 0 != iatOffset ? reinterpret_cast<FARPROC*>(reinterpret_cast<char*>(module) + iatOffset) : nullptr;
+	}
+
+	void findProcAddressesInIat(HMODULE module, const std::vector<IatImport>& imports,
+		std::vector<FARPROC*>& procs)
+	{
+		procs.assign(imports.size(), nullptr);
+		if (!module)
 		{
-			return nullptr;
+			return;
 		}
 
-		char* moduleBase = reinterpret_cast<char*>(module);
-		PIMAGE_IMPORT_DESCRIPTOR importDesc = reinterpret_cast<PIMAGE_IMPORT_DESCRIPTOR>(moduleBase +
-			ntHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress);
+		std::vector<std::size_t> iatOffsets;
+		AcquireSRWLockExclusive(&g_moduleInfosLock);
+		getModuleInfo(module).peImage.findImports(imports, iatOffsets);
+		ReleaseSRWLockExclusive(&g_moduleInfosLock);
 
-		for (PIMAGE_IMPORT_DESCRIPTOR desc = importDesc;
-			0 != desc->Characteristics && 0xFFFF != desc->Name;
-			++desc)
+		for (std::size_t i = 0; i < imports.size(); ++i)
 		{
-			if (0 != _stricmp(moduleBase + desc->Name, importedModuleName))
-			{
-				continue;
-			}
-
-			auto thunk = reinterpret_cast<PIMAGE_THUNK_DATA>(moduleBase + desc->FirstThunk);
-			auto origThunk = reinterpret_cast<PIMAGE_THUNK_DATA>(moduleBase + desc->OriginalFirstThunk);
-			while (0 != thunk->u1.AddressOfData && 0 != origThunk->u1.AddressOfData)
+			if (0 != iatOffsets[i])
 			{
-				auto origImport = reinterpret_cast<PIMAGE_IMPORT_BY_NAME>(
-					moduleBase + origThunk->u1.AddressOfData);
-
-				if (0 == strcmp(origImport->Name, procName))
-				{
-					return reinterpret_cast<FARPROC*>(&thunk->u1.Function);
-				}
-
-				++thunk;
-				++origThunk;
+				procs[i] = reinterpret_cast<FARPROC*>(reinterpret_cast<char*>(module) + iatOffsets[i]);
 			}
-
-			break;
 		}
-
-		return nullptr;
 	}
 
 	FARPROC getProcAddress(HMODULE module, const char* procName)
@@ -304,6 +373,7 @@ namespace Compat
 			*func = static_cast<FARPROC>(newFuncPtr);
 			DWORD dummy = 0;
 			VirtualProtect(func, sizeof(func), oldProtect, &dummy);
+			Compat::PhaseTimer::countHook();
 		}
 	}
 
@@ -2,8 +2,12 @@
 
 #define WIN32_LEAN_AND_MEAN
 
+#include <vector>
+
 #include <Windows.h>
 
+#include "Common/PeImage.h"
+
 #define CALL_ORIG_FUNC(func) Compat::getOrigFuncPtr<decltype(&func), &func>()
 
 #define HOOK_FUNCTION(module, func, newFunc) \
@@ -15,7 +19,17 @@
 
 namespace Compat
 {
+	typedef PeImage::Import IatImport;
+
+	struct IatHookRedirect
+	{
+		const char* moduleName;
+		const char* funcName;
+		void* newFunc;
+	};
+
 	void redirectIatHooks(const char* moduleName, const char* funcName, void* newFunc);
+	void redirectIatHooks(const std::vector<IatHookRedirect>& redirects);
 
 	template <typename OrigFuncPtr, OrigFuncPtr origFunc>
 	OrigFuncPtr& getOrigFuncPtr()
@@ -25,6 +39,8 @@ namespace Compat
 	}
 
 	FARPROC* findProcAddressInIat(HMODULE module, const char* importedModuleName, const char* procName);
+	void findProcAddressesInIat(HMODULE module, const std::vector<IatImport>& imports,
+		std::vector<FARPROC*>& procs);
 	FARPROC getProcAddress(HMODULE module, const char* procName);
 	FARPROC getProcAddressFromIat(HMODULE module, const char* importedModuleName, const char* procName);
 	void hookFunction(void*& origFuncPtr, void* newFuncPtr);
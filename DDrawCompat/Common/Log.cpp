@@ -1,12 +1,310 @@
 #define WIN32_LEAN_AND_MEAN
 
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include <atlstr.h>
 #include <Windows.h>
 
 #include "Common/Log.h"
+#include "Common/LogRingBuffer.h"
+#include "Config/Config.h"
 
 namespace
 {
+	const DWORD LOG_WRITER_INTERVAL_MS = 10;
+	const DWORD LOG_WRITER_STOP_TIMEOUT_MS = 1000;
+
+	typedef Compat::LogRingBuffer::RecordHeader LogRecordHeader;
+	typedef Compat::LogRingBuffer::Record LogRecord;
+
+	struct LogBuffer
+	{
+		LogBuffer() : isInUse(true) {}
+
+		Compat::LogRingBuffer ring;
+		std::atomic<bool> isInUse;
+	};
+
+	struct ThreadLogBuffer
+	{
+		ThreadLogBuffer() : buffer(nullptr) {}
+		~ThreadLogBuffer()
+		{
+			if (buffer)
+			{
+				buffer->isInUse = false;
+			}
+		}
+
+		LogBuffer* buffer;
+	};
+
+	thread_local ThreadLogBuffer g_threadLogBuffer;
+
+	std::ofstream g_logFile;
+	CRITICAL_SECTION g_writerCs;
+	std::vector<LogBuffer*> g_logBuffers;
+	HANDLE g_writerEvent = nullptr;
+	HANDLE g_writerThread = nullptr;
+	std::atomic<bool> g_isWriterThreadRunning(false);
+	std::atomic<bool> g_stopWriterThread(false);
+	bool g_isLogInitialized = false;
+	long long g_qpcFrequency = 0;
+	long long g_qpcBase = 0;
+	ULONGLONG g_fileTimeBase = 0;
+
+	std::ofstream g_traceFile;
+	std::unordered_map<const char*, std::uint32_t> g_traceFuncIds;
+	std::vector<unsigned char> g_traceBuffer;
+
+	DWORD WINAPI logWriterThreadProc(LPVOID lpParameter);
+
+	bool initLog()
+	{
+		g_logFile.open("ddraw.log");
+		InitializeCriticalSection(&g_writerCs);
+
+		LARGE_INTEGER qpc = {};
+		QueryPerformanceFrequency(&qpc);
+		g_qpcFrequency = qpc.QuadPart;
+
+		SYSTEMTIME st = {};
+		GetLocalTime(&st);
+		QueryPerformanceCounter(&qpc);
+		g_qpcBase = qpc.QuadPart;
+
+		FILETIME ft = {};
+		SystemTimeToFileTime(&st, &ft);
+		g_fileTimeBase = (static_cast<ULONGLONG>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+
+		g_writerEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		if (g_writerEvent)
+		{
+			g_writerThread = CreateThread(nullptr, 0, &logWriterThreadProc, nullptr, 0, nullptr);
+		}
+
+		g_isLogInitialized = true;
+		return true;
+	}
+
+	bool ensureLogInitialized()
+	{
+		static const bool isInitialized = initLog();
+		return isInitialized;
+	}
+
+	LogBuffer* acquireLogBuffer()
+	{
+		EnterCriticalSection(&g_writerCs);
+		LogBuffer* buffer = nullptr;
+		for (auto logBuffer : g_logBuffers)
+		{
+			if (!logBuffer->isInUse && logBuffer->ring.isEmpty())
+			{
+				buffer = logBuffer;
+				buffer->isInUse = true;
+				break;
+			}
+		}
+
+		if (!buffer)
+		{
+			buffer = new LogBuffer();
+			g_logBuffers.push_back(buffer);
+		}
+		LeaveCriticalSection(&g_writerCs);
+		return buffer;
+	}
+
+	std::string formatTime(long long qpc)
+	{
+		const long long qpcDelta = qpc - g_qpcBase;
+		const long long ticks = qpcDelta / g_qpcFrequency * 10000000 +
+			qpcDelta % g_qpcFrequency * 10000000 / g_qpcFrequency;
+		const ULONGLONG fileTime = g_fileTimeBase + ticks;
+
+		FILETIME ft = {};
+		ft.dwLowDateTime = static_cast<DWORD>(fileTime);
+		ft.dwHighDateTime = static_cast<DWORD>(fileTime >> 32);
+		SYSTEMTIME st = {};
+		FileTimeToSystemTime(&ft, &st);
+
+		char time[100];
+		sprintf_s(time, "%02hu:%02hu:%02hu.%03hu ", st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
+		return time;
+	}
+
+	// g_writerCs must be held
+	void writeTraceEvent(const LogRecord& record)
+	{
+		if (!g_traceFile.is_open())
+		{
+			g_traceFile.open("ddraw.trace", std::ios::binary);
+			Compat::Trace::FileHeader header = {};
+			header.pointerSize = sizeof(void*);
+			header.qpcFrequency = g_qpcFrequency;
+			header.qpcBase = g_qpcBase;
+			header.fileTimeBase = g_fileTimeBase;
+			Compat::Trace::writeFileHeader(g_traceBuffer, header);
+		}
+
+		auto it = g_traceFuncIds.find(record.traceFuncName);
+		if (it == g_traceFuncIds.end())
+		{
+			const std::uint32_t id = static_cast<std::uint32_t>(g_traceFuncIds.size());
+			it = g_traceFuncIds.insert({ record.traceFuncName, id }).first;
+			Compat::Trace::writeName(g_traceBuffer, id, record.traceFuncName);
+		}
+
+		Compat::Trace::writeEvent(g_traceBuffer, record.traceType, it->second, record.threadId, record.qpc,
+			reinterpret_cast<const unsigned char*>(record.data.data()), static_cast<std::uint32_t>(record.data.size()));
+	}
+
+	// g_writerCs must be held
+	void drainLockedLogBuffers()
+	{
+		std::vector<Compat::LogRingBuffer*> buffers;
+		for (auto buffer : g_logBuffers)
+		{
+			buffers.push_back(&buffer->ring);
+		}
+
+		std::vector<LogRecord> records;
+		std::uint32_t droppedCount = 0;
+		Compat::drainLogRingBuffers(buffers, records, droppedCount);
+
+		bool isLogWritten = false;
+		for (const auto& record : records)
+		{
+			if (record.traceFuncName)
+			{
+				writeTraceEvent(record);
+			}
+			else
+			{
+				g_logFile << record.threadId << " " << formatTime(record.qpc) << record.data << '\n';
+				isLogWritten = true;
+			}
+		}
+
+		if (0 != droppedCount)
+		{
+			const long long qpc = records.empty() ? g_qpcBase : records.back().qpc;
+			g_logFile << GetCurrentThreadId() << " " << formatTime(qpc) << "Warning: " << droppedCount
+				<< " log records were dropped due to full log buffers" << '\n';
+			isLogWritten = true;
+		}
+
+		if (isLogWritten)
+		{
+			g_logFile.flush();
+		}
+
+		if (!g_traceBuffer.empty())
+		{
+			g_traceFile.write(reinterpret_cast<const char*>(g_traceBuffer.data()), g_traceBuffer.size());
+			g_traceBuffer.clear();
+			g_traceFile.flush();
+		}
+	}
+
+	void drainLogBuffers()
+	{
+		EnterCriticalSection(&g_writerCs);
+		drainLockedLogBuffers();
+		LeaveCriticalSection(&g_writerCs);
+	}
+
+	// Used without a writer thread, where the writer lock may be orphaned by a thread killed during process
+	// termination. Records left behind are written by the next successful drain.
+	void tryDrainLogBuffers()
+	{
+		if (TryEnterCriticalSection(&g_writerCs))
+		{
+			drainLockedLogBuffers();
+			LeaveCriticalSection(&g_writerCs);
+		}
+	}
+
+	DWORD WINAPI logWriterThreadProc(LPVOID /*lpParameter*/)
+	{
+		g_isWriterThreadRunning = true;
+		while (!g_stopWriterThread)
+		{
+			WaitForSingleObject(g_writerEvent, LOG_WRITER_INTERVAL_MS);
+			drainLogBuffers();
+		}
+		return 0;
+	}
+
+	LogBuffer& getThreadLogBuffer()
+	{
+		if (!g_threadLogBuffer.buffer)
+		{
+			g_threadLogBuffer.buffer = acquireLogBuffer();
+		}
+		return *g_threadLogBuffer.buffer;
+	}
+
+	bool pushRecord(LogBuffer& buffer, const LogRecordHeader& header, const void* data)
+	{
+		if (!buffer.ring.push(header, data))
+		{
+			SetEvent(g_writerEvent);
+			return false;
+		}
+
+		if (!g_isWriterThreadRunning)
+		{
+			tryDrainLogBuffers();
+		}
+		else if (buffer.ring.getUsedSize() >= Compat::LogRingBuffer::SIZE / 2)
+		{
+			SetEvent(g_writerEvent);
+		}
+		return true;
+	}
+
+	void pushLogRecord(long long qpc, const std::string& text)
+	{
+		LogBuffer& buffer = getThreadLogBuffer();
+		LogRecordHeader header = {};
+		header.qpc = qpc;
+		header.threadId = GetCurrentThreadId();
+
+		Compat::pushLogText(text, [&](const char* data, std::uint32_t size)
+		{
+			header.size = size;
+			return pushRecord(buffer, header, data);
+		});
+	}
+
+	void pushTraceRecord(Compat::Trace::RecordType type, const char* funcName, long long qpc,
+		const Compat::Trace::EventWriter& writer)
+	{
+		LogBuffer& buffer = getThreadLogBuffer();
+		const auto& args = writer.getArgs();
+		if (args.size() > Compat::LogRingBuffer::MAX_RECORD_DATA_SIZE)
+		{
+			buffer.ring.countDropped();
+			return;
+		}
+
+		LogRecordHeader header = {};
+		header.qpc = qpc;
+		header.threadId = GetCurrentThreadId();
+		header.size = static_cast<std::uint32_t>(args.size());
+		header.traceFuncName = funcName;
+		header.traceType = type;
+		pushRecord(buffer, header, args.data());
+	}
+
 	template <typename DevMode>
 	std::ostream& streamDevMode(std::ostream& os, const DevMode& dm)
 	{
@@ -160,23 +458,123 @@ std::ostream& operator<<(std::ostream& os, const CWPRETSTRUCT& cwrp)
 
 namespace Compat
 {
-	Log::Log()
+	Log::Log() : m_traceType(Trace::RecordType::ENTER), m_traceFuncName(nullptr)
 	{
-		SYSTEMTIME st = {};
-		GetLocalTime(&st);
+		ensureLogInitialized();
+		LARGE_INTEGER qpc = {};
+		QueryPerformanceCounter(&qpc);
+		m_qpc = qpc.QuadPart;
+	}
 
-		char time[100];
-		sprintf_s(time, "%02hu:%02hu:%02hu.%03hu ", st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
+	Log::~Log()
+	{
+		if (m_traceFuncName)
+		{
+			pushTraceRecord(m_traceType, m_traceFuncName, m_qpc, m_traceWriter);
+		}
+		else
+		{
+			pushLogRecord(m_qpc, m_os.str());
+		}
+	}
 
-		s_logFile << GetCurrentThreadId() << " " << time;
+	void Log::stopWriterThread()
+	{
+		if (!g_isLogInitialized)
+		{
+			return;
+		}
+
+		if (g_writerThread)
+		{
+			// The writer thread drains the buffers once more before it exits. It is never terminated,
+			// because it could be holding g_writerCs or the CRT heap lock at that point.
+			g_stopWriterThread = true;
+			SetEvent(g_writerEvent);
+			WaitForSingleObject(g_writerThread, LOG_WRITER_STOP_TIMEOUT_MS);
+			CloseHandle(g_writerThread);
+			g_writerThread = nullptr;
+			g_isWriterThreadRunning = false;
+		}
+
+		tryDrainLogBuffers();
 	}
 
-	Log::~Log()
+	void traceArg(Trace::EventWriter& writer, bool val)
+	{
+		writer.addBool(val);
+	}
+
+	void traceArg(Trace::EventWriter& writer, char val)
+	{
+		writer.addChar(val);
+	}
+
+	void traceArg(Trace::EventWriter& writer, const RECT& rect)
+	{
+		const std::int32_t r[4] = { rect.left, rect.top, rect.right, rect.bottom };
+		writer.addRect(r);
+	}
+
+	void tracePointer(Trace::EventWriter& writer, const char* str)
+	{
+		if (str && !Log::isPointerDereferencingAllowed())
+		{
+			writer.addPointer(reinterpret_cast<std::uintptr_t>(str));
+			return;
+		}
+		writer.addString(str);
+	}
+
+	void tracePointer(Trace::EventWriter& writer, const WCHAR* wstr)
+	{
+		if (wstr && !Log::isPointerDereferencingAllowed())
+		{
+			writer.addPointer(reinterpret_cast<std::uintptr_t>(wstr));
+			return;
+		}
+		writer.addWString(wstr);
+	}
+
+	void tracePointer(Trace::EventWriter& writer, const RECT* rect)
+	{
+		if (rect && !Log::isPointerDereferencingAllowed())
+		{
+			writer.addPointer(reinterpret_cast<std::uintptr_t>(rect));
+			return;
+		}
+
+		if (!rect)
+		{
+			writer.addRectPointer(0, nullptr);
+			return;
+		}
+
+		const std::int32_t r[4] = { rect->left, rect->top, rect->right, rect->bottom };
+		writer.addRectPointer(reinterpret_cast<std::uintptr_t>(rect), r);
+	}
+
+	void tracePointer(Trace::EventWriter& writer, const HDC__* dc)
+	{
+		if (dc && !Log::isPointerDereferencingAllowed())
+		{
+			writer.addPointer(reinterpret_cast<std::uintptr_t>(dc));
+			return;
+		}
+		writer.addDc(reinterpret_cast<std::uintptr_t>(dc));
+	}
+
+	void tracePointer(Trace::EventWriter& writer, const HWND__* hwnd)
 	{
-		s_logFile << std::endl;
+		if (hwnd && !Log::isPointerDereferencingAllowed())
+		{
+			writer.addPointer(reinterpret_cast<std::uintptr_t>(hwnd));
+			return;
+		}
+		writer.addWnd(reinterpret_cast<std::uintptr_t>(hwnd));
 	}
 
-	std::ofstream Log::s_logFile("ddraw.log");
 	DWORD Log::s_outParamDepth = 0;
 	bool Log::s_isLeaveLog = false;
+	bool Log::s_isBinaryTraceEnabled = Config::binaryTraceLog;
 }
@@ -3,10 +3,12 @@
 #define CINTERFACE
 
 #include <ddraw.h>
-#include <fstream>
 #include <ostream>
+#include <sstream>
 #include <type_traits>
 
+#include "Common/TraceFormat.h"
+
 #define LOG_ONCE(msg) \
 	static bool isAlreadyLogged##__LINE__ = false; \
 	if (!isAlreadyLogged##__LINE__) \
@@ -67,6 +69,15 @@ namespace Compat
 
 	template <typename T> Out<T> out(const T& val) { return Out<T>(val); }
 
+	template <typename T> void traceArg(Trace::EventWriter& writer, const T& val);
+	template <typename T> void traceArg(Trace::EventWriter& writer, T* val);
+	template <typename Num> void traceArg(Trace::EventWriter& writer, const Hex<Num>& hex);
+	template <typename Elem> void traceArg(Trace::EventWriter& writer, const Array<Elem>& array);
+	template <typename T> void traceArg(Trace::EventWriter& writer, const Out<T>& out);
+	void traceArg(Trace::EventWriter& writer, bool val);
+	void traceArg(Trace::EventWriter& writer, char val);
+	void traceArg(Trace::EventWriter& writer, const RECT& rect);
+
 	class Log
 	{
 	public:
@@ -76,24 +87,48 @@ namespace Compat
 		template <typename T>
 		Log& operator<<(const T& t)
 		{
-			s_logFile << t;
+			m_os << t;
 			return *this;
 		}
 
 		static bool isPointerDereferencingAllowed() { return s_isLeaveLog || 0 == s_outParamDepth; }
+		static void stopWriterThread();
 
 	protected:
 		template <typename... Params>
-		Log(const char* prefix, const char* funcName, Params... params) : Log()
+		Log(Trace::RecordType type, const char* funcName, Params... params) : Log()
 		{
-			s_logFile << prefix << ' ' << funcName << '(';
+			if (s_isBinaryTraceEnabled)
+			{
+				m_traceType = type;
+				m_traceFuncName = funcName;
+				toTrace(params...);
+				return;
+			}
+
+			m_os << (Trace::RecordType::ENTER == type ? "-->" : "<--") << ' ' << funcName << '(';
 			toList(params...);
-			s_logFile << ')';
+			m_os << ')';
+		}
+
+		template <typename Result>
+		void logResult(const Result& result)
+		{
+			if (m_traceFuncName)
+			{
+				m_traceWriter.beginResult();
+				traceResult(result);
+			}
+			else
+			{
+				m_os << " = " << std::hex << result << std::dec;
+			}
 		}
 
 	private:
 		friend class LogLeaveGuard;
 		template <typename T> friend std::ostream& operator<<(std::ostream& os, Out<T> out);
+		template <typename T> friend void traceArg(Trace::EventWriter& writer, const Out<T>& out);
 
 		void toList()
 		{
@@ -102,19 +137,50 @@ namespace Compat
 		template <typename Param>
 		void toList(Param param)
 		{
-			s_logFile << param;
+			m_os << param;
 		}
 
 		template <typename Param, typename... Params>
 		void toList(Param firstParam, Params... remainingParams)
 		{
-			s_logFile << firstParam << ", ";
+			m_os << firstParam << ", ";
 			toList(remainingParams...);
 		}
 
-		static std::ofstream s_logFile;
+		void toTrace()
+		{
+		}
+
+		template <typename Param, typename... Params>
+		void toTrace(Param firstParam, Params... remainingParams)
+		{
+			traceArg(m_traceWriter, firstParam);
+			toTrace(remainingParams...);
+		}
+
+		template <typename Result>
+		typename std::enable_if<std::is_integral<Result>::value && !std::is_same<Result, bool>::value>::type
+		traceResult(Result result)
+		{
+			m_traceWriter.addUInt(static_cast<typename std::make_unsigned<Result>::type>(result));
+		}
+
+		template <typename Result>
+		typename std::enable_if<!std::is_integral<Result>::value || std::is_same<Result, bool>::value>::type
+		traceResult(const Result& result)
+		{
+			traceArg(m_traceWriter, result);
+		}
+
+		std::ostringstream m_os;
+		long long m_qpc;
+		Trace::EventWriter m_traceWriter;
+		Trace::RecordType m_traceType;
+		const char* m_traceFuncName;
+
 		static DWORD s_outParamDepth;
 		static bool s_isLeaveLog;
+		static bool s_isBinaryTraceEnabled;
 	};
 
 	class LogParams;
@@ -155,7 +221,7 @@ namespace Compat
 	{
 	public:
 		template <typename... Params>
-		LogEnter(const char* funcName, Params... params) : Log("-->", funcName, params...)
+		LogEnter(const char* funcName, Params... params) : Log(Trace::RecordType::ENTER, funcName, params...)
 		{
 		}
 	};
@@ -171,14 +237,14 @@ namespace Compat
 	{
 	public:
 		template <typename... Params>
-		LogLeave(const char* funcName, Params... params) : Log("<--", funcName, params...)
+		LogLeave(const char* funcName, Params... params) : Log(Trace::RecordType::LEAVE, funcName, params...)
 		{
 		}
 
 		template <typename Result>
 		void operator<<(const Result& result)
 		{
-			static_cast<Log&>(*this) << " = " << std::hex << result << std::dec;
+			logResult(result);
 		}
 	};
 #else
@@ -232,6 +298,155 @@ namespace Compat
 		--Log::s_outParamDepth;
 		return os;
 	}
+
+	// Structs whose contents are recorded in binary traces. Other class types, such as interfaces and handles,
+	// are recorded by address only, as they are not safe to copy.
+	template <typename T> struct IsTracedStruct : std::false_type {};
+	template <> struct IsTracedStruct<DDBLTFX> : std::true_type {};
+	template <> struct IsTracedStruct<DDPIXELFORMAT> : std::true_type {};
+	template <> struct IsTracedStruct<DDSCAPS> : std::true_type {};
+	template <> struct IsTracedStruct<DDSCAPS2> : std::true_type {};
+	template <> struct IsTracedStruct<DDSURFACEDESC> : std::true_type {};
+	template <> struct IsTracedStruct<DDSURFACEDESC2> : std::true_type {};
+	template <> struct IsTracedStruct<DEVMODEA> : std::true_type {};
+	template <> struct IsTracedStruct<DEVMODEW> : std::true_type {};
+	template <> struct IsTracedStruct<CWPSTRUCT> : std::true_type {};
+	template <> struct IsTracedStruct<CWPRETSTRUCT> : std::true_type {};
+
+	template <typename T>
+	void traceStruct(Trace::EventWriter& writer, const T& val, std::true_type /*isTracedStruct*/)
+	{
+		writer.addStruct(&val, static_cast<std::uint32_t>(sizeof(T)));
+	}
+
+	template <typename T>
+	void traceStruct(Trace::EventWriter& writer, const T& val, std::false_type /*isTracedStruct*/)
+	{
+		writer.addPointer(reinterpret_cast<std::uintptr_t>(&val));
+	}
+
+	template <typename T>
+	void traceValue(Trace::EventWriter& writer, const T& val, std::true_type /*isClass*/)
+	{
+		traceStruct(writer, val, IsTracedStruct<T>());
+	}
+
+	template <typename T>
+	void traceNumber(Trace::EventWriter& writer, T val, std::true_type /*isSigned*/)
+	{
+		writer.addInt(static_cast<std::int64_t>(val));
+	}
+
+	template <typename T>
+	void traceNumber(Trace::EventWriter& writer, T val, std::false_type /*isSigned*/)
+	{
+		writer.addUInt(static_cast<std::uint64_t>(val));
+	}
+
+	template <typename T>
+	void traceValue(Trace::EventWriter& writer, const T& val, std::false_type /*isClass*/)
+	{
+		traceNumber(writer, val, std::is_signed<T>());
+	}
+
+	void tracePointer(Trace::EventWriter& writer, const char* str);
+	void tracePointer(Trace::EventWriter& writer, const WCHAR* wstr);
+	void tracePointer(Trace::EventWriter& writer, const RECT* rect);
+	void tracePointer(Trace::EventWriter& writer, const HDC__* dc);
+	void tracePointer(Trace::EventWriter& writer, const HWND__* hwnd);
+
+	template <typename T>
+	void traceObjectPointer(Trace::EventWriter& writer, const T* ptr, std::true_type /*isTracedStruct*/)
+	{
+		if (ptr && !Log::isPointerDereferencingAllowed())
+		{
+			writer.addObjectPointer(reinterpret_cast<std::uintptr_t>(ptr));
+			return;
+		}
+		writer.addStructPointer(reinterpret_cast<std::uintptr_t>(ptr), ptr, static_cast<std::uint32_t>(sizeof(T)));
+	}
+
+	template <typename T>
+	void traceObjectPointer(Trace::EventWriter& writer, const T* ptr, std::false_type /*isTracedStruct*/)
+	{
+		writer.addObjectPointer(reinterpret_cast<std::uintptr_t>(ptr));
+	}
+
+	template <typename T>
+	void tracePointer(Trace::EventWriter& writer, const T* ptr, std::true_type /*isClass*/)
+	{
+		traceObjectPointer(writer, ptr, IsTracedStruct<T>());
+	}
+
+	template <typename T>
+	void tracePointer(Trace::EventWriter& writer, const T* ptr, std::false_type /*isClass*/)
+	{
+		writer.addPointer(reinterpret_cast<std::uintptr_t>(ptr));
+	}
+
+	template <typename T>
+	void tracePointer(Trace::EventWriter& writer, const T* ptr)
+	{
+		tracePointer(writer, ptr, std::is_class<T>());
+	}
+
+	template <typename T>
+	void traceArgPointer(Trace::EventWriter& writer, T* val, std::true_type /*isFunction*/)
+	{
+		writer.addPointer(reinterpret_cast<std::uintptr_t>(val));
+	}
+
+	template <typename T>
+	void traceArgPointer(Trace::EventWriter& writer, T* val, std::false_type /*isFunction*/)
+	{
+		tracePointer(writer, static_cast<const T*>(val));
+	}
+
+	template <typename Num>
+	typename std::enable_if<std::is_integral<Num>::value && !std::is_same<Num, bool>::value>::type
+	traceHex(Trace::EventWriter& writer, Num val)
+	{
+		writer.addHex(static_cast<typename std::make_unsigned<Num>::type>(val));
+	}
+
+	template <typename Num>
+	typename std::enable_if<!std::is_integral<Num>::value || std::is_same<Num, bool>::value>::type
+	traceHex(Trace::EventWriter& writer, const Num& val)
+	{
+		traceArg(writer, val);
+	}
+
+	template <typename T>
+	void traceArg(Trace::EventWriter& writer, const T& val)
+	{
+		traceValue(writer, val, std::is_class<T>());
+	}
+
+	template <typename T>
+	void traceArg(Trace::EventWriter& writer, T* val)
+	{
+		traceArgPointer(writer, val, std::is_function<T>());
+	}
+
+	template <typename Num>
+	void traceArg(Trace::EventWriter& writer, const Hex<Num>& hex)
+	{
+		traceHex(writer, hex.val);
+	}
+
+	template <typename Elem>
+	void traceArg(Trace::EventWriter& writer, const Array<Elem>& array)
+	{
+		writer.addPointer(reinterpret_cast<std::uintptr_t>(array.elem));
+	}
+
+	template <typename T>
+	void traceArg(Trace::EventWriter& writer, const Out<T>& out)
+	{
+		++Log::s_outParamDepth;
+		traceArg(writer, out.val);
+		--Log::s_outParamDepth;
+	}
 }
 
 template <typename T>
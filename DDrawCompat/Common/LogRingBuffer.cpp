@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "Common/LogRingBuffer.h"
+
+namespace Compat
+{
+	const std::uint32_t LogRingBuffer::SIZE;
+	const std::uint32_t LogRingBuffer::HEADER_SIZE;
+	const std::uint32_t LogRingBuffer::MAX_RECORD_DATA_SIZE;
+
+	LogRingBuffer::LogRingBuffer()
+		: m_head(0)
+		, m_tail(0)
+		, m_droppedCount(0)
+	{
+	}
+
+	bool LogRingBuffer::push(const RecordHeader& header, const void* data)
+	{
+		const std::uint32_t recordSize = HEADER_SIZE + header.size;
+		const std::uint32_t head = m_head.load(std::memory_order_relaxed);
+		const std::uint32_t usedSize = head - m_tail.load(std::memory_order_acquire);
+		if (SIZE - usedSize < recordSize)
+		{
+			++m_droppedCount;
+			return false;
+		}
+
+		write(head, &header, HEADER_SIZE);
+		write(head + HEADER_SIZE, data, header.size);
+		m_head.store(head + recordSize, std::memory_order_release);
+		return true;
+	}
+
+	void LogRingBuffer::drain(std::vector<Record>& records)
+	{
+		std::uint32_t tail = m_tail.load(std::memory_order_relaxed);
+		const std::uint32_t head = m_head.load(std::memory_order_acquire);
+		while (tail != head)
+		{
+			RecordHeader header = {};
+			read(tail, &header, HEADER_SIZE);
+			tail += HEADER_SIZE;
+
+			Record record = { header.qpc, header.threadId, header.traceFuncName, header.traceType,
+				std::string(header.size, '\0') };
+			if (0 != header.size)
+			{
+				read(tail, &record.data.front(), header.size);
+			}
+			tail += header.size;
+			records.push_back(std::move(record));
+		}
+		m_tail.store(tail, std::memory_order_release);
+	}
+
+	std::uint32_t LogRingBuffer::getUsedSize() const
+	{
+		return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+	}
+
+	void LogRingBuffer::read(std::uint32_t pos, void* dst, std::uint32_t size) const
+	{
+		const std::uint32_t offset = pos % SIZE;
+		const std::uint32_t firstPart = std::min(size, SIZE - offset);
+		std::memcpy(dst, m_data + offset, firstPart);
+		std::memcpy(static_cast<char*>(dst) + firstPart, m_data, size - firstPart);
+	}
+
+	void LogRingBuffer::write(std::uint32_t pos, const void* src, std::uint32_t size)
+	{
+		const std::uint32_t offset = pos % SIZE;
+		const std::uint32_t firstPart = std::min(size, SIZE - offset);
+		std::memcpy(m_data + offset, src, firstPart);
+		std::memcpy(m_data, static_cast<const char*>(src) + firstPart, size - firstPart);
+	}
+
+	void drainLogRingBuffers(const std::vector<LogRingBuffer*>& buffers, std::vector<LogRingBuffer::Record>& records,
+		std::uint32_t& droppedCount)
+	{
+		for (auto buffer : buffers)
+		{
+			buffer->drain(records);
+			droppedCount += buffer->takeDroppedCount();
+		}
+
+		std::stable_sort(records.begin(), records.end(),
+			[](const LogRingBuffer::Record& r1, const LogRingBuffer::Record& r2) { return r1.qpc < r2.qpc; });
+	}
+}
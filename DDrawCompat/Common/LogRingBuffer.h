@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Common/TraceFormat.h"
+
+// Per-thread buffer of log records, written by the logging thread and drained by the log writer.
+// This file must stay free of Windows dependencies so the buffer can be tested on any platform.
+
+namespace Compat
+{
+	// Single producer (the owning thread), single consumer (the log writer)
+	class LogRingBuffer
+	{
+	public:
+		static const std::uint32_t SIZE = 64 * 1024;
+
+		// Binary trace events share the log buffers with text lines; traceFuncName is null for text lines
+		struct RecordHeader
+		{
+			long long qpc;
+			std::uint32_t threadId;
+			std::uint32_t size;
+			const char* traceFuncName;
+			Trace::RecordType traceType;
+		};
+
+		static const std::uint32_t HEADER_SIZE = sizeof(RecordHeader);
+		// Longer lines are split into several records and longer trace events are dropped,
+		// so that a record never exceeds the free space of an emptied buffer
+		static const std::uint32_t MAX_RECORD_DATA_SIZE = SIZE / 4 - HEADER_SIZE;
+
+		struct Record
+		{
+			long long qpc;
+			std::uint32_t threadId;
+			const char* traceFuncName;
+			Trace::RecordType traceType;
+			std::string data;
+		};
+
+		LogRingBuffer();
+
+		// Producer side. Returns false and counts the record as dropped if it does not fit.
+		bool push(const RecordHeader& header, const void* data);
+		void countDropped() { ++m_droppedCount; }
+
+		// Consumer side
+		void drain(std::vector<Record>& records);
+		std::uint32_t takeDroppedCount() { return m_droppedCount.exchange(0); }
+
+		std::uint32_t getUsedSize() const;
+		bool isEmpty() const { return 0 == getUsedSize(); }
+
+	private:
+		LogRingBuffer(const LogRingBuffer&) = delete;
+		LogRingBuffer& operator=(const LogRingBuffer&) = delete;
+
+		void read(std::uint32_t pos, void* dst, std::uint32_t size) const;
+		void write(std::uint32_t pos, const void* src, std::uint32_t size);
+
+		std::atomic<std::uint32_t> m_head;
+		std::atomic<std::uint32_t> m_tail;
+		std::atomic<std::uint32_t> m_droppedCount;
+		char m_data[SIZE];
+	};
+
+	// Drains all buffers into records sorted by time, keeping the order of records with equal times
+	void drainLogRingBuffers(const std::vector<LogRingBuffer*>& buffers, std::vector<LogRingBuffer::Record>& records,
+		std::uint32_t& droppedCount);
+
+	// Calls push(data, size) for consecutive pieces of text that fit into single records, until a push fails
+	template <typename Push>
+	bool pushLogText(const std::string& text, Push push)
+	{
+		std::size_t pos = 0;
+		do
+		{
+			const std::size_t remainingSize = text.size() - pos;
+			const std::uint32_t size = remainingSize < LogRingBuffer::MAX_RECORD_DATA_SIZE
+				? static_cast<std::uint32_t>(remainingSize) : LogRingBuffer::MAX_RECORD_DATA_SIZE;
+			if (!push(text.data() + pos, size))
+			{
+				return false;
+			}
+			pos += size;
+		} while (pos < text.size());
+		return true;
+	}
+}
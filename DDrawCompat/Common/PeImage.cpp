@@ -0,0 +1,230 @@
+#include <cctype>
+#include <cstring>
+
+#include "Common/PeImage.h"
+
+namespace
+{
+	const std::uint16_t DOS_SIGNATURE = 0x5A4D;
+	const std::uint32_t NT_SIGNATURE = 0x00004550;
+	const std::uint16_t PE32_MAGIC = 0x10B;
+	const std::uint16_t PE32_PLUS_MAGIC = 0x20B;
+	const std::uint32_t IMPORT_DIRECTORY_INDEX = 1;
+	const std::uint32_t ORDINAL_NAME = 0xFFFF;
+
+	// Offsets of the header fields used by the parser
+	const std::size_t DOS_LFANEW_OFFSET = 0x3C;
+	const std::size_t FILE_HEADER_OFFSET = 4;
+	const std::size_t FILE_TIME_DATE_STAMP_OFFSET = 4;
+	const std::size_t OPTIONAL_HEADER_OFFSET = 24;
+	const std::size_t PE32_RVA_COUNT_OFFSET = 92;
+	const std::size_t PE32_PLUS_RVA_COUNT_OFFSET = 108;
+	const std::size_t IMPORT_DESCRIPTOR_SIZE = 20;
+	const std::size_t IMPORT_NAME_OFFSET = 12;
+	const std::size_t IMPORT_FIRST_THUNK_OFFSET = 16;
+	const std::size_t IMPORT_BY_NAME_NAME_OFFSET = 2;
+
+	bool isEqualIgnoreCase(const char* a, const char* b)
+	{
+		for (; *a && *b; ++a, ++b)
+		{
+			if (std::tolower(static_cast<unsigned char>(*a)) != std::tolower(static_cast<unsigned char>(*b)))
+			{
+				return false;
+			}
+		}
+		return *a == *b;
+	}
+}
+
+namespace Compat
+{
+	template <typename T>
+	T PeImage::read(std::size_t offset) const
+	{
+		T value = 0;
+		if (offset < m_size && sizeof(T) <= m_size - offset)
+		{
+			std::memcpy(&value, m_image + offset, sizeof(value));
+		}
+		return value;
+	}
+
+	// Calls visitor(procName, iatOffset) for each import by name until it returns false
+	template <typename Visitor>
+	void PeImage::visitNamedImports(const Descriptor& desc, Visitor visitor) const
+	{
+		const std::uint64_t ordinalFlag = 1ull << (m_thunkSize * 8 - 1);
+		for (std::size_t index = 0; ; ++index)
+		{
+			const std::size_t iatEntry = desc.iatOffset + index * m_thunkSize;
+			const std::uint64_t lookupEntry = getThunk(desc.lookupTableOffset + index * m_thunkSize);
+			if (0 == lookupEntry || 0 == getThunk(iatEntry))
+			{
+				return;
+			}
+			if (lookupEntry & ordinalFlag)
+			{
+				continue;
+			}
+
+			const char* procName = lookupEntry < m_size
+				? getString(static_cast<std::size_t>(lookupEntry) + IMPORT_BY_NAME_NAME_OFFSET) : nullptr;
+			if (procName && !visitor(procName, iatEntry))
+			{
+				return;
+			}
+		}
+	}
+
+	PeImage::PeImage(const unsigned char* image, std::size_t size)
+		: m_image(image)
+		, m_size(image ? size : 0)
+		, m_timeDateStamp(0)
+		, m_thunkSize(0)
+		, m_isValid(false)
+	{
+		if (DOS_SIGNATURE != read<std::uint16_t>(0))
+		{
+			return;
+		}
+
+		const std::size_t ntHeaders = read<std::uint32_t>(DOS_LFANEW_OFFSET);
+		if (NT_SIGNATURE != read<std::uint32_t>(ntHeaders))
+		{
+			return;
+		}
+
+		const std::size_t optionalHeader = ntHeaders + OPTIONAL_HEADER_OFFSET;
+		std::size_t rvaCountOffset = 0;
+		switch (read<std::uint16_t>(optionalHeader))
+		{
+		case PE32_MAGIC:
+			m_thunkSize = 4;
+			rvaCountOffset = optionalHeader + PE32_RVA_COUNT_OFFSET;
+			break;
+		case PE32_PLUS_MAGIC:
+			m_thunkSize = 8;
+			rvaCountOffset = optionalHeader + PE32_PLUS_RVA_COUNT_OFFSET;
+			break;
+		default:
+			return;
+		}
+
+		m_timeDateStamp = read<std::uint32_t>(ntHeaders + FILE_HEADER_OFFSET + FILE_TIME_DATE_STAMP_OFFSET);
+		m_isValid = true;
+
+		// The data directories follow the count, each with an RVA and a size
+		if (read<std::uint32_t>(rvaCountOffset) <= IMPORT_DIRECTORY_INDEX)
+		{
+			return;
+		}
+		const std::size_t importDirectory = read<std::uint32_t>(rvaCountOffset + 4 + IMPORT_DIRECTORY_INDEX * 8);
+		if (0 == importDirectory)
+		{
+			return;
+		}
+
+		for (std::size_t desc = importDirectory; desc + IMPORT_DESCRIPTOR_SIZE <= m_size;
+			desc += IMPORT_DESCRIPTOR_SIZE)
+		{
+			const std::uint32_t lookupTable = read<std::uint32_t>(desc);
+			const std::uint32_t name = read<std::uint32_t>(desc + IMPORT_NAME_OFFSET);
+			if (0 == lookupTable || ORDINAL_NAME == name)
+			{
+				break;
+			}
+
+			const char* moduleName = getString(name);
+			if (moduleName)
+			{
+				m_descriptors.push_back({ moduleName, read<std::uint32_t>(desc + IMPORT_FIRST_THUNK_OFFSET),
+					lookupTable });
+			}
+		}
+	}
+
+	std::size_t PeImage::findImport(const char* moduleName, const char* procName) const
+	{
+		if (!moduleName || !procName)
+		{
+			return 0;
+		}
+
+		for (const auto& desc : m_descriptors)
+		{
+			if (isEqualIgnoreCase(desc.moduleName, moduleName))
+			{
+				std::size_t result = 0;
+				visitNamedImports(desc, [&](const char* name, std::size_t iatEntry)
+				{
+					if (0 == std::strcmp(name, procName))
+					{
+						result = iatEntry;
+					}
+					return 0 == result;
+				});
+				return result;
+			}
+		}
+		return 0;
+	}
+
+	void PeImage::findImports(const std::vector<Import>& imports, std::vector<std::size_t>& iatOffsets) const
+	{
+		iatOffsets.assign(imports.size(), 0);
+		std::vector<bool> isModuleFound(imports.size(), false);
+		std::vector<std::size_t> pendingImports;
+
+		for (const auto& desc : m_descriptors)
+		{
+			pendingImports.clear();
+			for (std::size_t i = 0; i < imports.size(); ++i)
+			{
+				if (!isModuleFound[i] && imports[i].moduleName && imports[i].procName &&
+					isEqualIgnoreCase(desc.moduleName, imports[i].moduleName))
+				{
+					pendingImports.push_back(i);
+					isModuleFound[i] = true;
+				}
+			}
+
+			if (pendingImports.empty())
+			{
+				continue;
+			}
+
+			visitNamedImports(desc, [&](const char* name, std::size_t iatEntry)
+			{
+				auto it = pendingImports.begin();
+				while (it != pendingImports.end())
+				{
+					if (0 == std::strcmp(name, imports[*it].procName))
+					{
+						iatOffsets[*it] = iatEntry;
+						it = pendingImports.erase(it);
+					}
+					else
+					{
+						++it;
+					}
+				}
+				return !pendingImports.empty();
+			});
+		}
+	}
+
+	const char* PeImage::getString(std::size_t offset) const
+	{
+		if (offset >= m_size || !std::memchr(m_image + offset, 0, m_size - offset))
+		{
+			return nullptr;
+		}
+		return reinterpret_cast<const char*>(m_image + offset);
+	}
+
+	std::uint64_t PeImage::getThunk(std::size_t offset) const
+	{
+		return 4 == m_thunkSize ? read<std::uint32_t>(offset) : read<std::uint64_t>(offset);
+	}
+}
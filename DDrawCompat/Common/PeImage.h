@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Parser for the import directory of a PE image mapped in memory, where RVAs are offsets into the image.
+// This file must stay free of Windows dependencies so the parser can be tested on any platform.
+
+namespace Compat
+{
+	class PeImage
+	{
+	public:
+		struct Import
+		{
+			const char* moduleName;
+			const char* procName;
+		};
+
+		// Parses the headers and the import descriptors once. Both PE32 and PE32+ images are supported,
+		// independently of the platform. An image with invalid headers has no imports.
+		PeImage(const unsigned char* image, std::size_t size);
+
+		// Returns the offset of the IAT entry of a function imported by name, or 0 if it isn't found
+		std::size_t findImport(const char* moduleName, const char* procName) const;
+		// Resolves all imports in one walk over each matching descriptor; iatOffsets[i] is set as by findImport
+		void findImports(const std::vector<Import>& imports, std::vector<std::size_t>& iatOffsets) const;
+
+		bool isValid() const { return m_isValid; }
+		std::uint32_t getTimeDateStamp() const { return m_timeDateStamp; }
+		std::size_t getSize() const { return m_size; }
+
+	private:
+		struct Descriptor
+		{
+			const char* moduleName;
+			std::size_t iatOffset;
+			std::size_t lookupTableOffset;
+		};
+
+		const char* getString(std::size_t offset) const;
+		std::uint64_t getThunk(std::size_t offset) const;
+		template <typename T> T read(std::size_t offset) const;
+		template <typename Visitor> void visitNamedImports(const Descriptor& desc, Visitor visitor) const;
+
+		const unsigned char* m_image;
+		std::size_t m_size;
+		std::uint32_t m_timeDateStamp;
+		std::size_t m_thunkSize;
+		std::vector<Descriptor> m_descriptors;
+		bool m_isValid;
+	};
+}
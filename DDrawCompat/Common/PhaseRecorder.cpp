@@ -0,0 +1,165 @@
+#include <sstream>
+
+#include "Common/PhaseRecorder.h"
+
+namespace
+{
+	typedef Compat::PhaseRecorder::Tree Tree;
+
+	double getDurationMs(const Compat::PhaseRecorder::Phase& phase)
+	{
+		return static_cast<double>(phase.endTimeNs - phase.startTimeNs) / 1000000;
+	}
+
+	void formatText(const Tree& tree, int index, const std::string& indent, std::vector<std::string>& lines)
+	{
+		const auto& phase = tree[index];
+		std::ostringstream os;
+		os.setf(std::ios::fixed);
+		os.precision(3);
+		os << indent << phase.name << ": " << getDurationMs(phase) << " ms";
+		if (0 != phase.hookCount)
+		{
+			os << ", " << phase.hookCount << " hooks";
+		}
+		if (0 != phase.moduleScanCount)
+		{
+			os << ", " << phase.moduleScanCount << " modules scanned";
+		}
+		lines.push_back(os.str());
+
+		for (int i = index + 1; i < static_cast<int>(tree.size()); ++i)
+		{
+			if (tree[i].parent == index)
+			{
+				formatText(tree, i, indent + "  ", lines);
+			}
+		}
+	}
+
+	void formatJson(std::ostream& os, const Tree& tree, int index)
+	{
+		const auto& phase = tree[index];
+		os << "{\"name\":\"" << phase.name << '"'
+			<< ",\"ms\":" << getDurationMs(phase)
+			<< ",\"hooks\":" << phase.hookCount
+			<< ",\"modulesScanned\":" << phase.moduleScanCount
+			<< ",\"children\":[";
+
+		bool isFirstChild = true;
+		for (int i = index + 1; i < static_cast<int>(tree.size()); ++i)
+		{
+			if (tree[i].parent == index)
+			{
+				if (!isFirstChild)
+				{
+					os << ',';
+				}
+				formatJson(os, tree, i);
+				isFirstChild = false;
+			}
+		}
+		os << "]}";
+	}
+}
+
+namespace Compat
+{
+	PhaseRecorder::PhaseRecorder(Clock getTimeNs)
+		: m_getTimeNs(getTimeNs)
+	{
+	}
+
+	void PhaseRecorder::begin(const char* name)
+	{
+		const long long timeNs = m_getTimeNs();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_openTrees.find(std::this_thread::get_id());
+		if (it == m_openTrees.end())
+		{
+			it = m_openTrees.insert({ std::this_thread::get_id(), OpenTree{ Tree(), -1 } }).first;
+		}
+
+		OpenTree& openTree = it->second;
+		openTree.tree.push_back({ name, openTree.current, timeNs, 0, 0, 0 });
+		openTree.current = static_cast<int>(openTree.tree.size()) - 1;
+	}
+
+	bool PhaseRecorder::end(Tree& finishedTree)
+	{
+		const long long timeNs = m_getTimeNs();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_openTrees.find(std::this_thread::get_id());
+		if (it == m_openTrees.end())
+		{
+			return false;
+		}
+
+		OpenTree& openTree = it->second;
+		Phase& phase = openTree.tree[openTree.current];
+		phase.endTimeNs = timeNs;
+		openTree.current = phase.parent;
+		if (openTree.current >= 0)
+		{
+			return false;
+		}
+
+		m_trees.push_back(std::move(openTree.tree));
+		m_openTrees.erase(it);
+		finishedTree = m_trees.back();
+		return true;
+	}
+
+	void PhaseRecorder::countHook()
+	{
+		count([](Phase& phase) { ++phase.hookCount; });
+	}
+
+	void PhaseRecorder::countModuleScan()
+	{
+		count([](Phase& phase) { ++phase.moduleScanCount; });
+	}
+
+	template <typename Count>
+	void PhaseRecorder::count(Count count)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_openTrees.find(std::this_thread::get_id());
+		if (it != m_openTrees.end())
+		{
+			Tree& tree = it->second.tree;
+			for (int i = it->second.current; i >= 0; i = tree[i].parent)
+			{
+				count(tree[i]);
+			}
+		}
+	}
+
+	std::vector<PhaseRecorder::Tree> PhaseRecorder::getTrees() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_trees;
+	}
+
+	std::vector<std::string> PhaseRecorder::formatText(const Tree& tree)
+	{
+		std::vector<std::string> lines;
+		if (!tree.empty())
+		{
+			::formatText(tree, 0, std::string(), lines);
+		}
+		return lines;
+	}
+
+	std::string PhaseRecorder::formatJson(const Tree& tree)
+	{
+		std::ostringstream os;
+		os.setf(std::ios::fixed);
+		os.precision(3);
+		if (!tree.empty())
+		{
+			::formatJson(os, tree, 0);
+		}
+		return os.str();
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records trees of nested phases with their durations, hook counts and module scan counts.
+// This file must stay free of Windows dependencies so the recorder can be tested on any platform.
+
+namespace Compat
+{
+	class PhaseRecorder
+	{
+	public:
+		struct Phase
+		{
+			std::string name;
+			int parent;
+			long long startTimeNs;
+			long long endTimeNs;
+			unsigned int hookCount;
+			unsigned int moduleScanCount;
+		};
+
+		// The root phase is first, and each phase precedes its children
+		typedef std::vector<Phase> Tree;
+
+		typedef long long(*Clock)();
+
+		PhaseRecorder(Clock getTimeNs);
+
+		// Phases are nested per thread. A phase started outside of other phases on its thread is the root of
+		// a new tree, which is kept separately from the trees of earlier roots.
+		void begin(const char* name);
+		// Returns true and the finished tree if the root phase of the calling thread was ended
+		bool end(Tree& finishedTree);
+
+		// Counts are added to the current phase of the calling thread and its ancestors
+		void countHook();
+		void countModuleScan();
+
+		std::vector<Tree> getTrees() const;
+
+		static std::vector<std::string> formatText(const Tree& tree);
+		static std::string formatJson(const Tree& tree);
+
+	private:
+		struct OpenTree
+		{
+			Tree tree;
+			int current;
+		};
+
+		template <typename Count>
+		void count(Count count);
+
+		Clock m_getTimeNs;
+		mutable std::mutex m_mutex;
+		std::map<std::thread::id, OpenTree> m_openTrees;
+		std::vector<Tree> m_trees;
+	};
+}
@@ -0,0 +1,58 @@
+#include "Common/Log.h"
+#include "Common/PhaseRecorder.h"
+#include "Common/PhaseTimer.h"
+#include "Common/Time.h"
+
+namespace
+{
+	long long getTimeNs()
+	{
+		if (0 == Time::g_qpcFrequency)
+		{
+			return 0;
+		}
+		return Time::qpcToNs(Time::queryPerformanceCounter());
+	}
+
+	Compat::PhaseRecorder g_phaseRecorder(&getTimeNs);
+
+	void reportPhases(const Compat::PhaseRecorder::Tree& tree)
+	{
+		Compat::Log() << "Startup profile:";
+		for (const auto& line : Compat::PhaseRecorder::formatText(tree))
+		{
+			Compat::Log() << "  " << line;
+		}
+		Compat::Log() << "Startup profile JSON: " << Compat::PhaseRecorder::formatJson(tree);
+	}
+}
+
+namespace Compat
+{
+	ScopedPhase::ScopedPhase(const char* name)
+	{
+		g_phaseRecorder.begin(name);
+	}
+
+	ScopedPhase::~ScopedPhase()
+	{
+		PhaseRecorder::Tree tree;
+		if (g_phaseRecorder.end(tree))
+		{
+			reportPhases(tree);
+		}
+	}
+
+	namespace PhaseTimer
+	{
+		void countHook()
+		{
+			g_phaseRecorder.countHook();
+		}
+
+		void countModuleScan()
+		{
+			g_phaseRecorder.countModuleScan();
+		}
+	}
+}
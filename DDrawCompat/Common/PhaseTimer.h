@@ -0,0 +1,21 @@
+#pragma once
+
+namespace Compat
+{
+	class ScopedPhase
+	{
+	public:
+		ScopedPhase(const char* name);
+		~ScopedPhase();
+
+	private:
+		ScopedPhase(const ScopedPhase&) = delete;
+		ScopedPhase& operator=(const ScopedPhase&) = delete;
+	};
+
+	namespace PhaseTimer
+	{
+		void countHook();
+		void countModuleScan();
+	}
+}
@@ -0,0 +1,100 @@
+#include <fstream>
+#include <sstream>
+
+#include "Common/Log.h"
+#include "Common/ProfiledLock.h"
+#include "Common/Time.h"
+#include "Config/Config.h"
+
+namespace
+{
+	std::string formatUs(long long ns)
+	{
+		std::ostringstream os;
+		os.setf(std::ios::fixed);
+		os.precision(1);
+		os << ns / 1000.0 << " us";
+		return os.str();
+	}
+
+	void writeTraceEvent(std::ostream& os, const char* name, const char* callSite, unsigned long threadId,
+		long long startNs, long long endNs, bool& isFirstEvent)
+	{
+		os << (isFirstEvent ? "" : ",") << "\n{\"name\":\"" << name << "\",\"cat\":\"lock\",\"ph\":\"X\""
+			<< ",\"ts\":" << startNs / 1000.0 << ",\"dur\":" << (endNs - startNs) / 1000.0
+			<< ",\"pid\":0,\"tid\":" << threadId
+			<< ",\"args\":{\"callSite\":\"" << callSite << "\"}}";
+		isFirstEvent = false;
+	}
+}
+
+namespace Compat
+{
+	void LockProfile::logReport()
+	{
+		for (LockProfile* lock = getHead().load(); lock; lock = lock->m_next)
+		{
+			Compat::Log() << "Lock profile for " << lock->m_name << ':';
+			for (const auto& site : lock->getSiteStats())
+			{
+				std::ostringstream os;
+				os << "  " << site.callSite << ": " << site.acquireCount << " acquisitions";
+				if (0 != site.acquireCount)
+				{
+					os << ", wait avg " << formatUs(site.totalWaitNs / static_cast<long long>(site.acquireCount))
+						<< ", max " << formatUs(site.maxWaitNs);
+				}
+				if (0 != site.holdCount)
+				{
+					os << ", hold avg " << formatUs(site.totalHoldNs / static_cast<long long>(site.holdCount))
+						<< ", max " << formatUs(site.maxHoldNs);
+				}
+				Compat::Log() << os.str();
+			}
+		}
+	}
+
+	void LockProfile::logPeriodicReport()
+	{
+		static long long qpcLastReport = Time::queryPerformanceCounter();
+		if (!getHead().load())
+		{
+			return;
+		}
+
+		const long long qpcNow = Time::queryPerformanceCounter();
+		if (Time::qpcToMs(qpcNow - qpcLastReport) >= Config::lockProfilingReportIntervalMs)
+		{
+			qpcLastReport = qpcNow;
+			logReport();
+		}
+	}
+
+	void LockProfile::writeChromeTrace(const char* fileName)
+	{
+		if (!getHead().load())
+		{
+			return;
+		}
+
+		std::ofstream os(fileName);
+		os << "{\"traceEvents\":[";
+		bool isFirstEvent = true;
+		for (LockProfile* lock = getHead().load(); lock; lock = lock->m_next)
+		{
+			const std::string waitName = std::string("wait: ") + lock->m_name;
+			const std::string holdName = std::string("hold: ") + lock->m_name;
+			for (const auto& event : lock->getEvents())
+			{
+				if (event.acquireNs != event.waitStartNs)
+				{
+					writeTraceEvent(os, waitName.c_str(), event.callSite, event.threadId,
+						event.waitStartNs, event.acquireNs, isFirstEvent);
+				}
+				writeTraceEvent(os, holdName.c_str(), event.callSite, event.threadId,
+					event.acquireNs, event.releaseNs, isFirstEvent);
+			}
+		}
+		os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	}
+}
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Lock wrapper that records wait and hold times per call site.
+// LockPolicy must provide lock(), unlock(), static getTimeNs() and static getThreadId().
+// Statistics are guarded by a mutex owned by the profiler, never by the wrapped lock, so that they can be reported
+// while the wrapped lock is held by another thread or has not been initialized yet.
+// lock() returns an acquisition id that must be passed to the matching unlock(), so that recursive
+// acquisitions released out of order are still attributed to the call site that made them.
+
+namespace Compat
+{
+	struct LockSiteStats
+	{
+		const char* callSite;
+		unsigned long long acquireCount;
+		unsigned long long holdCount;
+		long long totalWaitNs;
+		long long maxWaitNs;
+		long long totalHoldNs;
+		long long maxHoldNs;
+	};
+
+	struct LockEvent
+	{
+		const char* callSite;
+		unsigned long threadId;
+		long long waitStartNs;
+		long long acquireNs;
+		long long releaseNs;
+	};
+
+	class LockProfile
+	{
+	public:
+		LockProfile(const char* name) : m_name(name), m_next(nullptr) {}
+		virtual ~LockProfile() {}
+
+		const char* getName() const { return m_name; }
+		virtual std::vector<LockSiteStats> getSiteStats() = 0;
+		virtual std::vector<LockEvent> getEvents() = 0;
+
+		static void logReport();
+		static void logPeriodicReport();
+		static void writeChromeTrace(const char* fileName);
+
+	protected:
+		static void registerLock(LockProfile* lock)
+		{
+			lock->m_next = getHead().load();
+			while (!getHead().compare_exchange_weak(lock->m_next, lock))
+			{
+			}
+		}
+
+	private:
+		// Kept in the header, so that registering locks does not depend on the Windows specific reporting
+		static std::atomic<LockProfile*>& getHead()
+		{
+			static std::atomic<LockProfile*> head(nullptr);
+			return head;
+		}
+
+		const char* m_name;
+		LockProfile* m_next;
+	};
+
+	template <typename LockPolicy>
+	class ProfiledLock : public LockProfile
+	{
+	public:
+		typedef unsigned long long AcquisitionId;
+
+		// The last call site is reserved for the sum of all call sites that did not fit
+		static const unsigned int MAX_CALL_SITES = 64;
+		static const unsigned int MAX_EVENTS = 4096;
+
+		template <typename... Args>
+		ProfiledLock(const char* name, bool isProfilingEnabled, Args&&... args)
+			: LockProfile(name)
+			, m_lock(std::forward<Args>(args)...)
+			, m_isProfilingEnabled(isProfilingEnabled)
+			, m_eventCount(0)
+		{
+			if (m_isProfilingEnabled)
+			{
+				m_sites.reserve(MAX_CALL_SITES);
+				m_events.reserve(MAX_EVENTS);
+				registerLock(this);
+			}
+		}
+
+		AcquisitionId lock(const char* callSite)
+		{
+			if (!m_isProfilingEnabled)
+			{
+				m_lock.lock();
+				return 0;
+			}
+
+			const long long waitStartNs = LockPolicy::getTimeNs();
+			m_lock.lock();
+			const long long acquireNs = LockPolicy::getTimeNs();
+
+			Acquisition acquisition = { this, ++s_lastAcquisitionId, callSite, waitStartNs, acquireNs };
+			s_acquisitions.push_back(acquisition);
+
+			std::lock_guard<std::mutex> statsLock(m_statsMutex);
+			LockSiteStats& site = getSite(callSite);
+			const long long waitNs = acquireNs - waitStartNs;
+			++site.acquireCount;
+			site.totalWaitNs += waitNs;
+			site.maxWaitNs = std::max(site.maxWaitNs, waitNs);
+			return acquisition.id;
+		}
+
+		void unlock(AcquisitionId acquisitionId)
+		{
+			if (m_isProfilingEnabled)
+			{
+				recordRelease(acquisitionId);
+			}
+			m_lock.unlock();
+		}
+
+		virtual std::vector<LockSiteStats> getSiteStats() override
+		{
+			std::lock_guard<std::mutex> statsLock(m_statsMutex);
+			return m_sites;
+		}
+
+		virtual std::vector<LockEvent> getEvents() override
+		{
+			std::lock_guard<std::mutex> statsLock(m_statsMutex);
+			std::vector<LockEvent> events;
+			if (m_eventCount > m_events.size())
+			{
+				const std::size_t start = m_eventCount % MAX_EVENTS;
+				events.assign(m_events.begin() + start, m_events.end());
+				events.insert(events.end(), m_events.begin(), m_events.begin() + start);
+			}
+			else
+			{
+				events = m_events;
+			}
+			return events;
+		}
+
+	private:
+		struct Acquisition
+		{
+			ProfiledLock* lock;
+			AcquisitionId id;
+			const char* callSite;
+			long long waitStartNs;
+			long long acquireNs;
+		};
+
+		// m_statsMutex must be held
+		LockSiteStats& getSite(const char* callSite)
+		{
+			for (auto& site : m_sites)
+			{
+				if (site.callSite == callSite)
+				{
+					return site;
+				}
+			}
+
+			if (m_sites.size() < MAX_CALL_SITES - 1)
+			{
+				LockSiteStats site = {};
+				site.callSite = callSite;
+				m_sites.push_back(site);
+			}
+			else if (m_sites.size() < MAX_CALL_SITES)
+			{
+				LockSiteStats site = {};
+				site.callSite = "(other)";
+				m_sites.push_back(site);
+			}
+			return m_sites.back();
+		}
+
+		// Every acquisition records its own hold time, so nested acquisitions are included in the hold time
+		// of their outer acquisitions as well
+		void recordRelease(AcquisitionId acquisitionId)
+		{
+			auto it = std::find_if(s_acquisitions.begin(), s_acquisitions.end(),
+				[=](const Acquisition& acquisition) { return acquisition.id == acquisitionId; });
+			if (it == s_acquisitions.end() || it->lock != this)
+			{
+				return;
+			}
+
+			const Acquisition acquisition = *it;
+			s_acquisitions.erase(it);
+
+			const long long releaseNs = LockPolicy::getTimeNs();
+			const long long holdNs = releaseNs - acquisition.acquireNs;
+			std::lock_guard<std::mutex> statsLock(m_statsMutex);
+			LockSiteStats& site = getSite(acquisition.callSite);
+			++site.holdCount;
+			site.totalHoldNs += holdNs;
+			site.maxHoldNs = std::max(site.maxHoldNs, holdNs);
+
+			const LockEvent event = { acquisition.callSite, LockPolicy::getThreadId(),
+				acquisition.waitStartNs, acquisition.acquireNs, releaseNs };
+			if (m_events.size() < MAX_EVENTS)
+			{
+				m_events.push_back(event);
+			}
+			else
+			{
+				m_events[m_eventCount % MAX_EVENTS] = event;
+			}
+			++m_eventCount;
+		}
+
+		LockPolicy m_lock;
+		const bool m_isProfilingEnabled;
+		std::mutex m_statsMutex;
+		std::vector<LockSiteStats> m_sites;
+		std::vector<LockEvent> m_events;
+		unsigned long long m_eventCount;
+
+		static thread_local std::vector<Acquisition> s_acquisitions;
+		static thread_local AcquisitionId s_lastAcquisitionId;
+	};
+
+	template <typename Lock>
+	class ScopedProfiledLock
+	{
+	public:
+		ScopedProfiledLock(Lock& lock, const char* callSite)
+			: m_lock(lock), m_isLocked(false), m_acquisitionId(0)
+		{
+			this->lock(callSite);
+		}
+
+		~ScopedProfiledLock()
+		{
+			unlock();
+		}
+
+		void lock(const char* callSite)
+		{
+			if (!m_isLocked)
+			{
+				m_acquisitionId = m_lock.lock(callSite);
+				m_isLocked = true;
+			}
+		}
+
+		void unlock()
+		{
+			if (m_isLocked)
+			{
+				m_lock.unlock(m_acquisitionId);
+				m_isLocked = false;
+			}
+		}
+
+	private:
+		ScopedProfiledLock(const ScopedProfiledLock&) = delete;
+		ScopedProfiledLock& operator=(const ScopedProfiledLock&) = delete;
+
+		Lock& m_lock;
+		bool m_isLocked;
+		typename Lock::AcquisitionId m_acquisitionId;
+	};
+
+	template <typename LockPolicy>
+	thread_local std::vector<typename ProfiledLock<LockPolicy>::Acquisition> ProfiledLock<LockPolicy>::s_acquisitions;
+
+	template <typename LockPolicy>
+	thread_local typename ProfiledLock<LockPolicy>::AcquisitionId ProfiledLock<LockPolicy>::s_lastAcquisitionId = 0;
+}
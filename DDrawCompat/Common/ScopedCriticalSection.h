@@ -4,8 +4,29 @@
 
 #include <Windows.h>
 
+#include "Common/ProfiledLock.h"
+#include "Common/Time.h"
+
 namespace Compat
 {
+	class CriticalSectionLockPolicy
+	{
+	public:
+		CriticalSectionLockPolicy(CRITICAL_SECTION& cs) : m_cs(cs) {}
+
+		void lock() { EnterCriticalSection(&m_cs); }
+		void unlock() { LeaveCriticalSection(&m_cs); }
+
+		static long long getTimeNs() { return Time::qpcToNs(Time::queryPerformanceCounter()); }
+		static unsigned long getThreadId() { return GetCurrentThreadId(); }
+
+	private:
+		CRITICAL_SECTION& m_cs;
+	};
+
+	typedef ProfiledLock<CriticalSectionLockPolicy> ProfiledCriticalSection;
+	typedef ScopedProfiledLock<ProfiledCriticalSection> ScopedProfiledCriticalSection;
+
 	class ScopedCriticalSection
 	{
 	public:
@@ -20,6 +20,11 @@ namespace Time
 		return static_cast<int>(qpc * 1000 / g_qpcFrequency);
 	}
 
+	inline long long qpcToNs(long long qpc)
+	{
+		return qpc / g_qpcFrequency * 1000000000 + qpc % g_qpcFrequency * 1000000000 / g_qpcFrequency;
+	}
+
 	inline long long queryPerformanceCounter()
 	{
 		LARGE_INTEGER qpc = {};
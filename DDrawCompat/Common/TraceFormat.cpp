@@ -0,0 +1,657 @@
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <sstream>
+
+#include "Common/TraceFormat.h"
+
+namespace
+{
+	using namespace Compat::Trace;
+
+	const char TRACE_MAGIC[8] = { 'D', 'D', 'C', 'T', 'R', 'A', 'C', 'E' };
+	const std::uint32_t TRACE_VERSION = 2;
+
+	template <typename T>
+	void put(std::vector<unsigned char>& buffer, T value)
+	{
+		for (std::size_t i = 0; i < sizeof(T); ++i)
+		{
+			buffer.push_back(static_cast<unsigned char>(static_cast<std::uint64_t>(value) >> (8 * i)));
+		}
+	}
+
+	void putBytes(std::vector<unsigned char>& buffer, const void* data, std::size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		buffer.insert(buffer.end(), bytes, bytes + size);
+	}
+
+	class Reader
+	{
+	public:
+		Reader(const std::vector<unsigned char>& data) : m_data(data), m_pos(0), m_isValid(true) {}
+
+		template <typename T>
+		T get()
+		{
+			if (!require(sizeof(T)))
+			{
+				return T();
+			}
+
+			std::uint64_t value = 0;
+			for (std::size_t i = 0; i < sizeof(T); ++i)
+			{
+				value |= static_cast<std::uint64_t>(m_data[m_pos++]) << (8 * i);
+			}
+			return static_cast<T>(value);
+		}
+
+		std::string getBytes(std::size_t size)
+		{
+			if (!require(size))
+			{
+				return std::string();
+			}
+
+			std::string result(reinterpret_cast<const char*>(&m_data[m_pos]), size);
+			m_pos += size;
+			return result;
+		}
+
+		bool isAtEnd() const { return m_pos >= m_data.size(); }
+		bool isValid() const { return m_isValid; }
+		std::size_t getPos() const { return m_pos; }
+
+	private:
+		bool require(std::size_t size)
+		{
+			if (!m_isValid || m_data.size() - m_pos < size)
+			{
+				m_isValid = false;
+				return false;
+			}
+			return true;
+		}
+
+		const std::vector<unsigned char>& m_data;
+		std::size_t m_pos;
+		bool m_isValid;
+	};
+
+	bool decodeArg(Reader& reader, ArgType type, Arg& arg)
+	{
+		arg.type = type;
+		arg.isNull = false;
+		arg.value = 0;
+		std::memset(arg.rect, 0, sizeof(arg.rect));
+
+		switch (type)
+		{
+		case ArgType::INT:
+		case ArgType::UINT:
+		case ArgType::HEX:
+		case ArgType::POINTER:
+		case ArgType::OBJECT_POINTER:
+		case ArgType::DC:
+		case ArgType::WND:
+			arg.value = reader.get<std::uint64_t>();
+			break;
+
+		case ArgType::CHAR:
+		case ArgType::BOOL:
+			arg.value = reader.get<std::uint8_t>();
+			break;
+
+		case ArgType::STRING:
+			arg.isNull = 0 != reader.get<std::uint8_t>();
+			arg.str = reader.getBytes(reader.get<std::uint32_t>());
+			break;
+
+		case ArgType::WSTRING:
+		{
+			arg.isNull = 0 != reader.get<std::uint8_t>();
+			const std::uint32_t length = reader.get<std::uint32_t>();
+			for (std::uint32_t i = 0; i < length && reader.isValid(); ++i)
+			{
+				const std::uint16_t ch = reader.get<std::uint16_t>();
+				arg.str.push_back(ch < 0x80 ? static_cast<char>(ch) : '?');
+			}
+			break;
+		}
+
+		case ArgType::STRUCT_POINTER:
+			arg.value = reader.get<std::uint64_t>();
+			arg.isNull = 0 == arg.value;
+			if (arg.isNull)
+			{
+				break;
+			}
+			// fall through
+
+		case ArgType::STRUCT:
+			arg.str = reader.getBytes(reader.get<std::uint32_t>());
+			break;
+
+		case ArgType::RECT_POINTER:
+			arg.value = reader.get<std::uint64_t>();
+			arg.isNull = 0 == arg.value;
+			if (arg.isNull)
+			{
+				break;
+			}
+			// fall through
+
+		case ArgType::RECT:
+			for (int i = 0; i < 4; ++i)
+			{
+				arg.rect[i] = reader.get<std::int32_t>();
+			}
+			break;
+
+		default:
+			return false;
+		}
+
+		return reader.isValid();
+	}
+
+	void formatPointer(std::ostream& os, const FileHeader& header, std::uint64_t address)
+	{
+		char buf[20] = {};
+		std::snprintf(buf, sizeof(buf), "%0*llX",
+			static_cast<int>(2 * header.pointerSize), static_cast<unsigned long long>(address));
+		os << buf;
+	}
+
+	// Formats the bytes of a struct as little-endian 32-bit words, followed by any remaining bytes
+	void formatStruct(std::ostream& os, const std::string& bytes)
+	{
+		os << '{';
+		std::size_t pos = 0;
+		for (; pos + 4 <= bytes.size(); pos += 4)
+		{
+			std::uint32_t word = 0;
+			for (std::size_t i = 0; i < 4; ++i)
+			{
+				word |= static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[pos + i])) << (8 * i);
+			}
+
+			char buf[12] = {};
+			std::snprintf(buf, sizeof(buf), "%s%08X", 0 == pos ? "" : ",", static_cast<unsigned>(word));
+			os << buf;
+		}
+
+		for (; pos < bytes.size(); ++pos)
+		{
+			char buf[4] = {};
+			std::snprintf(buf, sizeof(buf), "%s%02X", 0 == pos ? "" : ",", static_cast<unsigned char>(bytes[pos]));
+			os << buf;
+		}
+		os << '}';
+	}
+
+	void formatArg(std::ostream& os, const FileHeader& header, const Arg& arg, bool isResult)
+	{
+		switch (arg.type)
+		{
+		case ArgType::INT:
+		case ArgType::UINT:
+			if (isResult)
+			{
+				os << std::hex << arg.value << std::dec;
+			}
+			else if (ArgType::INT == arg.type)
+			{
+				os << static_cast<std::int64_t>(arg.value);
+			}
+			else
+			{
+				os << arg.value;
+			}
+			break;
+
+		case ArgType::HEX:
+			os << "0x" << std::hex << arg.value << std::dec;
+			break;
+
+		case ArgType::CHAR:
+			os << static_cast<char>(arg.value);
+			break;
+
+		case ArgType::BOOL:
+			os << arg.value;
+			break;
+
+		case ArgType::POINTER:
+			formatPointer(os, header, arg.value);
+			break;
+
+		case ArgType::OBJECT_POINTER:
+			if (0 == arg.value)
+			{
+				os << "null";
+			}
+			else
+			{
+				formatPointer(os, header, arg.value);
+			}
+			break;
+
+		case ArgType::STRING:
+			os << (arg.isNull ? "null" : arg.str);
+			break;
+
+		case ArgType::WSTRING:
+			if (arg.isNull)
+			{
+				os << "null";
+			}
+			else
+			{
+				os << '"' << arg.str << '"';
+			}
+			break;
+
+		case ArgType::RECT:
+		case ArgType::RECT_POINTER:
+			if (arg.isNull)
+			{
+				os << "null";
+			}
+			else
+			{
+				os << '{' << arg.rect[0] << ',' << arg.rect[1] << ',' << arg.rect[2] << ',' << arg.rect[3] << '}';
+			}
+			break;
+
+		case ArgType::DC:
+		case ArgType::WND:
+			if (0 == arg.value)
+			{
+				os << "null";
+			}
+			else
+			{
+				os << (ArgType::DC == arg.type ? "DC(" : "WND(");
+				formatPointer(os, header, arg.value);
+				os << ')';
+			}
+			break;
+
+		case ArgType::STRUCT:
+		case ArgType::STRUCT_POINTER:
+			if (arg.isNull)
+			{
+				os << "null";
+			}
+			else
+			{
+				formatStruct(os, arg.str);
+			}
+			break;
+
+		default:
+			os << '?';
+			break;
+		}
+	}
+
+	std::uint64_t qpcToFileTime(const FileHeader& header, std::int64_t qpc)
+	{
+		if (0 == header.qpcFrequency)
+		{
+			return header.fileTimeBase;
+		}
+
+		const std::int64_t qpcDelta = qpc - header.qpcBase;
+		return header.fileTimeBase + qpcDelta / header.qpcFrequency * 10000000 +
+			qpcDelta % header.qpcFrequency * 10000000 / header.qpcFrequency;
+	}
+
+	void writeJsonString(std::ostream& os, const std::string& str)
+	{
+		os << '"';
+		for (char ch : str)
+		{
+			switch (ch)
+			{
+			case '"': os << "\\\""; break;
+			case '\\': os << "\\\\"; break;
+			case '\n': os << "\\n"; break;
+			case '\r': os << "\\r"; break;
+			case '\t': os << "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(ch) < 0x20)
+				{
+					char buf[8] = {};
+					std::snprintf(buf, sizeof(buf), "\\u%04x", ch);
+					os << buf;
+				}
+				else
+				{
+					os << ch;
+				}
+				break;
+			}
+		}
+		os << '"';
+	}
+
+	void formatArgList(std::ostream& os, const FileHeader& header, const Event& event)
+	{
+		for (std::size_t i = 0; i < event.args.size(); ++i)
+		{
+			if (0 != i)
+			{
+				os << ", ";
+			}
+			formatArg(os, header, event.args[i], false);
+		}
+	}
+}
+
+namespace Compat
+{
+	namespace Trace
+	{
+		void EventWriter::addInt(std::int64_t value)
+		{
+			put(m_args, ArgType::INT);
+			put(m_args, value);
+		}
+
+		void EventWriter::addUInt(std::uint64_t value)
+		{
+			put(m_args, ArgType::UINT);
+			put(m_args, value);
+		}
+
+		void EventWriter::addHex(std::uint64_t value)
+		{
+			put(m_args, ArgType::HEX);
+			put(m_args, value);
+		}
+
+		void EventWriter::addChar(char value)
+		{
+			put(m_args, ArgType::CHAR);
+			put(m_args, static_cast<std::uint8_t>(value));
+		}
+
+		void EventWriter::addBool(bool value)
+		{
+			put(m_args, ArgType::BOOL);
+			put(m_args, static_cast<std::uint8_t>(value ? 1 : 0));
+		}
+
+		void EventWriter::addPointer(std::uint64_t address)
+		{
+			put(m_args, ArgType::POINTER);
+			put(m_args, address);
+		}
+
+		void EventWriter::addObjectPointer(std::uint64_t address)
+		{
+			put(m_args, ArgType::OBJECT_POINTER);
+			put(m_args, address);
+		}
+
+		void EventWriter::addString(const char* str)
+		{
+			const std::uint32_t length = str ? static_cast<std::uint32_t>(std::strlen(str)) : 0;
+			put(m_args, ArgType::STRING);
+			put(m_args, static_cast<std::uint8_t>(str ? 0 : 1));
+			put(m_args, length);
+			putBytes(m_args, str, length);
+		}
+
+		void EventWriter::addWString(const wchar_t* str)
+		{
+			std::uint32_t length = 0;
+			while (str && str[length])
+			{
+				++length;
+			}
+
+			put(m_args, ArgType::WSTRING);
+			put(m_args, static_cast<std::uint8_t>(str ? 0 : 1));
+			put(m_args, length);
+			for (std::uint32_t i = 0; i < length; ++i)
+			{
+				put(m_args, static_cast<std::uint16_t>(str[i]));
+			}
+		}
+
+		void EventWriter::addRect(const std::int32_t (&rect)[4])
+		{
+			put(m_args, ArgType::RECT);
+			for (int i = 0; i < 4; ++i)
+			{
+				put(m_args, rect[i]);
+			}
+		}
+
+		void EventWriter::addRectPointer(std::uint64_t address, const std::int32_t* rect)
+		{
+			put(m_args, ArgType::RECT_POINTER);
+			put(m_args, rect ? address : 0);
+			if (rect)
+			{
+				for (int i = 0; i < 4; ++i)
+				{
+					put(m_args, rect[i]);
+				}
+			}
+		}
+
+		void EventWriter::addDc(std::uint64_t dc)
+		{
+			put(m_args, ArgType::DC);
+			put(m_args, dc);
+		}
+
+		void EventWriter::addWnd(std::uint64_t hwnd)
+		{
+			put(m_args, ArgType::WND);
+			put(m_args, hwnd);
+		}
+
+		void EventWriter::addStruct(const void* data, std::uint32_t size)
+		{
+			put(m_args, ArgType::STRUCT);
+			put(m_args, size);
+			putBytes(m_args, data, size);
+		}
+
+		void EventWriter::addStructPointer(std::uint64_t address, const void* data, std::uint32_t size)
+		{
+			put(m_args, ArgType::STRUCT_POINTER);
+			put(m_args, data ? address : 0);
+			if (data)
+			{
+				put(m_args, size);
+				putBytes(m_args, data, size);
+			}
+		}
+
+		void EventWriter::beginResult()
+		{
+			put(m_args, ArgType::RESULT);
+		}
+
+		void writeEvent(std::vector<unsigned char>& buffer, RecordType type, std::uint32_t funcId,
+			std::uint32_t threadId, std::int64_t qpc, const unsigned char* args, std::uint32_t argsSize)
+		{
+			put(buffer, type);
+			put(buffer, funcId);
+			put(buffer, threadId);
+			put(buffer, qpc);
+			put(buffer, argsSize);
+			putBytes(buffer, args, argsSize);
+		}
+
+		void writeFileHeader(std::vector<unsigned char>& buffer, const FileHeader& header)
+		{
+			putBytes(buffer, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+			put(buffer, TRACE_VERSION);
+			put(buffer, header.pointerSize);
+			put(buffer, header.qpcFrequency);
+			put(buffer, header.qpcBase);
+			put(buffer, header.fileTimeBase);
+		}
+
+		void writeName(std::vector<unsigned char>& buffer, std::uint32_t id, const char* name)
+		{
+			const std::uint32_t length = name ? static_cast<std::uint32_t>(std::strlen(name)) : 0;
+			put(buffer, RecordType::NAME);
+			put(buffer, id);
+			put(buffer, length);
+			putBytes(buffer, name, length);
+		}
+
+		bool decode(const std::vector<unsigned char>& data, TraceData& trace)
+		{
+			Reader reader(data);
+			if (reader.getBytes(sizeof(TRACE_MAGIC)) != std::string(TRACE_MAGIC, sizeof(TRACE_MAGIC)))
+			{
+				return false;
+			}
+
+			// Version 2 only added argument types, so version 1 traces decode the same way
+			const std::uint32_t version = reader.get<std::uint32_t>();
+			if (version < 1 || version > TRACE_VERSION)
+			{
+				return false;
+			}
+
+			trace.header.pointerSize = reader.get<std::uint32_t>();
+			trace.header.qpcFrequency = reader.get<std::int64_t>();
+			trace.header.qpcBase = reader.get<std::int64_t>();
+			trace.header.fileTimeBase = reader.get<std::uint64_t>();
+			trace.events.clear();
+
+			std::map<std::uint32_t, std::string> names;
+			while (reader.isValid() && !reader.isAtEnd())
+			{
+				const RecordType type = reader.get<RecordType>();
+				if (RecordType::NAME == type)
+				{
+					const std::uint32_t id = reader.get<std::uint32_t>();
+					names[id] = reader.getBytes(reader.get<std::uint32_t>());
+					continue;
+				}
+
+				if (RecordType::ENTER != type && RecordType::LEAVE != type)
+				{
+					return false;
+				}
+
+				Event event = {};
+				event.type = type;
+				const std::uint32_t funcId = reader.get<std::uint32_t>();
+				event.threadId = reader.get<std::uint32_t>();
+				event.qpc = reader.get<std::int64_t>();
+				const std::uint32_t argsSize = reader.get<std::uint32_t>();
+				const std::size_t argsEnd = reader.getPos() + argsSize;
+				event.funcName = names[funcId];
+
+				while (reader.isValid() && reader.getPos() < argsEnd)
+				{
+					ArgType argType = reader.get<ArgType>();
+					const bool isResult = ArgType::RESULT == argType;
+					if (isResult)
+					{
+						argType = reader.get<ArgType>();
+					}
+
+					Arg arg = {};
+					if (!decodeArg(reader, argType, arg))
+					{
+						return false;
+					}
+
+					if (isResult)
+					{
+						event.hasResult = true;
+						event.result = arg;
+					}
+					else
+					{
+						event.args.push_back(arg);
+					}
+				}
+
+				if (!reader.isValid() || reader.getPos() != argsEnd)
+				{
+					return false;
+				}
+				trace.events.push_back(event);
+			}
+
+			return reader.isValid();
+		}
+
+		std::string formatText(const FileHeader& header, const Event& event)
+		{
+			const std::uint64_t msOfDay = qpcToFileTime(header, event.qpc) / 10000 % (24 * 60 * 60 * 1000);
+			char time[20] = {};
+			std::snprintf(time, sizeof(time), "%02u:%02u:%02u.%03u ",
+				static_cast<unsigned>(msOfDay / 3600000), static_cast<unsigned>(msOfDay / 60000 % 60),
+				static_cast<unsigned>(msOfDay / 1000 % 60), static_cast<unsigned>(msOfDay % 1000));
+
+			std::ostringstream os;
+			os << event.threadId << ' ' << time << (RecordType::ENTER == event.type ? "-->" : "<--")
+				<< ' ' << event.funcName << '(';
+			formatArgList(os, header, event);
+			os << ')';
+
+			if (event.hasResult)
+			{
+				os << " = ";
+				formatArg(os, header, event.result, true);
+			}
+			return os.str();
+		}
+
+		std::string formatChromeJson(const TraceData& trace)
+		{
+			std::ostringstream os;
+			os << "{\"traceEvents\":[";
+
+			const std::int64_t qpcFrequency = 0 != trace.header.qpcFrequency ? trace.header.qpcFrequency : 1;
+			bool isFirstEvent = true;
+			for (const auto& event : trace.events)
+			{
+				const std::int64_t qpcDelta = event.qpc - trace.header.qpcBase;
+				const std::int64_t us = qpcDelta / qpcFrequency * 1000000 +
+					qpcDelta % qpcFrequency * 1000000 / qpcFrequency;
+
+				std::ostringstream params;
+				formatArgList(params, trace.header, event);
+
+				os << (isFirstEvent ? "" : ",") << "\n{\"name\":";
+				writeJsonString(os, event.funcName);
+				os << ",\"ph\":\"" << (RecordType::ENTER == event.type ? 'B' : 'E') << '"'
+					<< ",\"ts\":" << us
+					<< ",\"pid\":0,\"tid\":" << event.threadId
+					<< ",\"args\":{\"params\":";
+				writeJsonString(os, params.str());
+
+				if (event.hasResult)
+				{
+					std::ostringstream result;
+					formatArg(result, trace.header, event.result, true);
+					os << ",\"result\":";
+					writeJsonString(os, result.str());
+				}
+				os << "}}";
+				isFirstEvent = false;
+			}
+
+			os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+			return os.str();
+		}
+	}
+}
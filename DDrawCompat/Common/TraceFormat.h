@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary trace format used by LogEnter/LogLeave when Config::binaryTraceLog is enabled.
+// This file must stay free of Windows dependencies so traces can be decoded on any platform.
+
+namespace Compat
+{
+	namespace Trace
+	{
+		enum class RecordType : std::uint8_t
+		{
+			NAME,
+			ENTER,
+			LEAVE
+		};
+
+		enum class ArgType : std::uint8_t
+		{
+			INT,
+			UINT,
+			HEX,
+			CHAR,
+			BOOL,
+			POINTER,
+			OBJECT_POINTER,
+			STRING,
+			WSTRING,
+			RECT,
+			RECT_POINTER,
+			DC,
+			WND,
+			STRUCT,
+			STRUCT_POINTER,
+			RESULT = 0xFF
+		};
+
+		struct FileHeader
+		{
+			std::uint32_t pointerSize;
+			std::int64_t qpcFrequency;
+			std::int64_t qpcBase;
+			std::uint64_t fileTimeBase;
+		};
+
+		class EventWriter
+		{
+		public:
+			void addInt(std::int64_t value);
+			void addUInt(std::uint64_t value);
+			void addHex(std::uint64_t value);
+			void addChar(char value);
+			void addBool(bool value);
+			void addPointer(std::uint64_t address);
+			void addObjectPointer(std::uint64_t address);
+			void addString(const char* str);
+			void addWString(const wchar_t* str);
+			void addRect(const std::int32_t (&rect)[4]);
+			void addRectPointer(std::uint64_t address, const std::int32_t* rect);
+			void addDc(std::uint64_t dc);
+			void addWnd(std::uint64_t hwnd);
+			// Structs are recorded as raw bytes, prefixed by their size
+			void addStruct(const void* data, std::uint32_t size);
+			void addStructPointer(std::uint64_t address, const void* data, std::uint32_t size);
+			void beginResult();
+
+			const std::vector<unsigned char>& getArgs() const { return m_args; }
+
+		private:
+			std::vector<unsigned char> m_args;
+		};
+
+		void writeEvent(std::vector<unsigned char>& buffer, RecordType type, std::uint32_t funcId,
+			std::uint32_t threadId, std::int64_t qpc, const unsigned char* args, std::uint32_t argsSize);
+		void writeFileHeader(std::vector<unsigned char>& buffer, const FileHeader& header);
+		void writeName(std::vector<unsigned char>& buffer, std::uint32_t id, const char* name);
+
+		struct Arg
+		{
+			ArgType type;
+			bool isNull;
+			std::uint64_t value;
+			std::int32_t rect[4];
+			// The characters of strings or the bytes of structs
+			std::string str;
+		};
+
+		struct Event
+		{
+			RecordType type;
+			std::uint32_t threadId;
+			std::int64_t qpc;
+			std::string funcName;
+			std::vector<Arg> args;
+			bool hasResult;
+			Arg result;
+		};
+
+		struct TraceData
+		{
+			FileHeader header;
+			std::vector<Event> events;
+		};
+
+		bool decode(const std::vector<unsigned char>& data, TraceData& trace);
+		std::string formatText(const FileHeader& header, const Event& event);
+		std::string formatChromeJson(const TraceData& trace);
+	}
+}
@@ -30,7 +30,7 @@ std::string getTypeName()
 		visitor.visitDebug<decltype(&Vtable::member), &Vtable::member>(getTypeName<Vtable>(), #member)
 #else
 #define DD_VISIT(member) \
-		visitor.visit<decltype(&Vtable::member), &Vtable::member>()
+		visitor.visit<decltype(&Vtable::member), &Vtable::member>(getTypeName<Vtable>(), #member)
 #endif
 
 template <>
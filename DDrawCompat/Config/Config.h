@@ -4,8 +4,16 @@ typedef unsigned long DWORD;
 
 namespace Config
 {
+	const bool batchGdiRendering = false;
+	const bool binaryTraceLog = false;
+	const DWORD callSamplingInterval = 64; // must be a power of 2
+	const bool lockProfiling = false;
+	const int lockProfilingReportIntervalMs = 10000;
 	const int maxPaletteUpdatesPerMs = 5;
 	const int minExpectedFlipsPerSec = 5;
 	const DWORD preallocatedGdiDcCount = 4;
 	const DWORD primarySurfaceExtraRows = 2;
+	const bool softwareBlitter = true; // overridden by the DDRAWCOMPAT_SOFTWARE_BLITTER environment variable
+	const bool softwareGamma = true;
+	const DWORD surfaceRepositoryBudgetKb = 65536;
 }
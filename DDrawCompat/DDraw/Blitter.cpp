@@ -0,0 +1,571 @@
+#include <cstring>
+
+#include <emmintrin.h>
+
+#include <Windows.h>
+
+#include "DDraw/Blitter.h"
+
+namespace
+{
+	using DDraw::Blitter::BltParams;
+	using DDraw::Blitter::Image;
+
+	// Fills larger than this bypass the cache, as the filled surface is unlikely to be read back soon
+	const DWORD NON_TEMPORAL_FILL_THRESHOLD = 512 * 1024;
+
+	struct Pixel24
+	{
+		BYTE bytes[3];
+	};
+
+	struct KeyParams
+	{
+		DWORD mask;
+		DWORD srcKey;
+		DWORD dstKey;
+		bool isSrcKey;
+		bool isDstKey;
+	};
+
+	struct Rows
+	{
+		BYTE* dst;
+		const BYTE* src;
+		LONG dstPitch;
+		LONG srcPitch;
+		LONG height;
+	};
+
+	template <typename Pixel> struct Simd;
+
+	template <>
+	struct Simd<BYTE>
+	{
+		static __m128i set1(DWORD value) { return _mm_set1_epi8(static_cast<char>(value)); }
+		static __m128i cmpeq(__m128i a, __m128i b) { return _mm_cmpeq_epi8(a, b); }
+	};
+
+	template <>
+	struct Simd<WORD>
+	{
+		static __m128i set1(DWORD value) { return _mm_set1_epi16(static_cast<short>(value)); }
+		static __m128i cmpeq(__m128i a, __m128i b) { return _mm_cmpeq_epi16(a, b); }
+	};
+
+	template <>
+	struct Simd<DWORD>
+	{
+		static __m128i set1(DWORD value) { return _mm_set1_epi32(static_cast<int>(value)); }
+		static __m128i cmpeq(__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); }
+	};
+
+	template <typename Pixel>
+	DWORD getPixel(const Pixel& pixel)
+	{
+		return pixel;
+	}
+
+	template <>
+	DWORD getPixel(const Pixel24& pixel)
+	{
+		return pixel.bytes[0] | (pixel.bytes[1] << 8) | (pixel.bytes[2] << 16);
+	}
+
+	template <typename Pixel>
+	void setPixel(Pixel& pixel, DWORD value)
+	{
+		pixel = static_cast<Pixel>(value);
+	}
+
+	template <>
+	void setPixel(Pixel24& pixel, DWORD value)
+	{
+		pixel.bytes[0] = static_cast<BYTE>(value);
+		pixel.bytes[1] = static_cast<BYTE>(value >> 8);
+		pixel.bytes[2] = static_cast<BYTE>(value >> 16);
+	}
+
+	DWORD lerpChannel(DWORD a, DWORD b, DWORD mask, DWORD weight)
+	{
+		const unsigned long long result = (static_cast<unsigned long long>(a & mask) * (256 - weight) +
+			static_cast<unsigned long long>(b & mask) * weight) >> 8;
+		return static_cast<DWORD>(result) & mask;
+	}
+
+	DWORD lerpPixel(DWORD a, DWORD b, const DDPIXELFORMAT& pf, DWORD weight)
+	{
+		DWORD result = lerpChannel(a, b, pf.dwRBitMask, weight) |
+			lerpChannel(a, b, pf.dwGBitMask, weight) |
+			lerpChannel(a, b, pf.dwBBitMask, weight);
+		if (pf.dwFlags & DDPF_ALPHAPIXELS)
+		{
+			result |= lerpChannel(a, b, pf.dwRGBAlphaBitMask, weight);
+		}
+		return result;
+	}
+
+	template <typename Pixel>
+	bool isDstKept(const Pixel& dst, const Pixel& src, const KeyParams& keys)
+	{
+		return (keys.isSrcKey && (getPixel(src) & keys.mask) == keys.srcKey) ||
+			(keys.isDstKey && (getPixel(dst) & keys.mask) != keys.dstKey);
+	}
+
+	// Rows are visited bottom-up when the destination lies below an overlapping source in the same surface,
+	// so that no source row is overwritten before it is read
+	Rows getRows(const Image& dst, const Image& src, const BltParams& params)
+	{
+		Rows rows = {};
+		rows.dst = static_cast<BYTE*>(dst.surface) +
+			params.dstRect.top * dst.pitch + params.dstRect.left * dst.bytesPerPixel;
+		rows.src = static_cast<const BYTE*>(src.surface) +
+			params.srcRect.top * src.pitch + params.srcRect.left * src.bytesPerPixel;
+		rows.dstPitch = dst.pitch;
+		rows.srcPitch = src.pitch;
+		rows.height = params.dstRect.bottom - params.dstRect.top;
+
+		if (dst.surface == src.surface && params.dstRect.top > params.srcRect.top)
+		{
+			rows.dst += (rows.height - 1) * dst.pitch;
+			rows.src += (rows.height - 1) * src.pitch;
+			rows.dstPitch = -rows.dstPitch;
+			rows.srcPitch = -rows.srcPitch;
+		}
+		return rows;
+	}
+
+	template <typename Pixel>
+	void bltKeyedRowBackward(Pixel* dst, const Pixel* src, LONG width, const KeyParams& keys)
+	{
+		for (LONG x = width - 1; x >= 0; --x)
+		{
+			if (!isDstKept(dst[x], src[x], keys))
+			{
+				dst[x] = src[x];
+			}
+		}
+	}
+
+	template <typename Pixel>
+	void bltKeyedRowScalar(Pixel* dst, const Pixel* src, LONG width, const KeyParams& keys)
+	{
+		for (LONG x = 0; x < width; ++x)
+		{
+			if (!isDstKept(dst[x], src[x], keys))
+			{
+				dst[x] = src[x];
+			}
+		}
+	}
+
+	// Selects between the source and destination pixels with SSE2 compare masks, 16 bytes at a time
+	template <typename Pixel>
+	void bltKeyedRow(Pixel* dst, const Pixel* src, LONG width, const KeyParams& keys)
+	{
+		const LONG pixelsPerVector = sizeof(__m128i) / sizeof(Pixel);
+		const __m128i mask = Simd<Pixel>::set1(keys.mask);
+		const __m128i srcKey = Simd<Pixel>::set1(keys.srcKey);
+		const __m128i dstKey = Simd<Pixel>::set1(keys.dstKey);
+		const __m128i allOnes = _mm_set1_epi32(-1);
+
+		LONG x = 0;
+		for (; x + pixelsPerVector <= width; x += pixelsPerVector)
+		{
+			const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+			const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + x));
+
+			__m128i keep = _mm_setzero_si128();
+			if (keys.isSrcKey)
+			{
+				keep = Simd<Pixel>::cmpeq(_mm_and_si128(s, mask), srcKey);
+			}
+			if (keys.isDstKey)
+			{
+				keep = _mm_or_si128(keep,
+					_mm_xor_si128(Simd<Pixel>::cmpeq(_mm_and_si128(d, mask), dstKey), allOnes));
+			}
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x),
+				_mm_or_si128(_mm_and_si128(keep, d), _mm_andnot_si128(keep, s)));
+		}
+
+		bltKeyedRowScalar(dst + x, src + x, width - x, keys);
+	}
+
+	template <>
+	void bltKeyedRow(Pixel24* dst, const Pixel24* src, LONG width, const KeyParams& keys)
+	{
+		bltKeyedRowScalar(dst, src, width, keys);
+	}
+
+	template <typename Pixel>
+	void bltKeyed(const Image& dst, const Image& src, const BltParams& params, const KeyParams& keys)
+	{
+		const LONG width = params.dstRect.right - params.dstRect.left;
+		Rows rows = getRows(dst, src, params);
+
+		// Overlapping pixels within a row are only at risk when the source is to the left of the destination
+		const bool isBackward = dst.surface == src.surface &&
+			params.dstRect.top == params.srcRect.top && params.dstRect.left > params.srcRect.left;
+
+		for (LONG y = 0; y < rows.height; ++y)
+		{
+			Pixel* dstRow = reinterpret_cast<Pixel*>(rows.dst);
+			const Pixel* srcRow = reinterpret_cast<const Pixel*>(rows.src);
+			if (isBackward)
+			{
+				bltKeyedRowBackward(dstRow, srcRow, width, keys);
+			}
+			else
+			{
+				bltKeyedRow(dstRow, srcRow, width, keys);
+			}
+			rows.dst += rows.dstPitch;
+			rows.src += rows.srcPitch;
+		}
+	}
+
+	// Samples the source at the center of each destination pixel using 16.16 fixed point steps
+	template <typename Pixel>
+	void bltStretched(const Image& dst, const Image& src, const BltParams& params, const KeyParams& keys)
+	{
+		const LONG dstWidth = params.dstRect.right - params.dstRect.left;
+		const LONG dstHeight = params.dstRect.bottom - params.dstRect.top;
+		const LONG srcWidth = params.srcRect.right - params.srcRect.left;
+		const LONG srcHeight = params.srcRect.bottom - params.srcRect.top;
+		const LONG stepX = (srcWidth << 16) / dstWidth;
+		const LONG stepY = (srcHeight << 16) / dstHeight;
+		const bool isLinearY = params.linearFilterPf && srcHeight != dstHeight;
+
+		auto getSrcRow = [&](LONG row)
+		{
+			if (params.isMirroredUpDown)
+			{
+				row = srcHeight - 1 - row;
+			}
+			return reinterpret_cast<const Pixel*>(static_cast<const BYTE*>(src.surface) +
+				(params.srcRect.top + row) * src.pitch) + params.srcRect.left;
+		};
+
+		LONG srcY = stepY / 2;
+		for (LONG y = 0; y < dstHeight; ++y, srcY += stepY)
+		{
+			const Pixel* srcRow = getSrcRow(srcY >> 16);
+			const Pixel* nextSrcRow = srcRow;
+			DWORD weight = 0;
+			if (isLinearY && srcY >= 0x8000)
+			{
+				const LONG filterY = srcY - 0x8000;
+				const LONG filterRow = filterY >> 16;
+				srcRow = getSrcRow(filterRow);
+				nextSrcRow = filterRow + 1 < srcHeight ? getSrcRow(filterRow + 1) : srcRow;
+				weight = (filterY >> 8) & 0xFF;
+			}
+
+			Pixel* dstRow = reinterpret_cast<Pixel*>(static_cast<BYTE*>(dst.surface) +
+				(params.dstRect.top + y) * dst.pitch) + params.dstRect.left;
+
+			LONG srcX = stepX / 2;
+			for (LONG x = 0; x < dstWidth; ++x, srcX += stepX)
+			{
+				const LONG column = params.isMirroredLeftRight ? srcWidth - 1 - (srcX >> 16) : srcX >> 16;
+				const Pixel& srcPixel = srcRow[column];
+				if ((keys.isSrcKey || keys.isDstKey) && isDstKept(dstRow[x], srcPixel, keys))
+				{
+					continue;
+				}
+
+				if (0 == weight)
+				{
+					dstRow[x] = srcPixel;
+				}
+				else
+				{
+					setPixel(dstRow[x], lerpPixel(getPixel(srcPixel), getPixel(nextSrcRow[column]),
+						*params.linearFilterPf, weight));
+				}
+			}
+		}
+	}
+
+	struct AndOp
+	{
+		__m128i operator()(__m128i dst, __m128i src) const { return _mm_and_si128(dst, src); }
+		BYTE operator()(BYTE dst, BYTE src) const { return dst & src; }
+	};
+
+	struct OrOp
+	{
+		__m128i operator()(__m128i dst, __m128i src) const { return _mm_or_si128(dst, src); }
+		BYTE operator()(BYTE dst, BYTE src) const { return dst | src; }
+	};
+
+	struct XorOp
+	{
+		__m128i operator()(__m128i dst, __m128i src) const { return _mm_xor_si128(dst, src); }
+		BYTE operator()(BYTE dst, BYTE src) const { return dst ^ src; }
+	};
+
+	struct InvertOp
+	{
+		__m128i operator()(__m128i dst, __m128i /*src*/) const { return _mm_xor_si128(dst, _mm_set1_epi32(-1)); }
+		BYTE operator()(BYTE dst, BYTE /*src*/) const { return static_cast<BYTE>(~dst); }
+	};
+
+	// Bitwise raster operations are independent of the pixel format, so rows are processed as bytes
+	template <typename Op>
+	void ropRows(BYTE* dstRow, LONG dstPitch, const BYTE* srcRow, LONG srcPitch, DWORD rowSize, LONG height, Op op)
+	{
+		for (LONG y = 0; y < height; ++y)
+		{
+			DWORD x = 0;
+			for (; x + sizeof(__m128i) <= rowSize; x += sizeof(__m128i))
+			{
+				const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcRow + x));
+				const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dstRow + x));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dstRow + x), op(d, s));
+			}
+
+			for (; x < rowSize; ++x)
+			{
+				dstRow[x] = op(dstRow[x], srcRow[x]);
+			}
+
+			dstRow += dstPitch;
+			srcRow += srcPitch;
+		}
+	}
+
+	void bltRop(const Image& dst, const Image& src, const BltParams& params)
+	{
+		const DWORD rowSize = (params.dstRect.right - params.dstRect.left) * dst.bytesPerPixel;
+		const LONG height = params.dstRect.bottom - params.dstRect.top;
+
+		BYTE* dstRow = static_cast<BYTE*>(dst.surface) +
+			params.dstRect.top * dst.pitch + params.dstRect.left * dst.bytesPerPixel;
+		const BYTE* srcRow = static_cast<const BYTE*>(src.surface) +
+			params.srcRect.top * src.pitch + params.srcRect.left * src.bytesPerPixel;
+
+		switch (params.rop)
+		{
+		case SRCAND:
+			ropRows(dstRow, dst.pitch, srcRow, src.pitch, rowSize, height, AndOp());
+			break;
+		case SRCPAINT:
+			ropRows(dstRow, dst.pitch, srcRow, src.pitch, rowSize, height, OrOp());
+			break;
+		case SRCINVERT:
+			ropRows(dstRow, dst.pitch, srcRow, src.pitch, rowSize, height, XorOp());
+			break;
+		}
+	}
+
+	void storeCached(__m128i* dst, __m128i value)
+	{
+		_mm_store_si128(dst, value);
+	}
+
+	void storeNonTemporal(__m128i* dst, __m128i value)
+	{
+		_mm_stream_si128(dst, value);
+	}
+
+	// Pixels are written one by one up to the first 16 byte boundary, then with aligned vector stores
+	template <void(*store)(__m128i*, __m128i)>
+	void fillRow(BYTE* dst, DWORD rowSize, __m128i pattern, DWORD bytesPerPixel)
+	{
+		while (0 != (reinterpret_cast<UINT_PTR>(dst) & (sizeof(__m128i) - 1)) && rowSize >= bytesPerPixel)
+		{
+			memcpy(dst, &pattern, bytesPerPixel);
+			dst += bytesPerPixel;
+			rowSize -= bytesPerPixel;
+		}
+
+		while (rowSize >= sizeof(__m128i))
+		{
+			store(reinterpret_cast<__m128i*>(dst), pattern);
+			dst += sizeof(__m128i);
+			rowSize -= sizeof(__m128i);
+		}
+
+		memcpy(dst, &pattern, rowSize);
+	}
+
+	void bltCopy(const Image& dst, const Image& src, const BltParams& params)
+	{
+		const LONG rowSize = (params.dstRect.right - params.dstRect.left) * dst.bytesPerPixel;
+		Rows rows = getRows(dst, src, params);
+
+		for (LONG y = 0; y < rows.height; ++y)
+		{
+			memmove(rows.dst, rows.src, rowSize);
+			rows.dst += rows.dstPitch;
+			rows.src += rows.srcPitch;
+		}
+	}
+}
+
+namespace DDraw
+{
+	namespace Blitter
+	{
+		void blt(const Image& dst, const Image& src, const BltParams& params)
+		{
+			if (0 != params.rop && SRCCOPY != params.rop)
+			{
+				bltRop(dst, src, params);
+				return;
+			}
+
+			const bool isStretched = params.isMirroredLeftRight || params.isMirroredUpDown ||
+				params.dstRect.right - params.dstRect.left != params.srcRect.right - params.srcRect.left ||
+				params.dstRect.bottom - params.dstRect.top != params.srcRect.bottom - params.srcRect.top;
+			if (!isStretched && !params.srcColorKey && !params.dstColorKey)
+			{
+				bltCopy(dst, src, params);
+				return;
+			}
+
+			KeyParams keys = {};
+			keys.mask = params.colorKeyMask;
+			keys.isSrcKey = nullptr != params.srcColorKey;
+			keys.isDstKey = nullptr != params.dstColorKey;
+			keys.srcKey = keys.isSrcKey ? params.srcColorKey->dwColorSpaceLowValue & keys.mask : 0;
+			keys.dstKey = keys.isDstKey ? params.dstColorKey->dwColorSpaceLowValue & keys.mask : 0;
+
+			if (isStretched)
+			{
+				switch (dst.bytesPerPixel)
+				{
+				case 1:
+					bltStretched<BYTE>(dst, src, params, keys);
+					break;
+				case 2:
+					bltStretched<WORD>(dst, src, params, keys);
+					break;
+				case 3:
+					bltStretched<Pixel24>(dst, src, params, keys);
+					break;
+				case 4:
+					bltStretched<DWORD>(dst, src, params, keys);
+					break;
+				}
+				return;
+			}
+
+			switch (dst.bytesPerPixel)
+			{
+			case 1:
+				bltKeyed<BYTE>(dst, src, params, keys);
+				break;
+			case 2:
+				bltKeyed<WORD>(dst, src, params, keys);
+				break;
+			case 3:
+				bltKeyed<Pixel24>(dst, src, params, keys);
+				break;
+			case 4:
+				bltKeyed<DWORD>(dst, src, params, keys);
+				break;
+			}
+		}
+
+		void colorFill(const Image& dst, const RECT& rect, DWORD color)
+		{
+			const DWORD rowSize = (rect.right - rect.left) * dst.bytesPerPixel;
+			const LONG height = rect.bottom - rect.top;
+			BYTE* dstRow = static_cast<BYTE*>(dst.surface) + rect.top * dst.pitch + rect.left * dst.bytesPerPixel;
+
+			if (3 == dst.bytesPerPixel)
+			{
+				// 24 bit pixels do not tile a vector register, so the first row is filled pixel by pixel and copied
+				for (DWORD x = 0; x < rowSize; x += 3)
+				{
+					memcpy(dstRow + x, &color, 3);
+				}
+				for (LONG y = 1; y < height; ++y)
+				{
+					memcpy(dstRow + y * dst.pitch, dstRow, rowSize);
+				}
+				return;
+			}
+
+			__m128i pattern = {};
+			switch (dst.bytesPerPixel)
+			{
+			case 1:
+				pattern = _mm_set1_epi8(static_cast<char>(color));
+				break;
+			case 2:
+				pattern = _mm_set1_epi16(static_cast<short>(color));
+				break;
+			default:
+				pattern = _mm_set1_epi32(static_cast<int>(color));
+				break;
+			}
+
+			if (rowSize * height >= NON_TEMPORAL_FILL_THRESHOLD)
+			{
+				for (LONG y = 0; y < height; ++y)
+				{
+					fillRow<storeNonTemporal>(dstRow + y * dst.pitch, rowSize, pattern, dst.bytesPerPixel);
+				}
+				_mm_sfence();
+			}
+			else
+			{
+				for (LONG y = 0; y < height; ++y)
+				{
+					fillRow<storeCached>(dstRow + y * dst.pitch, rowSize, pattern, dst.bytesPerPixel);
+				}
+			}
+		}
+
+		void invert(const Image& dst, const RECT& rect)
+		{
+			BYTE* dstRow = static_cast<BYTE*>(dst.surface) + rect.top * dst.pitch + rect.left * dst.bytesPerPixel;
+			ropRows(dstRow, dst.pitch, dstRow, dst.pitch, (rect.right - rect.left) * dst.bytesPerPixel,
+				rect.bottom - rect.top, InvertOp());
+		}
+
+		bool isRopSupported(DWORD rop)
+		{
+			switch (rop)
+			{
+			case SRCCOPY:
+			case SRCAND:
+			case SRCPAINT:
+			case SRCINVERT:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		bool isSupported(const DDPIXELFORMAT& dstPf, const DDPIXELFORMAT& srcPf)
+		{
+			if ((dstPf.dwFlags & DDPF_FOURCC) || (srcPf.dwFlags & DDPF_FOURCC) ||
+				!(dstPf.dwFlags & (DDPF_RGB | DDPF_PALETTEINDEXED8)))
+			{
+				return false;
+			}
+
+			switch (dstPf.dwRGBBitCount)
+			{
+			case 8:
+			case 16:
+			case 24:
+			case 32:
+				break;
+			default:
+				return false;
+			}
+
+			return dstPf.dwRGBBitCount == srcPf.dwRGBBitCount &&
+				dstPf.dwRBitMask == srcPf.dwRBitMask &&
+				dstPf.dwGBitMask == srcPf.dwGBitMask &&
+				dstPf.dwBBitMask == srcPf.dwBBitMask;
+		}
+	}
+}
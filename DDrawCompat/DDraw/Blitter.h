@@ -0,0 +1,42 @@
+#pragma once
+
+#define CINTERFACE
+
+#include <ddraw.h>
+
+namespace DDraw
+{
+	namespace Blitter
+	{
+		struct Image
+		{
+			void* surface;
+			LONG pitch;
+			DWORD bytesPerPixel;
+		};
+
+		struct BltParams
+		{
+			RECT dstRect;
+			RECT srcRect;
+			DWORD colorKeyMask;
+			const DDCOLORKEY* srcColorKey;
+			const DDCOLORKEY* dstColorKey;
+			const DDPIXELFORMAT* linearFilterPf;
+			DWORD rop;
+			bool isMirroredLeftRight;
+			bool isMirroredUpDown;
+		};
+
+		// Copies srcRect to dstRect, stretching with nearest neighbor sampling if the sizes differ.
+		// If linearFilterPf is set, stretched rows are interpolated along the y-axis (DDBLTFX_ARITHSTRETCHY).
+		// Color keys only support single colors, not ranges.
+		// A rop other than 0 or SRCCOPY requires equal sizes, no color keys and no mirroring.
+		// dst and src may refer to the same surface with overlapping rects only for unstretched SRCCOPY blits.
+		void blt(const Image& dst, const Image& src, const BltParams& params);
+		void colorFill(const Image& dst, const RECT& rect, DWORD color);
+		void invert(const Image& dst, const RECT& rect);
+		bool isRopSupported(DWORD rop);
+		bool isSupported(const DDPIXELFORMAT& dstPf, const DDPIXELFORMAT& srcPf);
+	}
+}
@@ -1,9 +1,12 @@
+#include <d3d.h>
+
 #include "Common/CompatPtr.h"
 #include "DDraw/ActivateAppHandler.h"
 #include "DDraw/DirectDraw.h"
 #include "DDraw/Repository.h"
 #include "DDraw/Surfaces/TagSurface.h"
 #include "DDraw/Surfaces/PrimarySurface.h"
+#include "Direct3d/Hooks.h"
 #include "Win32/DisplayMode.h"
 
 namespace
@@ -115,6 +118,7 @@ namespace DDraw
 		vtable.CreateSurface = &CreateSurface;
 		vtable.FlipToGDISurface = &FlipToGDISurface;
 		vtable.GetGDISurface = &GetGDISurface;
+		vtable.QueryInterface = &QueryInterface;
 		vtable.SetCooperativeLevel = &SetCooperativeLevel;
 		vtable.SetDisplayMode = &SetDisplayMode;
 	}
@@ -173,6 +177,17 @@ namespace DDraw
 		return s_origVtable.Initialize(This, lpGUID);
 	}
 
+	template <typename TDirectDraw>
+	HRESULT STDMETHODCALLTYPE DirectDraw<TDirectDraw>::QueryInterface(
+		TDirectDraw* This, REFIID riid, LPVOID* obp)
+	{
+		if (Direct3d::isDirect3dIid(riid))
+		{
+			Direct3d::installHooks();
+		}
+		return s_origVtable.QueryInterface(This, riid, obp);
+	}
+
 	template <typename TDirectDraw>
 	HRESULT STDMETHODCALLTYPE DirectDraw<TDirectDraw>::SetCooperativeLevel(
 		TDirectDraw* This, HWND hWnd, DWORD dwFlags)
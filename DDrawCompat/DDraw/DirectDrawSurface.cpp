@@ -3,6 +3,7 @@
 #include "DDraw/DirectDrawSurface.h"
 #include "DDraw/Surfaces/Surface.h"
 #include "DDraw/Surfaces/SurfaceImpl.h"
+#include "Direct3d/Hooks.h"
 
 namespace
 {
@@ -18,6 +19,17 @@ namespace
 		}
 		return (surface->getImpl<TSurface>()->*compatMethod)(This, params...);
 	}
+
+	// Hooked for every surface, not just the ones with compat surface data
+	template <typename TSurface>
+	HRESULT STDMETHODCALLTYPE queryInterface(TSurface* This, REFIID riid, LPVOID* obp)
+	{
+		if (Direct3d::isDirect3dIid(riid))
+		{
+			Direct3d::installHooks();
+		}
+		return CompatVtable<Vtable<TSurface>>::s_origVtable.QueryInterface(This, riid, obp);
+	}
 }
 
 #define SET_COMPAT_METHOD(method) \
@@ -40,8 +52,10 @@ namespace DDraw
 		SET_COMPAT_METHOD(Restore);
 		SET_COMPAT_METHOD(SetPalette);
 		SET_COMPAT_METHOD(Unlock);
+		vtable.QueryInterface = &queryInterface<TSurface>;
 
 		setCompatVtable2(vtable);
+		setCompatVtable3(vtable);
 	}
 
 	template <typename TSurface>
@@ -55,6 +69,22 @@ namespace DDraw
 	{
 	}
 
+	template <typename TSurface>
+	void DirectDrawSurface<TSurface>::setCompatVtable3(Vtable<TSurface>& vtable)
+	{
+		SET_COMPAT_METHOD(SetSurfaceDesc);
+	}
+
+	template <>
+	void DirectDrawSurface<IDirectDrawSurface>::setCompatVtable3(Vtable<IDirectDrawSurface>&)
+	{
+	}
+
+	template <>
+	void DirectDrawSurface<IDirectDrawSurface2>::setCompatVtable3(Vtable<IDirectDrawSurface2>&)
+	{
+	}
+
 	template DirectDrawSurface<IDirectDrawSurface>;
 	template DirectDrawSurface<IDirectDrawSurface2>;
 	template DirectDrawSurface<IDirectDrawSurface3>;
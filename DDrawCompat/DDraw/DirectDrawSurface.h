@@ -18,6 +18,7 @@ namespace DDraw
 
 	private:
 		static void setCompatVtable2(Vtable<TSurface>& vtable);
+		static void setCompatVtable3(Vtable<TSurface>& vtable);
 	};
 }
 
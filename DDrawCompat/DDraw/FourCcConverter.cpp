@@ -0,0 +1,429 @@
+#include <cstring>
+
+#include <emmintrin.h>
+
+#include "DDraw/FourCcConverter.h"
+
+namespace
+{
+	using DDraw::FourCcConverter::Image;
+
+	const DWORD FOURCC_YUY2 = MAKEFOURCC('Y', 'U', 'Y', '2');
+	const DWORD FOURCC_UYVY = MAKEFOURCC('U', 'Y', 'V', 'Y');
+	const DWORD FOURCC_YV12 = MAKEFOURCC('Y', 'V', '1', '2');
+	const DWORD FOURCC_I420 = MAKEFOURCC('I', '4', '2', '0');
+	const DWORD FOURCC_IYUV = MAKEFOURCC('I', 'Y', 'U', 'V');
+
+	const int COEFFICIENT_BITS = 13;
+
+	// Fixed point factors of the Y, U and V components in the RGB channels, with COEFFICIENT_BITS fraction bits.
+	// The scalar and SSE2 paths use the same integer arithmetic, so they produce identical results.
+	struct Coefficients
+	{
+		short y;
+		short rv;
+		short gu;
+		short gv;
+		short bu;
+	};
+
+	struct Channel
+	{
+		int shift;
+		int bits;
+	};
+
+	struct RgbFormat
+	{
+		Channel r;
+		Channel g;
+		Channel b;
+	};
+
+	class PackedSampler
+	{
+	public:
+		PackedSampler(const Image& image, int yOffset, int uOffset, int vOffset)
+			: m_image(image), m_row(nullptr), m_yOffset(yOffset), m_uOffset(uOffset), m_vOffset(vOffset)
+		{
+		}
+
+		void setRow(LONG y)
+		{
+			m_row = static_cast<const BYTE*>(m_image.surface) + y * m_image.pitch;
+		}
+
+		void get(LONG x, int& y, int& u, int& v) const
+		{
+			const BYTE* pair = m_row + (x & ~1) * 2;
+			y = m_row[x * 2 + m_yOffset];
+			u = pair[m_uOffset];
+			v = pair[m_vOffset];
+		}
+
+		// Loads 8 pixels starting at an even x as 16 bit Y components and interleaved 16 bit U and V components
+		void get8(LONG x, __m128i& y, __m128i& uv) const
+		{
+			const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_row + x * 2));
+			const __m128i lowBytes = _mm_and_si128(pixels, _mm_set1_epi16(0xFF));
+			const __m128i highBytes = _mm_srli_epi16(pixels, 8);
+			y = 0 == m_yOffset ? lowBytes : highBytes;
+			uv = 0 == m_yOffset ? highBytes : lowBytes;
+		}
+
+	private:
+		const Image& m_image;
+		const BYTE* m_row;
+		int m_yOffset;
+		int m_uOffset;
+		int m_vOffset;
+	};
+
+	class PlanarSampler
+	{
+	public:
+		PlanarSampler(const Image& image, bool isVFirst)
+			: m_image(image), m_yRow(nullptr), m_uRow(nullptr), m_vRow(nullptr)
+		{
+			const BYTE* yPlane = static_cast<const BYTE*>(image.surface);
+			const BYTE* firstChromaPlane = yPlane + image.pitch * image.height;
+			const BYTE* secondChromaPlane = firstChromaPlane + (image.pitch / 2) * (image.height / 2);
+			m_uPlane = isVFirst ? secondChromaPlane : firstChromaPlane;
+			m_vPlane = isVFirst ? firstChromaPlane : secondChromaPlane;
+		}
+
+		void setRow(LONG y)
+		{
+			const LONG chromaOffset = (y / 2) * (m_image.pitch / 2);
+			m_yRow = static_cast<const BYTE*>(m_image.surface) + y * m_image.pitch;
+			m_uRow = m_uPlane + chromaOffset;
+			m_vRow = m_vPlane + chromaOffset;
+		}
+
+		void get(LONG x, int& y, int& u, int& v) const
+		{
+			y = m_yRow[x];
+			u = m_uRow[x / 2];
+			v = m_vRow[x / 2];
+		}
+
+		// Loads 8 pixels starting at an even x as 16 bit Y components and interleaved 16 bit U and V components
+		void get8(LONG x, __m128i& y, __m128i& uv) const
+		{
+			const __m128i zero = _mm_setzero_si128();
+			y = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(m_yRow + x)), zero);
+			uv = _mm_unpacklo_epi8(_mm_unpacklo_epi8(load4(m_uRow + x / 2), load4(m_vRow + x / 2)), zero);
+		}
+
+	private:
+		static __m128i load4(const BYTE* src)
+		{
+			int value = 0;
+			std::memcpy(&value, src, sizeof(value));
+			return _mm_cvtsi32_si128(value);
+		}
+
+		const Image& m_image;
+		const BYTE* m_uPlane;
+		const BYTE* m_vPlane;
+		const BYTE* m_yRow;
+		const BYTE* m_uRow;
+		const BYTE* m_vRow;
+	};
+
+	short toFixedPoint(double value)
+	{
+		return static_cast<short>(value * (1 << COEFFICIENT_BITS) + (value < 0 ? -0.5 : 0.5));
+	}
+
+	Coefficients createCoefficients(double kr, double kb)
+	{
+		const double kg = 1 - kr - kb;
+		const double yScale = 255.0 / 219;
+		const double cScale = 255.0 / 112;
+
+		Coefficients coefficients = {};
+		coefficients.y = toFixedPoint(yScale);
+		coefficients.rv = toFixedPoint(cScale * (1 - kr));
+		coefficients.gu = toFixedPoint(-cScale * (1 - kb) * kb / kg);
+		coefficients.gv = toFixedPoint(-cScale * (1 - kr) * kr / kg);
+		coefficients.bu = toFixedPoint(cScale * (1 - kb));
+		return coefficients;
+	}
+
+	const Coefficients& getCoefficients(DWORD srcHeight)
+	{
+		static const Coefficients bt601 = createCoefficients(0.299, 0.114);
+		static const Coefficients bt709 = createCoefficients(0.2126, 0.0722);
+		return srcHeight >= 720 ? bt709 : bt601;
+	}
+
+	Channel getChannel(DWORD mask)
+	{
+		Channel channel = {};
+		while (0 != mask && !(mask & 1))
+		{
+			mask >>= 1;
+			++channel.shift;
+		}
+		while (mask & 1)
+		{
+			mask >>= 1;
+			++channel.bits;
+		}
+		return channel;
+	}
+
+	bool isXrgb8888(const RgbFormat& format)
+	{
+		return 16 == format.r.shift && 8 == format.r.bits && 8 == format.g.shift && 8 == format.g.bits &&
+			0 == format.b.shift && 8 == format.b.bits;
+	}
+
+	DWORD packChannel(int value, const Channel& channel)
+	{
+		value = (value + (1 << (COEFFICIENT_BITS - 1))) >> COEFFICIENT_BITS;
+		if (value < 0)
+		{
+			value = 0;
+		}
+		else if (value > 0xFF)
+		{
+			value = 0xFF;
+		}
+
+		const DWORD value8 = static_cast<DWORD>(value);
+		const DWORD scaled = channel.bits <= 8 ? value8 >> (8 - channel.bits) : value8 << (channel.bits - 8);
+		return scaled << channel.shift;
+	}
+
+	DWORD convertPixel(int y, int u, int v, const RgbFormat& format, const Coefficients& c)
+	{
+		const int luma = c.y * (y - 16);
+		u -= 128;
+		v -= 128;
+		return packChannel(luma + c.rv * v, format.r) |
+			packChannel(luma + c.gu * u + c.gv * v, format.g) |
+			packChannel(luma + c.bu * u, format.b);
+	}
+
+	// Two 16 bit factors for _mm_madd_epi16, first applied to the even and second to the odd 16 bit elements
+	__m128i setFactorPairs(short even, short odd)
+	{
+		return _mm_set1_epi32(static_cast<int>(static_cast<unsigned short>(even) |
+			(static_cast<unsigned int>(static_cast<unsigned short>(odd)) << 16)));
+	}
+
+	__m128i packChannel8(__m128i low, __m128i high)
+	{
+		const __m128i values16 = _mm_packs_epi32(
+			_mm_srai_epi32(low, COEFFICIENT_BITS), _mm_srai_epi32(high, COEFFICIENT_BITS));
+		return _mm_packus_epi16(values16, values16);
+	}
+
+	// Converts 8 pixels from 16 bit Y components and interleaved 16 bit U and V components to XRGB8888
+	void convert8ToXrgb8888(__m128i y, __m128i uv, const Coefficients& c, BYTE* dst)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		y = _mm_sub_epi16(y, _mm_set1_epi16(16));
+		uv = _mm_sub_epi16(uv, _mm_set1_epi16(128));
+
+		const __m128i rounding = _mm_set1_epi32(1 << (COEFFICIENT_BITS - 1));
+		const __m128i yFactor = setFactorPairs(c.y, 0);
+		const __m128i lumaLow = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(y, zero), yFactor), rounding);
+		const __m128i lumaHigh = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(y, zero), yFactor), rounding);
+
+		// Chroma contributions of the 4 pixel pairs, each shared by both pixels of the pair
+		const __m128i r = _mm_madd_epi16(uv, setFactorPairs(0, c.rv));
+		const __m128i g = _mm_madd_epi16(uv, setFactorPairs(c.gu, c.gv));
+		const __m128i b = _mm_madd_epi16(uv, setFactorPairs(c.bu, 0));
+
+		const __m128i r8 = packChannel8(_mm_add_epi32(lumaLow, _mm_unpacklo_epi32(r, r)),
+			_mm_add_epi32(lumaHigh, _mm_unpackhi_epi32(r, r)));
+		const __m128i g8 = packChannel8(_mm_add_epi32(lumaLow, _mm_unpacklo_epi32(g, g)),
+			_mm_add_epi32(lumaHigh, _mm_unpackhi_epi32(g, g)));
+		const __m128i b8 = packChannel8(_mm_add_epi32(lumaLow, _mm_unpacklo_epi32(b, b)),
+			_mm_add_epi32(lumaHigh, _mm_unpackhi_epi32(b, b)));
+
+		const __m128i bg = _mm_unpacklo_epi8(b8, g8);
+		const __m128i r0 = _mm_unpacklo_epi8(r8, zero);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi16(bg, r0));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst) + 1, _mm_unpackhi_epi16(bg, r0));
+	}
+
+	template <int bytesPerPixel>
+	void storePixel(BYTE* dst, DWORD pixel);
+
+	template <>
+	void storePixel<2>(BYTE* dst, DWORD pixel)
+	{
+		*reinterpret_cast<WORD*>(dst) = static_cast<WORD>(pixel);
+	}
+
+	template <>
+	void storePixel<3>(BYTE* dst, DWORD pixel)
+	{
+		dst[0] = static_cast<BYTE>(pixel);
+		dst[1] = static_cast<BYTE>(pixel >> 8);
+		dst[2] = static_cast<BYTE>(pixel >> 16);
+	}
+
+	template <>
+	void storePixel<4>(BYTE* dst, DWORD pixel)
+	{
+		*reinterpret_cast<DWORD*>(dst) = pixel;
+	}
+
+	template <typename Sampler>
+	void convertRowUnscaledToXrgb8888(const Sampler& sampler, LONG srcLeft, LONG width, BYTE* dst,
+		const RgbFormat& format, const Coefficients& c)
+	{
+		LONG x = 0;
+		int yc = 0;
+		int uc = 0;
+		int vc = 0;
+		if (srcLeft & 1)
+		{
+			sampler.get(srcLeft, yc, uc, vc);
+			storePixel<4>(dst, convertPixel(yc, uc, vc, format, c));
+			++x;
+		}
+
+		for (; x + 8 <= width; x += 8)
+		{
+			__m128i y = {};
+			__m128i uv = {};
+			sampler.get8(srcLeft + x, y, uv);
+			convert8ToXrgb8888(y, uv, c, dst + x * 4);
+		}
+
+		for (; x < width; ++x)
+		{
+			sampler.get(srcLeft + x, yc, uc, vc);
+			storePixel<4>(dst + x * 4, convertPixel(yc, uc, vc, format, c));
+		}
+	}
+
+	template <int bytesPerPixel, typename Sampler>
+	void convertRows(Sampler& sampler, const RECT& srcRect, const Image& dst, const RECT& dstRect,
+		const RgbFormat& format, const Coefficients& c)
+	{
+		const LONG dstWidth = dstRect.right - dstRect.left;
+		const LONG dstHeight = dstRect.bottom - dstRect.top;
+		const LONG stepX = ((srcRect.right - srcRect.left) << 16) / dstWidth;
+		const LONG stepY = ((srcRect.bottom - srcRect.top) << 16) / dstHeight;
+		const bool isSse2Used = 4 == bytesPerPixel && srcRect.right - srcRect.left == dstWidth && isXrgb8888(format);
+
+		LONG srcY = (srcRect.top << 16) + stepY / 2;
+		for (LONG y = dstRect.top; y < dstRect.bottom; ++y)
+		{
+			sampler.setRow(srcY >> 16);
+			srcY += stepY;
+
+			BYTE* dstPixel = static_cast<BYTE*>(dst.surface) + y * dst.pitch + dstRect.left * bytesPerPixel;
+			if (isSse2Used)
+			{
+				convertRowUnscaledToXrgb8888(sampler, srcRect.left, dstWidth, dstPixel, format, c);
+				continue;
+			}
+
+			LONG srcX = (srcRect.left << 16) + stepX / 2;
+			for (LONG x = 0; x < dstWidth; ++x)
+			{
+				int yc = 0;
+				int uc = 0;
+				int vc = 0;
+				sampler.get(srcX >> 16, yc, uc, vc);
+				srcX += stepX;
+				storePixel<bytesPerPixel>(dstPixel, convertPixel(yc, uc, vc, format, c));
+				dstPixel += bytesPerPixel;
+			}
+		}
+	}
+
+	template <typename Sampler>
+	void convertRows(Sampler& sampler, const RECT& srcRect, const DDPIXELFORMAT& dstPf,
+		const Image& dst, const RECT& dstRect, const Coefficients& c)
+	{
+		RgbFormat format = {};
+		format.r = getChannel(dstPf.dwRBitMask);
+		format.g = getChannel(dstPf.dwGBitMask);
+		format.b = getChannel(dstPf.dwBBitMask);
+
+		switch (dstPf.dwRGBBitCount)
+		{
+		case 16:
+			convertRows<2>(sampler, srcRect, dst, dstRect, format, c);
+			break;
+		case 24:
+			convertRows<3>(sampler, srcRect, dst, dstRect, format, c);
+			break;
+		case 32:
+			convertRows<4>(sampler, srcRect, dst, dstRect, format, c);
+			break;
+		}
+	}
+}
+
+namespace DDraw
+{
+	namespace FourCcConverter
+	{
+		void convert(const DDPIXELFORMAT& srcPf, const Image& src, const RECT& srcRect,
+			const DDPIXELFORMAT& dstPf, const Image& dst, const RECT& dstRect)
+		{
+			if (!isSupported(srcPf, dstPf) || IsRectEmpty(&srcRect) || IsRectEmpty(&dstRect))
+			{
+				return;
+			}
+
+			const Coefficients& coefficients = getCoefficients(src.height);
+			switch (srcPf.dwFourCC)
+			{
+			case FOURCC_YUY2:
+			{
+				PackedSampler sampler(src, 0, 1, 3);
+				convertRows(sampler, srcRect, dstPf, dst, dstRect, coefficients);
+				break;
+			}
+
+			case FOURCC_UYVY:
+			{
+				PackedSampler sampler(src, 1, 0, 2);
+				convertRows(sampler, srcRect, dstPf, dst, dstRect, coefficients);
+				break;
+			}
+
+			default:
+			{
+				PlanarSampler sampler(src, FOURCC_YV12 == srcPf.dwFourCC);
+				convertRows(sampler, srcRect, dstPf, dst, dstRect, coefficients);
+				break;
+			}
+			}
+		}
+
+		bool isSupported(const DDPIXELFORMAT& srcPf, const DDPIXELFORMAT& dstPf)
+		{
+			if (!(srcPf.dwFlags & DDPF_FOURCC))
+			{
+				return false;
+			}
+
+			switch (srcPf.dwFourCC)
+			{
+			case FOURCC_YUY2:
+			case FOURCC_UYVY:
+			case FOURCC_YV12:
+			case FOURCC_I420:
+			case FOURCC_IYUV:
+				break;
+			default:
+				return false;
+			}
+
+			return (dstPf.dwFlags & DDPF_RGB) && !(dstPf.dwFlags & (DDPF_FOURCC | DDPF_PALETTEINDEXED8)) &&
+				(16 == dstPf.dwRGBBitCount || 24 == dstPf.dwRGBBitCount || 32 == dstPf.dwRGBBitCount);
+		}
+	}
+}
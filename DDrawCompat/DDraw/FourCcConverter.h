@@ -0,0 +1,26 @@
+#pragma once
+
+#define CINTERFACE
+
+#include <ddraw.h>
+
+namespace DDraw
+{
+	namespace FourCcConverter
+	{
+		struct Image
+		{
+			void* surface;
+			LONG pitch;
+			DWORD width;
+			DWORD height;
+		};
+
+		// Converts YUY2, UYVY, YV12 and I420 (IYUV) images to 16, 24 or 32 bit RGB with nearest neighbor scaling.
+		// BT.709 is used for sources with at least 720 lines and BT.601 otherwise.
+		// Rows converted without horizontal scaling to XRGB8888 use SSE2.
+		void convert(const DDPIXELFORMAT& srcPf, const Image& src, const RECT& srcRect,
+			const DDPIXELFORMAT& dstPf, const Image& dst, const RECT& dstRect);
+		bool isSupported(const DDPIXELFORMAT& srcPf, const DDPIXELFORMAT& dstPf);
+	}
+}
@@ -0,0 +1,323 @@
+#include <emmintrin.h>
+
+#include "DDraw/PixelFormatConverter.h"
+
+namespace
+{
+	using DDraw::PixelFormatConverter::Image;
+	using DDraw::PixelFormatConverter::Lut;
+
+	struct Channel
+	{
+		DWORD shift;
+		DWORD bits;
+	};
+
+	// Moves one channel from its position in the source pixel to its position in the destination pixel
+	struct ChannelKernel
+	{
+		Channel src;
+		Channel dst;
+	};
+
+	struct Kernel
+	{
+		ChannelKernel channels[3];
+		const BYTE* luts[3];
+	};
+
+	const Channel BYTE_CHANNEL = { 0, 8 };
+
+	Channel getChannel(DWORD mask)
+	{
+		Channel channel = {};
+		while (0 != mask && !(mask & 1))
+		{
+			mask >>= 1;
+			++channel.shift;
+		}
+		while (mask & 1)
+		{
+			mask >>= 1;
+			++channel.bits;
+		}
+		return channel;
+	}
+
+	Kernel getKernel(const DDPIXELFORMAT& srcPf, const DDPIXELFORMAT& dstPf, const Lut* lut)
+	{
+		Kernel kernel = {};
+		if (lut)
+		{
+			kernel.luts[0] = lut->red;
+			kernel.luts[1] = lut->green;
+			kernel.luts[2] = lut->blue;
+		}
+
+		kernel.channels[0].src = getChannel(srcPf.dwRBitMask);
+		kernel.channels[0].dst = getChannel(dstPf.dwRBitMask);
+		kernel.channels[1].src = getChannel(srcPf.dwGBitMask);
+		kernel.channels[1].dst = getChannel(dstPf.dwGBitMask);
+		kernel.channels[2].src = getChannel(srcPf.dwBBitMask);
+		kernel.channels[2].dst = getChannel(dstPf.dwBBitMask);
+		return kernel;
+	}
+
+	DWORD convertChannel(DWORD pixel, const Channel& src, const Channel& dst)
+	{
+		DWORD value = (pixel >> src.shift) & ((1U << src.bits) - 1);
+		if (dst.bits <= src.bits)
+		{
+			value >>= src.bits - dst.bits;
+		}
+		else
+		{
+			DWORD bits = src.bits;
+			while (bits < dst.bits)
+			{
+				value = (value << bits) | value;
+				bits *= 2;
+			}
+			value >>= bits - dst.bits;
+		}
+		return value << dst.shift;
+	}
+
+	DWORD convertChannel(DWORD pixel, const ChannelKernel& channel)
+	{
+		return convertChannel(pixel, channel.src, channel.dst);
+	}
+
+	DWORD convertChannel(DWORD pixel, const ChannelKernel& channel, const BYTE* lut)
+	{
+		return convertChannel(lut[convertChannel(pixel, channel.src, BYTE_CHANNEL)], BYTE_CHANNEL, channel.dst);
+	}
+
+	template <int bytesPerPixel>
+	DWORD loadPixel(const BYTE* src)
+	{
+		return *reinterpret_cast<const DWORD*>(src);
+	}
+
+	template <>
+	DWORD loadPixel<2>(const BYTE* src)
+	{
+		return *reinterpret_cast<const WORD*>(src);
+	}
+
+	template <>
+	DWORD loadPixel<3>(const BYTE* src)
+	{
+		return src[0] | (src[1] << 8) | (src[2] << 16);
+	}
+
+	template <int bytesPerPixel>
+	void storePixel(BYTE* dst, DWORD pixel)
+	{
+		*reinterpret_cast<DWORD*>(dst) = pixel;
+	}
+
+	template <>
+	void storePixel<2>(BYTE* dst, DWORD pixel)
+	{
+		*reinterpret_cast<WORD*>(dst) = static_cast<WORD>(pixel);
+	}
+
+	template <>
+	void storePixel<3>(BYTE* dst, DWORD pixel)
+	{
+		dst[0] = static_cast<BYTE>(pixel);
+		dst[1] = static_cast<BYTE>(pixel >> 8);
+		dst[2] = static_cast<BYTE>(pixel >> 16);
+	}
+
+	template <int srcBytesPerPixel, int dstBytesPerPixel>
+	void convertRow(const BYTE* src, BYTE* dst, LONG width, const Kernel& kernel)
+	{
+		for (LONG x = 0; x < width; ++x)
+		{
+			const DWORD pixel = loadPixel<srcBytesPerPixel>(src);
+			storePixel<dstBytesPerPixel>(dst,
+				convertChannel(pixel, kernel.channels[0]) |
+				convertChannel(pixel, kernel.channels[1]) |
+				convertChannel(pixel, kernel.channels[2]));
+			src += srcBytesPerPixel;
+			dst += dstBytesPerPixel;
+		}
+	}
+
+	template <int srcBytesPerPixel, int dstBytesPerPixel>
+	void convertRowLut(const BYTE* src, BYTE* dst, LONG width, const Kernel& kernel)
+	{
+		for (LONG x = 0; x < width; ++x)
+		{
+			const DWORD pixel = loadPixel<srcBytesPerPixel>(src);
+			storePixel<dstBytesPerPixel>(dst,
+				convertChannel(pixel, kernel.channels[0], kernel.luts[0]) |
+				convertChannel(pixel, kernel.channels[1], kernel.luts[1]) |
+				convertChannel(pixel, kernel.channels[2], kernel.luts[2]));
+			src += srcBytesPerPixel;
+			dst += dstBytesPerPixel;
+		}
+	}
+
+	// Widens 8 16 bit pixels to XRGB8888, using the shift of the red channel and the width of the green channel
+	template <int redShift, int greenBits>
+	__m128i convertRgb16ToXrgb8888(__m128i pixels, __m128i& highPixels)
+	{
+		const __m128i mask5 = _mm_set1_epi16(0x1F);
+		const __m128i maskG = _mm_set1_epi16((1 << greenBits) - 1);
+
+		const __m128i r = _mm_and_si128(_mm_srli_epi16(pixels, redShift), mask5);
+		const __m128i g = _mm_and_si128(_mm_srli_epi16(pixels, 5), maskG);
+		const __m128i b = _mm_and_si128(pixels, mask5);
+
+		const __m128i r8 = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+		const __m128i g8 = _mm_or_si128(_mm_slli_epi16(g, 8 - greenBits), _mm_srli_epi16(g, 2 * greenBits - 8));
+		const __m128i b8 = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+
+		const __m128i gb = _mm_or_si128(_mm_slli_epi16(g8, 8), b8);
+		highPixels = _mm_unpackhi_epi16(gb, r8);
+		return _mm_unpacklo_epi16(gb, r8);
+	}
+
+	template <int redShift, int greenBits>
+	void convertRowRgb16ToXrgb8888(const BYTE* src, BYTE* dst, LONG width, const Kernel& kernel)
+	{
+		LONG x = 0;
+		for (; x + 8 <= width; x += 8)
+		{
+			const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src) + x / 8);
+			__m128i highPixels = {};
+			const __m128i lowPixels = convertRgb16ToXrgb8888<redShift, greenBits>(pixels, highPixels);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst) + x / 4, lowPixels);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst) + x / 4 + 1, highPixels);
+		}
+
+		convertRow<2, 4>(src + x * 2, dst + x * 4, width - x, kernel);
+	}
+
+	void convertRowSwapRedBlue(const BYTE* src, BYTE* dst, LONG width, const Kernel& kernel)
+	{
+		const __m128i maskByte = _mm_set1_epi32(0xFF);
+		const __m128i maskG = _mm_set1_epi32(0xFF00);
+
+		LONG x = 0;
+		for (; x + 4 <= width; x += 4)
+		{
+			const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src) + x / 4);
+			const __m128i result = _mm_or_si128(
+				_mm_or_si128(_mm_slli_epi32(_mm_and_si128(pixels, maskByte), 16), _mm_and_si128(pixels, maskG)),
+				_mm_and_si128(_mm_srli_epi32(pixels, 16), maskByte));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst) + x / 4, result);
+		}
+
+		convertRow<4, 4>(src + x * 4, dst + x * 4, width - x, kernel);
+	}
+
+	typedef void(*RowConverter)(const BYTE* src, BYTE* dst, LONG width, const Kernel& kernel);
+
+	bool isFormat(const DDPIXELFORMAT& pf, DWORD bitCount, DWORD rMask, DWORD gMask, DWORD bMask)
+	{
+		return bitCount == pf.dwRGBBitCount &&
+			rMask == pf.dwRBitMask && gMask == pf.dwGBitMask && bMask == pf.dwBBitMask;
+	}
+
+	template <int srcBytesPerPixel>
+	RowConverter getGenericRowConverter(DWORD dstBitCount, bool isLut)
+	{
+		switch (dstBitCount)
+		{
+		case 16:
+			return isLut ? &convertRowLut<srcBytesPerPixel, 2> : &convertRow<srcBytesPerPixel, 2>;
+		case 24:
+			return isLut ? &convertRowLut<srcBytesPerPixel, 3> : &convertRow<srcBytesPerPixel, 3>;
+		default:
+			return isLut ? &convertRowLut<srcBytesPerPixel, 4> : &convertRow<srcBytesPerPixel, 4>;
+		}
+	}
+
+	RowConverter getRowConverter(const DDPIXELFORMAT& srcPf, const DDPIXELFORMAT& dstPf, bool isLut)
+	{
+		if (isLut)
+		{
+			switch (srcPf.dwRGBBitCount)
+			{
+			case 16:
+				return getGenericRowConverter<2>(dstPf.dwRGBBitCount, true);
+			case 24:
+				return getGenericRowConverter<3>(dstPf.dwRGBBitCount, true);
+			default:
+				return getGenericRowConverter<4>(dstPf.dwRGBBitCount, true);
+			}
+		}
+
+		if (isFormat(dstPf, 32, 0xFF0000, 0x00FF00, 0x0000FF))
+		{
+			if (isFormat(srcPf, 16, 0xF800, 0x07E0, 0x001F))
+			{
+				return &convertRowRgb16ToXrgb8888<11, 6>;
+			}
+			if (isFormat(srcPf, 16, 0x7C00, 0x03E0, 0x001F))
+			{
+				return &convertRowRgb16ToXrgb8888<10, 5>;
+			}
+		}
+
+		if ((isFormat(srcPf, 32, 0xFF0000, 0x00FF00, 0x0000FF) && isFormat(dstPf, 32, 0x0000FF, 0x00FF00, 0xFF0000)) ||
+			(isFormat(srcPf, 32, 0x0000FF, 0x00FF00, 0xFF0000) && isFormat(dstPf, 32, 0xFF0000, 0x00FF00, 0x0000FF)))
+		{
+			return &convertRowSwapRedBlue;
+		}
+
+		switch (srcPf.dwRGBBitCount)
+		{
+		case 16:
+			return getGenericRowConverter<2>(dstPf.dwRGBBitCount, false);
+		case 24:
+			return getGenericRowConverter<3>(dstPf.dwRGBBitCount, false);
+		default:
+			return getGenericRowConverter<4>(dstPf.dwRGBBitCount, false);
+		}
+	}
+
+	bool isSupportedRgb(const DDPIXELFORMAT& pf)
+	{
+		return (pf.dwFlags & DDPF_RGB) && !(pf.dwFlags & (DDPF_FOURCC | DDPF_PALETTEINDEXED8)) &&
+			(16 == pf.dwRGBBitCount || 24 == pf.dwRGBBitCount || 32 == pf.dwRGBBitCount) &&
+			0 != pf.dwRBitMask && 0 != pf.dwGBitMask && 0 != pf.dwBBitMask;
+	}
+}
+
+namespace DDraw
+{
+	namespace PixelFormatConverter
+	{
+		void convert(const DDPIXELFORMAT& srcPf, const Image& src,
+			const DDPIXELFORMAT& dstPf, const Image& dst, const RECT& rect, const Lut* lut)
+		{
+			if (!isSupported(srcPf, dstPf) || IsRectEmpty(&rect))
+			{
+				return;
+			}
+
+			const RowConverter rowConverter = getRowConverter(srcPf, dstPf, nullptr != lut);
+			const Kernel kernel = getKernel(srcPf, dstPf, lut);
+			const DWORD srcBytesPerPixel = srcPf.dwRGBBitCount / 8;
+			const DWORD dstBytesPerPixel = dstPf.dwRGBBitCount / 8;
+			const LONG width = rect.right - rect.left;
+
+			for (LONG y = rect.top; y < rect.bottom; ++y)
+			{
+				rowConverter(static_cast<const BYTE*>(src.surface) + y * src.pitch + rect.left * srcBytesPerPixel,
+					static_cast<BYTE*>(dst.surface) + y * dst.pitch + rect.left * dstBytesPerPixel,
+					width, kernel);
+			}
+		}
+
+		bool isSupported(const DDPIXELFORMAT& srcPf, const DDPIXELFORMAT& dstPf)
+		{
+			return isSupportedRgb(srcPf) && isSupportedRgb(dstPf);
+		}
+	}
+}
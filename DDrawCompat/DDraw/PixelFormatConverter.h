@@ -0,0 +1,33 @@
+#pragma once
+
+#define CINTERFACE
+
+#include <ddraw.h>
+
+namespace DDraw
+{
+	namespace PixelFormatConverter
+	{
+		struct Image
+		{
+			void* surface;
+			LONG pitch;
+		};
+
+		// 8 bit lookup tables applied to each channel during conversion, such as a gamma ramp
+		struct Lut
+		{
+			BYTE red[256];
+			BYTE green[256];
+			BYTE blue[256];
+		};
+
+		// Converts rect between 16, 24 and 32 bit RGB formats with arbitrary channel masks.
+		// Channels are widened by bit replication, so full intensity maps to full intensity.
+		// RGB555 and RGB565 to XRGB8888 and swapping the red and blue channels of 32 bit formats use SSE2.
+		// If lut is set, channels are mapped through it at 8 bit precision in the same pass, without SSE2.
+		void convert(const DDPIXELFORMAT& srcPf, const Image& src,
+			const DDPIXELFORMAT& dstPf, const Image& dst, const RECT& rect, const Lut* lut = nullptr);
+		bool isSupported(const DDPIXELFORMAT& srcPf, const DDPIXELFORMAT& dstPf);
+	}
+}
@@ -1,13 +1,16 @@
 #include <atomic>
+#include <vector>
 
 #include "Common/CompatPtr.h"
 #include "Common/Hook.h"
+#include "Common/ScopedCriticalSection.h"
 #include "Common/Time.h"
 #include "Config/Config.h"
 #include "D3dDdi/KernelModeThunks.h"
 #include "DDraw/DirectDraw.h"
 #include "DDraw/DirectDrawSurface.h"
 #include "DDraw/IReleaseNotifier.h"
+#include "DDraw/PixelFormatConverter.h"
 #include "DDraw/RealPrimarySurface.h"
 #include "DDraw/ScopedThreadLock.h"
 #include "DDraw/Surfaces/PrimarySurface.h"
@@ -17,13 +20,14 @@
 
 namespace
 {
+	DDGAMMARAMP createIdentityGammaRamp();
 	void onRelease();
 	DWORD WINAPI updateThreadProc(LPVOID lpParameter);
 
 	DWORD g_primaryThreadId = 0;
 	CompatWeakPtr<IDirectDrawSurface7> g_frontBuffer;
 	CompatWeakPtr<IDirectDrawSurface7> g_backBuffer;
-	CompatWeakPtr<IDirectDrawSurface7> g_paletteConverter;
+	CompatWeakPtr<IDirectDrawSurface7> g_formatConverter;
 	CompatWeakPtr<IDirectDrawClipper> g_clipper;
 	DDSURFACEDESC2 g_surfaceDesc = {};
 	DDraw::IReleaseNotifier g_releaseNotifier(onRelease);
@@ -40,6 +44,33 @@ namespace
 
 	std::atomic<bool> g_isFullScreen(false);
 
+	// Lock order: the present lock may be acquired while holding the DD thread lock, never the other way around.
+	// Every ddraw call takes the DD thread lock internally, so no ddraw calls are made while holding only
+	// the present lock. It guards the primary snapshot and the format converter's client memory, which lets
+	// the update thread run the palette or pixel format conversion without blocking the application's ddraw calls.
+	CRITICAL_SECTION g_presentCriticalSection;
+	Compat::ProfiledCriticalSection g_presentLock("Present lock", Config::lockProfiling, g_presentCriticalSection);
+	std::vector<unsigned char> g_primarySnapshot;
+	DWORD g_primarySnapshotWidth = 0;
+	DDPIXELFORMAT g_primarySnapshotPf = {};
+	RECT g_primarySnapshotRect = {};
+	DWORD g_snapshotPalette[256] = {};
+	std::vector<unsigned char> g_formatConverterBuffer;
+	DWORD g_formatConverterPitch = 0;
+	DDPIXELFORMAT g_formatConverterPf = {};
+
+	// The gamma ramp of the primary surface is emulated while presenting, reduced to 8 bit lookup tables.
+	// Written while holding both the DD thread lock and the present lock.
+	DDGAMMARAMP g_gammaRamp = createIdentityGammaRamp();
+	DDraw::PixelFormatConverter::Lut g_gammaLut = {};
+	bool g_isGammaRampUsed = false;
+
+	// Changed areas of the compat primary surface that were not yet presented, and the ones presented last time.
+	// The back buffer of the flip chain is one present behind the front buffer, so it needs both.
+	// Only accessed while holding the DD thread lock.
+	RECT g_dirtyRect = {};
+	RECT g_lastDirtyRect = {};
+
 	BOOL CALLBACK bltToWindow(HWND hwnd, LPARAM lParam)
 	{
 		g_clipper->SetHWnd(g_clipper, 0, hwnd);
@@ -48,48 +79,274 @@ namespace
 		return TRUE;
 	}
 
-	HRESULT bltToPrimaryChain(CompatRef<IDirectDrawSurface7> src)
+	RECT getSurfaceRect()
+	{
+		RECT rect = { 0, 0, static_cast<LONG>(g_surfaceDesc.dwWidth), static_cast<LONG>(g_surfaceDesc.dwHeight) };
+		return rect;
+	}
+
+	void addDirtyRect(const RECT* rect)
+	{
+		RECT surfaceRect = getSurfaceRect();
+		RECT dirtyRect = {};
+		if (!rect || IntersectRect(&dirtyRect, rect, &surfaceRect))
+		{
+			UnionRect(&g_dirtyRect, &g_dirtyRect, rect ? &dirtyRect : &surfaceRect);
+		}
+	}
+
+	void invalidateAll()
+	{
+		g_dirtyRect = getSurfaceRect();
+		g_lastDirtyRect = g_dirtyRect;
+	}
+
+	RECT takeDirtyRect()
+	{
+		RECT rect = getSurfaceRect();
+		if (g_isFullScreen)
+		{
+			UnionRect(&rect, &g_dirtyRect, &g_lastDirtyRect);
+		}
+		g_lastDirtyRect = g_dirtyRect;
+		SetRectEmpty(&g_dirtyRect);
+		return rect;
+	}
+
+	HRESULT bltToPrimaryChain(CompatRef<IDirectDrawSurface7> src, RECT rect)
 	{
 		if (g_isFullScreen)
 		{
-			return g_backBuffer->Blt(g_backBuffer, nullptr, &src, nullptr, DDBLT_WAIT, nullptr);
+			if (IsRectEmpty(&rect))
+			{
+				return DD_OK;
+			}
+			return g_backBuffer->Blt(g_backBuffer, &rect, &src, &rect, DDBLT_WAIT, nullptr);
 		}
 
 		EnumThreadWindows(g_primaryThreadId, bltToWindow, reinterpret_cast<LPARAM>(&src));
 		return DD_OK;
 	}
 
+	DDGAMMARAMP createIdentityGammaRamp()
+	{
+		DDGAMMARAMP ramp = {};
+		for (int i = 0; i < 256; ++i)
+		{
+			ramp.red[i] = static_cast<WORD>(i * 0x101);
+			ramp.green[i] = static_cast<WORD>(i * 0x101);
+			ramp.blue[i] = static_cast<WORD>(i * 0x101);
+		}
+		return ramp;
+	}
+
+	// Compares at the 8 bit precision of the lookup tables
+	bool isIdentityGammaRamp(const DDGAMMARAMP& ramp)
+	{
+		for (int i = 0; i < 256; ++i)
+		{
+			if (i != ramp.red[i] >> 8 || i != ramp.green[i] >> 8 || i != ramp.blue[i] >> 8)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Requires the present lock
+	void setSoftwareGammaRamp(const DDGAMMARAMP& ramp)
+	{
+		g_gammaRamp = ramp;
+		for (int i = 0; i < 256; ++i)
+		{
+			g_gammaLut.red[i] = static_cast<BYTE>(g_gammaRamp.red[i] >> 8);
+			g_gammaLut.green[i] = static_cast<BYTE>(g_gammaRamp.green[i] >> 8);
+			g_gammaLut.blue[i] = static_cast<BYTE>(g_gammaRamp.blue[i] >> 8);
+		}
+		g_isGammaRampUsed = !isIdentityGammaRamp(ramp);
+	}
+
+	const DDraw::PixelFormatConverter::Lut* getGammaLut()
+	{
+		return g_isGammaRampUsed ? &g_gammaLut : nullptr;
+	}
+
+	// Without client memory for the format converter the presented image can't be modified,
+	// so the gamma ramp is left to the driver
+	bool isSoftwareGammaUsed()
+	{
+		return Config::softwareGamma && !g_formatConverterBuffer.empty();
+	}
+
+	bool isSoftwareConversionUsed()
+	{
+		if (g_formatConverterBuffer.empty())
+		{
+			return false;
+		}
+
+		const auto& pf = DDraw::PrimarySurface::getDesc().ddpfPixelFormat;
+		if (8 == pf.dwRGBBitCount)
+		{
+			return nullptr != DDraw::PrimarySurface::s_palette;
+		}
+		if (32 == pf.dwRGBBitCount && !g_isGammaRampUsed)
+		{
+			return false;
+		}
+		return DDraw::PixelFormatConverter::isSupported(pf, g_formatConverterPf);
+	}
+
+	// Requires the DD thread lock and the present lock
+	bool snapshotPrimary(const RECT& rect)
+	{
+		auto primary(DDraw::PrimarySurface::getPrimary());
+		const auto& primaryDesc = DDraw::PrimarySurface::getDesc();
+		const DWORD width = min(primaryDesc.dwWidth, g_formatConverterPitch / 4);
+		const DWORD height = min(primaryDesc.dwHeight, g_formatConverterBuffer.size() / g_formatConverterPitch);
+		const DWORD bytesPerPixel = primaryDesc.ddpfPixelFormat.dwRGBBitCount / 8;
+
+		PALETTEENTRY entries[256] = {};
+		auto palette(DDraw::PrimarySurface::s_palette);
+		if (1 == bytesPerPixel && FAILED(palette->GetEntries(palette, 0, 0, 256, entries)))
+		{
+			return false;
+		}
+
+		// The original Lock/Unlock are used to bypass PrimarySurfaceImpl::Unlock scheduling another update
+		DDSURFACEDESC2 desc = {};
+		desc.dwSize = sizeof(desc);
+		auto& origVtable = CompatVtable<IDirectDrawSurface7Vtbl>::s_origVtable;
+		if (FAILED(origVtable.Lock(primary, nullptr, &desc, DDLOCK_READONLY | DDLOCK_WAIT, nullptr)))
+		{
+			return false;
+		}
+
+		const RECT snapshotBounds = { 0, 0, static_cast<LONG>(width), static_cast<LONG>(height) };
+		if (g_primarySnapshotWidth != width ||
+			g_primarySnapshotPf.dwRGBBitCount != primaryDesc.ddpfPixelFormat.dwRGBBitCount)
+		{
+			g_primarySnapshot.clear();
+		}
+		g_primarySnapshotWidth = width;
+		g_primarySnapshotPf = primaryDesc.ddpfPixelFormat;
+		g_primarySnapshot.resize(width * height * bytesPerPixel);
+		IntersectRect(&g_primarySnapshotRect, &rect, &snapshotBounds);
+
+		const LONG rowSize = (g_primarySnapshotRect.right - g_primarySnapshotRect.left) * bytesPerPixel;
+		const LONG rowOffset = g_primarySnapshotRect.left * bytesPerPixel;
+		for (LONG y = g_primarySnapshotRect.top; y < g_primarySnapshotRect.bottom; ++y)
+		{
+			memcpy(&g_primarySnapshot[y * width * bytesPerPixel + rowOffset],
+				static_cast<unsigned char*>(desc.lpSurface) + y * desc.lPitch + rowOffset, rowSize);
+		}
+		origVtable.Unlock(primary, nullptr);
+
+		if (1 != bytesPerPixel)
+		{
+			return true;
+		}
+
+		if (g_isGammaRampUsed)
+		{
+			for (int i = 0; i < 256; ++i)
+			{
+				entries[i].peRed = g_gammaLut.red[entries[i].peRed];
+				entries[i].peGreen = g_gammaLut.green[entries[i].peGreen];
+				entries[i].peBlue = g_gammaLut.blue[entries[i].peBlue];
+			}
+		}
+
+		for (int i = 0; i < 256; ++i)
+		{
+			g_snapshotPalette[i] = (entries[i].peRed << 16) | (entries[i].peGreen << 8) | entries[i].peBlue;
+		}
+		return true;
+	}
+
+	// Requires the present lock only
+	void convertPrimarySnapshot()
+	{
+		const DWORD width = g_primarySnapshotWidth;
+		const RECT& rect = g_primarySnapshotRect;
+		if (8 != g_primarySnapshotPf.dwRGBBitCount)
+		{
+			const DDraw::PixelFormatConverter::Image src = {
+				g_primarySnapshot.data(), static_cast<LONG>(width * g_primarySnapshotPf.dwRGBBitCount / 8) };
+			const DDraw::PixelFormatConverter::Image dst = {
+				g_formatConverterBuffer.data(), static_cast<LONG>(g_formatConverterPitch) };
+			DDraw::PixelFormatConverter::convert(g_primarySnapshotPf, src, g_formatConverterPf, dst, rect,
+				getGammaLut());
+			return;
+		}
+
+		for (LONG y = rect.top; y < rect.bottom; ++y)
+		{
+			const unsigned char* src = &g_primarySnapshot[y * width];
+			DWORD* dst = reinterpret_cast<DWORD*>(&g_formatConverterBuffer[y * g_formatConverterPitch]);
+			for (LONG x = rect.left; x < rect.right; ++x)
+			{
+				dst[x] = g_snapshotPalette[src[x]];
+			}
+		}
+	}
+
 	bool compatBlt()
 	{
 		Compat::LogEnter("RealPrimarySurface::compatBlt");
 
 		bool result = false;
+		const RECT rect = takeDirtyRect();
 
 		auto primary(DDraw::PrimarySurface::getPrimary());
-		if (DDraw::PrimarySurface::getDesc().ddpfPixelFormat.dwRGBBitCount <= 8)
+		if (isSoftwareConversionUsed())
 		{
+			Compat::ScopedProfiledCriticalSection presentLock(g_presentLock, __FUNCTION__);
+			result = snapshotPrimary(rect);
+			if (result)
+			{
+				convertPrimarySnapshot();
+			}
+			presentLock.unlock();
+
+			if (result)
+			{
+				result = SUCCEEDED(bltToPrimaryChain(*g_formatConverter, rect));
+			}
+		}
+		else if (DDraw::PrimarySurface::getDesc().ddpfPixelFormat.dwRGBBitCount <= 8)
+		{
+			// The DD thread lock is already held, so the present lock can be taken around these ddraw calls
+			Compat::ScopedProfiledCriticalSection presentLock(g_presentLock, __FUNCTION__);
 			HDC paletteConverterDc = nullptr;
-			g_paletteConverter->GetDC(g_paletteConverter, &paletteConverterDc);
+			g_formatConverter->GetDC(g_formatConverter, &paletteConverterDc);
 			HDC primaryDc = nullptr;
 			primary->GetDC(primary, &primaryDc);
 
 			if (paletteConverterDc && primaryDc)
 			{
 				result = TRUE == CALL_ORIG_FUNC(BitBlt)(paletteConverterDc,
-					0, 0, g_surfaceDesc.dwWidth, g_surfaceDesc.dwHeight, primaryDc, 0, 0, SRCCOPY);
+					rect.left, rect.top, rect.right - rect.left, rect.bottom - rect.top,
+					primaryDc, rect.left, rect.top, SRCCOPY);
 			}
 
 			primary->ReleaseDC(primary, primaryDc);
-			g_paletteConverter->ReleaseDC(g_paletteConverter, paletteConverterDc);
+			g_formatConverter->ReleaseDC(g_formatConverter, paletteConverterDc);
+			presentLock.unlock();
 
 			if (result)
 			{
-				result = SUCCEEDED(bltToPrimaryChain(*g_paletteConverter));
+				result = SUCCEEDED(bltToPrimaryChain(*g_formatConverter, rect));
 			}
 		}
 		else
 		{
-			result = SUCCEEDED(bltToPrimaryChain(*primary));
+			result = SUCCEEDED(bltToPrimaryChain(*primary, rect));
+		}
+
+		if (!result)
+		{
+			invalidateAll();
 		}
 
 		Compat::LogLeave("RealPrimarySurface::compatBlt") << result;
@@ -97,13 +354,9 @@ namespace
 	}
 
 	template <typename TDirectDraw>
-	HRESULT createPaletteConverter(CompatRef<TDirectDraw> dd)
+	HRESULT createFormatConverter(CompatRef<TDirectDraw> dd)
 	{
 		auto dm = DDraw::getDisplayMode(*CompatPtr<IDirectDraw7>::from(&dd));
-		if (dm.ddpfPixelFormat.dwRGBBitCount > 8)
-		{
-			return DD_OK;
-		}
 
 		typename DDraw::Types<TDirectDraw>::TSurfaceDesc desc = {};
 		desc.dwSize = sizeof(desc);
@@ -118,14 +371,48 @@ namespace
 		desc.ddpfPixelFormat.dwBBitMask = 0x000000FF;
 		desc.ddsCaps.dwCaps = DDSCAPS_OFFSCREENPLAIN | DDSCAPS_SYSTEMMEMORY;
 
-		CompatPtr<DDraw::Types<TDirectDraw>::TCreatedSurface> paletteConverter;
-		HRESULT result = dd->CreateSurface(&dd, &desc, &paletteConverter.getRef(), nullptr);
-		if (SUCCEEDED(result))
+		CompatPtr<DDraw::Types<TDirectDraw>::TCreatedSurface> formatConverter;
+		HRESULT result = dd->CreateSurface(&dd, &desc, &formatConverter.getRef(), nullptr);
+		if (FAILED(result))
 		{
-			g_paletteConverter = Compat::queryInterface<IDirectDrawSurface7>(paletteConverter.get());
+			return result;
 		}
 
-		return result;
+		g_formatConverter = Compat::queryInterface<IDirectDrawSurface7>(formatConverter.get());
+
+		DDSURFACEDESC2 converterDesc = {};
+		converterDesc.dwSize = sizeof(converterDesc);
+		g_formatConverter->GetSurfaceDesc(g_formatConverter, &converterDesc);
+
+		Compat::ScopedProfiledCriticalSection presentLock(g_presentLock, __FUNCTION__);
+		g_formatConverterPitch = converterDesc.lPitch;
+		g_formatConverterPf = converterDesc.ddpfPixelFormat;
+		g_formatConverterBuffer.resize(converterDesc.lPitch * converterDesc.dwHeight);
+
+		converterDesc.dwFlags = DDSD_LPSURFACE;
+		converterDesc.lpSurface = g_formatConverterBuffer.data();
+		if (FAILED(g_formatConverter->SetSurfaceDesc(g_formatConverter, &converterDesc, 0)))
+		{
+			Compat::Log() << "Failed to set the format converter surface memory, falling back to GDI conversion";
+			g_formatConverterBuffer.clear();
+		}
+
+		return DD_OK;
+	}
+
+	// 32 bpp modes only need the format converter to apply the software gamma ramp, so it is not created
+	// until a ramp other than the identity is set. On failure the gamma ramp is left to the driver.
+	void createGammaConverter()
+	{
+		DDraw::ScopedThreadLock lock(__FUNCTION__);
+		CompatPtr<IUnknown> dd;
+		g_frontBuffer->GetDDInterface(g_frontBuffer, reinterpret_cast<void**>(&dd.getRef()));
+		auto dd7(CompatPtr<IDirectDraw7>::from(dd.get()));
+		const HRESULT result = dd7 ? createFormatConverter<IDirectDraw7>(*dd7) : DDERR_GENERIC;
+		if (FAILED(result))
+		{
+			LOG_ONCE("Failed to create the software gamma converter surface: " << Compat::hex(result));
+		}
 	}
 
 	template <typename DirectDraw>
@@ -181,6 +468,7 @@ namespace
 		g_surfaceDesc = desc;
 		g_isFullScreen = isFlippable;
 		g_primaryThreadId = GetCurrentThreadId();
+		invalidateAll();
 
 		return DD_OK;
 	}
@@ -192,7 +480,8 @@ namespace
 
 	int msUntilNextUpdate()
 	{
-		DDraw::ScopedThreadLock lock;
+		// Not using ScopedThreadLock, which would end any idle GDI rendering session before the update is due
+		Compat::ScopedProfiledLock<decltype(DDraw::g_threadLock)> lock(DDraw::g_threadLock, __FUNCTION__);
 		const auto qpcNow = Time::queryPerformanceCounter();
 		const int result = max(0, Time::qpcToMs(g_qpcNextUpdate - qpcNow));
 		if (0 == result && g_isFullScreen && qpcNow - g_qpcLastFlip >= g_qpcFlipModeTimeout)
@@ -211,25 +500,95 @@ namespace
 		g_backBuffer = nullptr;
 		g_clipper.release();
 		g_isFullScreen = false;
-		g_paletteConverter.release();
+		g_formatConverter.release();
+
+		{
+			Compat::ScopedProfiledCriticalSection presentLock(g_presentLock, __FUNCTION__);
+			g_formatConverterBuffer.clear();
+			g_primarySnapshot.clear();
+			g_primarySnapshotWidth = 0;
+			setSoftwareGammaRamp(createIdentityGammaRamp());
+		}
 
 		ZeroMemory(&g_surfaceDesc, sizeof(g_surfaceDesc));
+		SetRectEmpty(&g_dirtyRect);
+		SetRectEmpty(&g_lastDirtyRect);
 
 		Compat::LogLeave("RealPrimarySurface::onRelease");
 	}
 
+	void flipNow()
+	{
+		D3dDdi::KernelModeThunks::overrideFlipInterval(
+			Time::queryPerformanceCounter() - g_qpcLastFlip >= g_qpcFlipModeTimeout
+			? D3DDDI_FLIPINTERVAL_ONE
+			: D3DDDI_FLIPINTERVAL_IMMEDIATE);
+		g_frontBuffer->Flip(g_frontBuffer, nullptr, DDFLIP_WAIT);
+		D3dDdi::KernelModeThunks::overrideFlipInterval(D3DDDI_FLIPINTERVAL_NOOVERRIDE);
+	}
+
 	void updateNow()
 	{
 		ResetEvent(g_updateEvent);
 
 		if (compatBlt() && g_isFullScreen)
 		{
-			D3dDdi::KernelModeThunks::overrideFlipInterval(
-				Time::queryPerformanceCounter() - g_qpcLastFlip >= g_qpcFlipModeTimeout
-				? D3DDDI_FLIPINTERVAL_ONE
-				: D3DDDI_FLIPINTERVAL_IMMEDIATE);
-			g_frontBuffer->Flip(g_frontBuffer, nullptr, DDFLIP_WAIT);
-			D3dDdi::KernelModeThunks::overrideFlipInterval(D3DDDI_FLIPINTERVAL_NOOVERRIDE);
+			flipNow();
+		}
+	}
+
+	// Same as updateNow, except that the palette or format conversion runs without holding the DD thread lock
+	void updateNowFromUpdateThread()
+	{
+		const auto threadLockAcquisitionId = DDraw::g_threadLock.lock(__FUNCTION__);
+		if (!isUpdateScheduled() || msUntilNextUpdate() > 0)
+		{
+			DDraw::g_threadLock.unlock(threadLockAcquisitionId);
+			return;
+		}
+
+		Gdi::endRenderingSession();
+
+		if (!isSoftwareConversionUsed())
+		{
+			updateNow();
+			DDraw::g_threadLock.unlock(threadLockAcquisitionId);
+			return;
+		}
+
+		ResetEvent(g_updateEvent);
+		const RECT rect = takeDirtyRect();
+		const auto presentLockAcquisitionId = g_presentLock.lock(__FUNCTION__);
+		const bool isSnapshotTaken = snapshotPrimary(rect);
+		if (!isSnapshotTaken)
+		{
+			invalidateAll();
+		}
+		DDraw::g_threadLock.unlock(threadLockAcquisitionId);
+
+		if (isSnapshotTaken)
+		{
+			convertPrimarySnapshot();
+		}
+		g_presentLock.unlock(presentLockAcquisitionId);
+
+		if (isSnapshotTaken)
+		{
+			// The primary may have been released while the DD thread lock was not held
+			DDraw::ScopedThreadLock lock(__FUNCTION__);
+			if (!g_formatConverter)
+			{
+				return;
+			}
+
+			if (FAILED(bltToPrimaryChain(*g_formatConverter, rect)))
+			{
+				invalidateAll();
+			}
+			else if (g_isFullScreen)
+			{
+				flipNow();
+			}
 		}
 	}
 
@@ -244,6 +603,8 @@ namespace
 				return 0;
 			}
 
+			Compat::LockProfile::logPeriodicReport();
+
 			const int waitTime = msUntilNextUpdate();
 			if (waitTime > 0)
 			{
@@ -251,11 +612,7 @@ namespace
 				continue;
 			}
 
-			DDraw::ScopedThreadLock lock;
-			if (isUpdateScheduled() && msUntilNextUpdate() <= 0)
-			{
-				updateNow();
-			}
+			updateNowFromUpdateThread();
 		}
 	}
 }
@@ -265,11 +622,16 @@ namespace DDraw
 	template <typename DirectDraw>
 	HRESULT RealPrimarySurface::create(CompatRef<DirectDraw> dd)
 	{
-		HRESULT result = createPaletteConverter(dd);
-		if (FAILED(result))
+		// The real display mode is always 32 bpp, so lower color depths are converted before presenting
+		HRESULT result = DD_OK;
+		if (DDraw::getDisplayMode(*CompatPtr<IDirectDraw7>::from(&dd)).ddpfPixelFormat.dwRGBBitCount < 32)
 		{
-			Compat::Log() << "Failed to create the palette converter surface: " << Compat::hex(result);
-			return result;
+			result = createFormatConverter(dd);
+			if (FAILED(result))
+			{
+				Compat::Log() << "Failed to create the format converter surface: " << Compat::hex(result);
+				return result;
+			}
 		}
 
 		typename Types<DirectDraw>::TSurfaceDesc desc = {};
@@ -292,7 +654,8 @@ namespace DDraw
 		if (FAILED(result))
 		{
 			Compat::Log() << "Failed to create the real primary surface: " << Compat::hex(result);
-			g_paletteConverter.release();
+			g_formatConverter.release();
+			g_formatConverterBuffer.clear();
 			return result;
 		}
 
@@ -333,6 +696,7 @@ namespace DDraw
 		g_isUpdateSuspended = false;
 
 		g_qpcLastFlip = Time::queryPerformanceCounter();
+		addDirtyRect(nullptr);
 		compatBlt();
 		HRESULT result = g_frontBuffer->Flip(g_frontBuffer, nullptr, flags);
 		g_qpcNextUpdate = Time::queryPerformanceCounter();
@@ -341,6 +705,12 @@ namespace DDraw
 
 	HRESULT RealPrimarySurface::getGammaRamp(DDGAMMARAMP* rampData)
 	{
+		if (isSoftwareGammaUsed())
+		{
+			*rampData = g_gammaRamp;
+			return DD_OK;
+		}
+
 		auto gammaControl(CompatPtr<IDirectDrawGammaControl>::from(g_frontBuffer.get()));
 		if (!gammaControl)
 		{
@@ -355,6 +725,11 @@ namespace DDraw
 		return g_frontBuffer;
 	}
 
+	void RealPrimarySurface::init()
+	{
+		InitializeCriticalSection(&g_presentCriticalSection);
+	}
+
 	bool RealPrimarySurface::isFullScreen()
 	{
 		return g_isFullScreen;
@@ -391,11 +766,28 @@ namespace DDraw
 
 	HRESULT RealPrimarySurface::restore()
 	{
+		invalidateAll();
 		return g_frontBuffer->Restore(g_frontBuffer);
 	}
 
 	HRESULT RealPrimarySurface::setGammaRamp(DDGAMMARAMP* rampData)
 	{
+		if (Config::softwareGamma && !g_formatConverter && g_frontBuffer &&
+			rampData && !isIdentityGammaRamp(*rampData))
+		{
+			createGammaConverter();
+		}
+
+		if (isSoftwareGammaUsed())
+		{
+			Compat::ScopedProfiledCriticalSection presentLock(g_presentLock, __FUNCTION__);
+			setSoftwareGammaRamp(rampData ? *rampData : createIdentityGammaRamp());
+			presentLock.unlock();
+
+			update();
+			return DD_OK;
+		}
+
 		auto gammaControl(CompatPtr<IDirectDrawGammaControl>::from(g_frontBuffer.get()));
 		if (!gammaControl)
 		{
@@ -415,8 +807,35 @@ namespace DDraw
 		updatePalette(0, 256);
 	}
 
-	void RealPrimarySurface::update()
+	void RealPrimarySurface::scheduleUpdate(const RECT* dirtyRect)
 	{
+		addDirtyRect(dirtyRect);
+		if (g_isUpdateSuspended || isUpdateScheduled())
+		{
+			return;
+		}
+
+		const auto qpcNow = Time::queryPerformanceCounter();
+		const long long missedIntervals = (qpcNow - g_qpcNextUpdate) / g_qpcUpdateInterval;
+		g_qpcNextUpdate += g_qpcUpdateInterval * (missedIntervals + 1);
+		if (Time::qpcToMs(g_qpcNextUpdate - qpcNow) < 2)
+		{
+			g_qpcNextUpdate += g_qpcUpdateInterval;
+		}
+
+		if (g_disableUpdateCount <= 0)
+		{
+			SetEvent(g_updateEvent);
+		}
+		else
+		{
+			g_isUpdateSuspended = true;
+		}
+	}
+
+	void RealPrimarySurface::update(const RECT* dirtyRect)
+	{
+		addDirtyRect(dirtyRect);
 		if (g_isUpdateSuspended)
 		{
 			return;
@@ -424,22 +843,7 @@ namespace DDraw
 
 		if (!isUpdateScheduled())
 		{
-			const auto qpcNow = Time::queryPerformanceCounter();
-			const long long missedIntervals = (qpcNow - g_qpcNextUpdate) / g_qpcUpdateInterval;
-			g_qpcNextUpdate += g_qpcUpdateInterval * (missedIntervals + 1);
-			if (Time::qpcToMs(g_qpcNextUpdate - qpcNow) < 2)
-			{
-				g_qpcNextUpdate += g_qpcUpdateInterval;
-			}
-
-			if (g_disableUpdateCount <= 0)
-			{
-				SetEvent(g_updateEvent);
-			}
-			else
-			{
-				g_isUpdateSuspended = true;
-			}
+			scheduleUpdate(dirtyRect);
 		}
 		else if (msUntilNextUpdate() <= 0)
 		{
@@ -20,14 +20,16 @@ namespace DDraw
 		static HRESULT flip(DWORD flags);
 		static HRESULT getGammaRamp(DDGAMMARAMP* rampData);
 		static CompatWeakPtr<IDirectDrawSurface7> getSurface();
+		static void init();
 		static bool isFullScreen();
 		static bool isLost();
 		static void release();
 		static void removeUpdateThread();
 		static HRESULT restore();
+		static void scheduleUpdate(const RECT* dirtyRect = nullptr);
 		static HRESULT setGammaRamp(DDGAMMARAMP* rampData);
 		static void setPalette();
-		static void update();
+		static void update(const RECT* dirtyRect = nullptr);
 		static void updatePalette(DWORD startingEntry, DWORD count);
 	};
 }
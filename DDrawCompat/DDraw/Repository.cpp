@@ -1,36 +1,73 @@
 #include <algorithm>
 #include <map>
-#include <vector>
 
 #include "Common/CompatPtr.h"
 #include "Common/Log.h"
-#include "DDraw/DirectDraw.h"
+#include "Config/Config.h"
 #include "DDraw/Repository.h"
+#include "DDraw/SurfacePool.h"
 #include "Dll/Procs.h"
 
 namespace
 {
 	using DDraw::Repository::Surface;
 
-	struct Repository
+	// Cached surfaces are bucketed by DirectDraw object, pixel format, memory type and size. Surfaces are created
+	// with sizes rounded up to a multiple of SIZE_GRANULARITY, so that similar requests share buckets.
+	// Every surface in a bucket has the same dimensions, so any of them satisfies a request.
+	struct PoolKey
 	{
-		CompatWeakPtr<IDirectDraw7> dd;
-		std::vector<Surface> surfaces;
+		void* ddObject;
+		DDPIXELFORMAT pf;
+		DWORD memCaps;
+		DWORD width;
+		DWORD height;
 	};
 
-	Repository g_sysMemRepo;
-	std::map<void*, Repository> g_vidMemRepos;
+	struct PoolKeyLess
+	{
+		bool operator()(const PoolKey& lhs, const PoolKey& rhs) const
+		{
+			return memcmp(&lhs, &rhs, sizeof(lhs)) < 0;
+		}
+	};
+
+	class SurfaceOwner : public DDraw::SurfacePool<PoolKey, Surface, PoolKeyLess>::Owner
+	{
+	public:
+		virtual bool restore(Surface& surface) override
+		{
+			return SUCCEEDED(surface.surface->IsLost(surface.surface)) ||
+				SUCCEEDED(surface.surface->Restore(surface.surface));
+		}
+
+		virtual void release(Surface& surface) override
+		{
+			surface.surface.release();
+		}
+	};
+
+	const DWORD SIZE_GRANULARITY = 64;
+
+	CompatWeakPtr<IDirectDraw7> g_sysMemDd;
+	std::map<void*, CompatWeakPtr<IDirectDraw7>> g_vidMemDds;
+	SurfaceOwner g_surfaceOwner;
+	DDraw::SurfacePool<PoolKey, Surface, PoolKeyLess> g_pool(
+		g_surfaceOwner, Config::surfaceRepositoryBudgetKb * 1024ULL);
+	unsigned long long g_hitCount = 0;
+	unsigned long long g_missCount = 0;
+	unsigned long long g_loggedEvictionCount = 0;
 
 	CompatPtr<IDirectDraw7> createDirectDraw();
 	Surface createSurface(CompatRef<IDirectDraw7> dd,
 		DWORD width, DWORD height, const DDPIXELFORMAT& pf, DWORD caps);
-	std::vector<Surface>::iterator findSurface(DWORD width, DWORD height, const DDPIXELFORMAT& pf,
-		std::vector<Surface>& cachedSurfaces);
-	void destroySmallerSurfaces(DWORD width, DWORD height, const DDPIXELFORMAT& pf,
-		std::vector<Surface>& cachedSurfaces);
-	Surface getSurface(CompatRef<IDirectDraw7> dd, const DDSURFACEDESC2& desc);
+	CompatWeakPtr<IDirectDraw7> getDirectDraw(void* ddObject, DWORD caps);
+	PoolKey getPoolKey(const Surface& surface);
+	Surface getSurface(void* ddObject, const DDSURFACEDESC2& desc);
+	void logStats();
 	void normalizePixelFormat(DDPIXELFORMAT& pf);
 	void returnSurface(const Surface& surface);
+	DWORD roundSize(DWORD size);
 
 	CompatPtr<IDirectDraw7> createDirectDraw()
 	{
@@ -69,99 +106,92 @@ namespace
 		return surface;
 	}
 
-	void destroySmallerSurfaces(DWORD width, DWORD height, const DDPIXELFORMAT& pf,
-		std::vector<Surface>& cachedSurfaces)
+	CompatWeakPtr<IDirectDraw7> getDirectDraw(void* ddObject, DWORD caps)
 	{
-		auto it = cachedSurfaces.begin();
-		while (it != cachedSurfaces.end())
+		if (caps & DDSCAPS_SYSTEMMEMORY)
 		{
-			if (it->desc.dwWidth <= width && it->desc.dwHeight <= height &&
-				0 == memcmp(&it->desc.ddpfPixelFormat, &pf, sizeof(pf)))
-			{
-				it->surface.release();
-				it = cachedSurfaces.erase(it);
-			}
-			else
-			{
-				++it;
-			}
+			g_sysMemDd = DDraw::Repository::getDirectDraw();
+			return g_sysMemDd;
 		}
-	}
 
-	std::vector<Surface>::iterator findSurface(DWORD width, DWORD height, const DDPIXELFORMAT& pf,
-		std::vector<Surface>& cachedSurfaces)
-	{
-		auto it = cachedSurfaces.begin();
-		while (it != cachedSurfaces.end())
+		auto it = g_vidMemDds.find(ddObject);
+		if (it == g_vidMemDds.end())
 		{
-			if (it->desc.dwWidth >= width && it->desc.dwHeight >= height &&
-				0 == memcmp(&it->desc.ddpfPixelFormat, &pf, sizeof(pf)))
-			{
-				if (FAILED(it->surface->IsLost(it->surface)) &&
-					FAILED(it->surface->Restore(it->surface)))
-				{
-					it->surface.release();
-					it = cachedSurfaces.erase(it);
-					continue;
-				}
-				return it;
-			}
-			++it;
+			return g_vidMemDds[ddObject] = createDirectDraw().detach();
 		}
+		return it->second;
+	}
 
-		return cachedSurfaces.end();
+	PoolKey getPoolKey(const Surface& surface)
+	{
+		PoolKey key = {};
+		key.ddObject = (surface.desc.ddsCaps.dwCaps & DDSCAPS_SYSTEMMEMORY) ? nullptr : surface.ddObject;
+		key.pf = surface.desc.ddpfPixelFormat;
+		key.memCaps = surface.desc.ddsCaps.dwCaps & (DDSCAPS_SYSTEMMEMORY | DDSCAPS_VIDEOMEMORY);
+		key.width = surface.desc.dwWidth;
+		key.height = surface.desc.dwHeight;
+		return key;
 	}
 
-	Repository& getRepository(CompatRef<IDirectDraw7> dd, DWORD caps)
+	Surface getSurface(void* ddObject, const DDSURFACEDESC2& desc)
 	{
-		if (caps & DDSCAPS_SYSTEMMEMORY)
+		auto dd(getDirectDraw(ddObject, desc.ddsCaps.dwCaps));
+		if (!dd)
 		{
-			g_sysMemRepo.dd = DDraw::Repository::getDirectDraw();
-			return g_sysMemRepo;
+			return Surface();
 		}
 
-		void* ddObject = DDraw::getDdObject(dd.get());
-		auto it = g_vidMemRepos.find(ddObject);
-		if (it == g_vidMemRepos.end())
+		const DWORD caps = DDSCAPS_OFFSCREENPLAIN |
+			((desc.ddsCaps.dwCaps & DDSCAPS_SYSTEMMEMORY) ? DDSCAPS_SYSTEMMEMORY : DDSCAPS_VIDEOMEMORY);
+		Surface surface = {};
+		surface.ddObject = ddObject;
+		surface.desc.ddpfPixelFormat = desc.ddpfPixelFormat;
+		normalizePixelFormat(surface.desc.ddpfPixelFormat);
+		surface.desc.ddsCaps.dwCaps = caps;
+		surface.desc.dwWidth = roundSize(desc.dwWidth);
+		surface.desc.dwHeight = roundSize(desc.dwHeight);
+
+		PoolKey key = getPoolKey(surface);
+		if (g_pool.get(key, surface))
 		{
-			Repository repo = {};
-			repo.dd = createDirectDraw().detach();
-			return g_vidMemRepos[ddObject] = repo;
+			++g_hitCount;
+			return surface;
 		}
-		return it->second;
-	}
 
-	Surface getSurface(CompatRef<IDirectDraw7> dd, const DDSURFACEDESC2& desc)
-	{
-		Repository& repo = getRepository(dd, desc.ddsCaps.dwCaps);
-		if (!repo.dd)
+		++g_missCount;
+		if (0 == (g_missCount & (g_missCount - 1)))
 		{
-			return Surface();
+			logStats();
 		}
 
-		DDPIXELFORMAT pf = desc.ddpfPixelFormat;
-		normalizePixelFormat(pf);
-
-		auto it = findSurface(desc.dwWidth, desc.dwHeight, pf, repo.surfaces);
-		if (it != repo.surfaces.end())
+		Surface newSurface = createSurface(*dd, key.width, key.height, key.pf, caps);
+		if (!newSurface.surface && (key.width != desc.dwWidth || key.height != desc.dwHeight))
 		{
-			Surface cachedSurface = *it;
-			repo.surfaces.erase(it);
-			return cachedSurface;
+			// Rounding can exceed the limits of the driver or the remaining video memory,
+			// so surfaces with the exact size are used instead, which are pooled separately
+			key.width = desc.dwWidth;
+			key.height = desc.dwHeight;
+			if (g_pool.get(key, surface))
+			{
+				return surface;
+			}
+			newSurface = createSurface(*dd, key.width, key.height, key.pf, caps);
 		}
 
-		const DWORD memFlag = (desc.ddsCaps.dwCaps & DDSCAPS_SYSTEMMEMORY)
-			? DDSCAPS_SYSTEMMEMORY : DDSCAPS_VIDEOMEMORY;
-		Surface newSurface = createSurface(*repo.dd, desc.dwWidth, desc.dwHeight, pf,
-			DDSCAPS_OFFSCREENPLAIN | memFlag);
 		if (newSurface.surface)
 		{
-			newSurface.ddObject = DDraw::getDdObject(dd.get());
-			destroySmallerSurfaces(desc.dwWidth, desc.dwHeight, pf, repo.surfaces);
+			newSurface.ddObject = ddObject;
 		}
 		return newSurface;
 	}
 
+	void logStats()
+	{
+		Compat::Log() << "Surface repository: " << g_pool.getSurfaceCount() << " surfaces, " <<
+			g_pool.getPooledSize() / 1024 << " KB (hits: " << g_hitCount << ", misses: " << g_missCount <<
+			", evictions: " << g_pool.getEvictionCount() << ')';
+	}
+
 	void normalizePixelFormat(DDPIXELFORMAT& pf)
 	{
 		if (!(pf.dwFlags & DDPF_FOURCC))
@@ -181,23 +211,37 @@ namespace
 			return;
 		}
 
-		if (surface.desc.ddsCaps.dwCaps & DDSCAPS_SYSTEMMEMORY)
+		if (!(surface.desc.ddsCaps.dwCaps & DDSCAPS_SYSTEMMEMORY) &&
+			g_vidMemDds.find(surface.ddObject) == g_vidMemDds.end())
 		{
-			g_sysMemRepo.surfaces.push_back(surface);
+			surface.surface->Release(surface.surface);
+			return;
 		}
-		else
+
+		const DWORD bpp = std::max<DWORD>(surface.desc.ddpfPixelFormat.dwRGBBitCount, 8);
+		g_pool.put(getPoolKey(surface), surface, 1ULL * surface.desc.dwWidth * surface.desc.dwHeight * bpp / 8);
+
+		const unsigned long long evictionCount = g_pool.getEvictionCount();
+		if (evictionCount != g_loggedEvictionCount && 0 == (evictionCount & (evictionCount - 1)))
 		{
-			g_vidMemRepos[surface.ddObject].surfaces.push_back(surface);
+			g_loggedEvictionCount = evictionCount;
+			logStats();
 		}
 	}
+
+	DWORD roundSize(DWORD size)
+	{
+		return size <= SIZE_GRANULARITY ? SIZE_GRANULARITY
+			: (size + SIZE_GRANULARITY - 1) / SIZE_GRANULARITY * SIZE_GRANULARITY;
+	}
 }
 
 namespace DDraw
 {
 	namespace Repository
 	{
-		ScopedSurface::ScopedSurface(CompatRef<IDirectDraw7> dd, const DDSURFACEDESC2& desc)
-			: Surface(getSurface(dd, desc))
+		ScopedSurface::ScopedSurface(void* ddObject, const DDSURFACEDESC2& desc)
+			: Surface(getSurface(ddObject, desc))
 		{
 			if (surface)
 			{
@@ -219,14 +263,11 @@ namespace DDraw
 
 		void onRelease(void* ddObject)
 		{
-			auto it = g_vidMemRepos.find(ddObject);
-			if (it != g_vidMemRepos.end())
+			auto it = g_vidMemDds.find(ddObject);
+			if (it != g_vidMemDds.end())
 			{
-				for (auto& surface : it->second.surfaces)
-				{
-					surface.surface->Release(surface.surface);
-				}
-				g_vidMemRepos.erase(it);
+				g_pool.releaseIf([=](const PoolKey& key) { return key.ddObject == ddObject; });
+				g_vidMemDds.erase(it);
 			}
 		}
 	}
@@ -21,7 +21,7 @@ namespace DDraw
 		class ScopedSurface : public Surface
 		{
 		public:
-			ScopedSurface(CompatRef<IDirectDraw7> dd, const DDSURFACEDESC2& desc);
+			ScopedSurface(void* ddObject, const DDSURFACEDESC2& desc);
 			~ScopedSurface();
 		};
 
@@ -0,0 +1,14 @@
+#include "Config/Config.h"
+#include "DDraw/ScopedThreadLock.h"
+#include "Gdi/Gdi.h"
+
+namespace DDraw
+{
+	Compat::ProfiledLock<ThreadLockPolicy> g_threadLock("DD thread lock", Config::lockProfiling);
+
+	ScopedThreadLock::ScopedThreadLock(const char* callSite)
+		: m_acquisitionId(g_threadLock.lock(callSite))
+	{
+		Gdi::endRenderingSession();
+	}
+}
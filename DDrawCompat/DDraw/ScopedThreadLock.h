@@ -1,20 +1,34 @@
 #pragma once
 
+#include "Common/ProfiledLock.h"
+#include "Common/Time.h"
 #include "Dll/Procs.h"
 
 namespace DDraw
 {
+	class ThreadLockPolicy
+	{
+	public:
+		void lock() { Dll::g_origProcs.AcquireDDThreadLock(); }
+		void unlock() { Dll::g_origProcs.ReleaseDDThreadLock(); }
+
+		static long long getTimeNs() { return Time::qpcToNs(Time::queryPerformanceCounter()); }
+		static unsigned long getThreadId() { return GetCurrentThreadId(); }
+	};
+
+	extern Compat::ProfiledLock<ThreadLockPolicy> g_threadLock;
+
 	class ScopedThreadLock
 	{
 	public:
-		ScopedThreadLock()
-		{
-			Dll::g_origProcs.AcquireDDThreadLock();
-		}
+		ScopedThreadLock(const char* callSite = "DDraw::ScopedThreadLock");
 
 		~ScopedThreadLock()
 		{
-			Dll::g_origProcs.ReleaseDDThreadLock();
+			g_threadLock.unlock(m_acquisitionId);
 		}
+
+	private:
+		decltype(g_threadLock)::AcquisitionId m_acquisitionId;
 	};
 }
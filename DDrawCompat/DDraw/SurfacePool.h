@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <map>
+#include <vector>
+
+// Cache of surfaces bucketed by key, with one LRU list and a byte budget shared by all buckets.
+// This file must stay free of Windows dependencies so the pool can be tested on any platform.
+
+namespace DDraw
+{
+	// Surface must be copyable
+	template <typename Key, typename Surface, typename KeyLess = std::less<Key>>
+	class SurfacePool
+	{
+	public:
+		class Owner
+		{
+		public:
+			virtual ~Owner() {}
+
+			// Returns false if the surface is lost and cannot be restored
+			virtual bool restore(Surface& surface) = 0;
+			virtual void release(Surface& surface) = 0;
+		};
+
+		SurfacePool(Owner& owner, unsigned long long budget)
+			: m_owner(owner)
+			, m_budget(budget)
+			, m_pooledSize(0)
+			, m_evictionCount(0)
+		{
+		}
+
+		// Takes the most recently pooled usable surface with the given key. Lost surfaces found on the way are released.
+		bool get(const Key& key, Surface& surface)
+		{
+			auto bucket = m_buckets.find(key);
+			if (bucket == m_buckets.end())
+			{
+				return false;
+			}
+
+			auto& entries = bucket->second;
+			bool isFound = false;
+			while (!isFound && !entries.empty())
+			{
+				auto it = entries.back();
+				entries.pop_back();
+
+				surface = it->surface;
+				m_pooledSize -= it->size;
+				m_lru.erase(it);
+
+				isFound = m_owner.restore(surface);
+				if (!isFound)
+				{
+					m_owner.release(surface);
+				}
+			}
+
+			if (entries.empty())
+			{
+				m_buckets.erase(bucket);
+			}
+			return isFound;
+		}
+
+		// Pools the surface as the most recently used one, then evicts the least recently used surfaces
+		// until the pooled size fits in the budget
+		void put(const Key& key, const Surface& surface, unsigned long long size)
+		{
+			m_lru.push_front({ key, surface, size });
+			m_pooledSize += size;
+			m_buckets[key].push_back(m_lru.begin());
+
+			while (m_pooledSize > m_budget && !m_lru.empty())
+			{
+				evict(std::prev(m_lru.end()));
+				++m_evictionCount;
+			}
+		}
+
+		// Releases all pooled surfaces with keys matching the predicate, without counting them as evictions
+		template <typename Predicate>
+		void releaseIf(Predicate isMatch)
+		{
+			for (auto it = m_lru.begin(); it != m_lru.end();)
+			{
+				auto next = std::next(it);
+				if (isMatch(it->key))
+				{
+					evict(it);
+				}
+				it = next;
+			}
+		}
+
+		unsigned long long getEvictionCount() const { return m_evictionCount; }
+		unsigned long long getPooledSize() const { return m_pooledSize; }
+		std::size_t getSurfaceCount() const { return m_lru.size(); }
+
+	private:
+		struct Entry
+		{
+			Key key;
+			Surface surface;
+			unsigned long long size;
+		};
+
+		typedef std::list<Entry> LruList;
+
+		void evict(typename LruList::iterator it)
+		{
+			auto bucket = m_buckets.find(it->key);
+			if (bucket != m_buckets.end())
+			{
+				auto& entries = bucket->second;
+				entries.erase(std::remove(entries.begin(), entries.end(), it), entries.end());
+				if (entries.empty())
+				{
+					m_buckets.erase(bucket);
+				}
+			}
+
+			m_pooledSize -= it->size;
+			m_owner.release(it->surface);
+			m_lru.erase(it);
+		}
+
+		Owner& m_owner;
+		unsigned long long m_budget;
+		unsigned long long m_pooledSize;
+		unsigned long long m_evictionCount;
+		// Most recently pooled first
+		LruList m_lru;
+		std::map<Key, std::vector<typename LruList::iterator>, KeyLess> m_buckets;
+	};
+}
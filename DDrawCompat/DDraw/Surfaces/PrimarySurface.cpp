@@ -160,6 +160,12 @@ namespace DDraw
 		return g_origCaps;
 	}
 
+	void PrimarySurface::updateDesc(CompatRef<IDirectDrawSurface7> dds)
+	{
+		Surface::updateDesc(dds);
+		m_surface->updateDesc(dds);
+	}
+
 	void PrimarySurface::resizeBuffers(CompatRef<IDirectDrawSurface7> surface)
 	{
 		DDSCAPS2 flipCaps = {};
@@ -22,6 +22,7 @@ namespace DDraw
 		static CompatWeakPtr<IDirectDrawSurface7> getPrimary();
 		static DWORD getOrigCaps();
 
+		virtual void updateDesc(CompatRef<IDirectDrawSurface7> dds) override;
 		void updateGdiSurfacePtr(IDirectDrawSurface* flipTargetOverride);
 
 		static CompatWeakPtr<IDirectDrawPalette> s_palette;
@@ -40,7 +40,7 @@ namespace DDraw
 		HRESULT result = m_impl.Blt(This, lpDestRect, lpDDSrcSurface, lpSrcRect, dwFlags, lpDDBltFx);
 		if (SUCCEEDED(result))
 		{
-			RealPrimarySurface::update();
+			RealPrimarySurface::update(lpDestRect);
 		}
 		return result;
 	}
@@ -67,13 +67,22 @@ namespace DDraw
 			}
 			else
 			{
-				TSurfaceDesc desc = {};
-				desc.dwSize = sizeof(desc);
-				CompatVtable<Vtable<TSurface>>::s_origVtable.GetSurfaceDesc(lpDDSrcSurface, &desc);
-				destRect.right += desc.dwWidth;
-				destRect.bottom += desc.dwHeight;
+				Surface* srcSurface = Surface::getSurface(*lpDDSrcSurface);
+				if (srcSurface)
+				{
+					destRect.right += srcSurface->getDesc().dwWidth;
+					destRect.bottom += srcSurface->getDesc().dwHeight;
+				}
+				else
+				{
+					TSurfaceDesc desc = {};
+					desc.dwSize = sizeof(desc);
+					CompatVtable<Vtable<TSurface>>::s_origVtable.GetSurfaceDesc(lpDDSrcSurface, &desc);
+					destRect.right += desc.dwWidth;
+					destRect.bottom += desc.dwHeight;
+				}
 			}
-			RealPrimarySurface::update();
+			RealPrimarySurface::update(&destRect);
 		}
 		return result;
 	}
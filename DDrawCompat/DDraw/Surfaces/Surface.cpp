@@ -110,6 +110,7 @@ namespace DDraw
 		: m_ddObject(nullptr)
 		, m_ddId()
 		, m_refCount(0)
+		, m_desc()
 	{
 	}
 
@@ -134,6 +135,7 @@ namespace DDraw
 
 			privateData->m_ddId = getDdIidFromVtablePtr(reinterpret_cast<void**>(dd.get())[0]);
 			privateData->m_ddObject = DDraw::getDdObject(*CompatPtr<IDirectDraw>(dd));
+			privateData->updateDesc(dds);
 
 			privateData.release();
 		}
@@ -204,6 +206,16 @@ namespace DDraw
 	template <>
 	SurfaceImpl<IDirectDrawSurface7>* Surface::getImpl<IDirectDrawSurface7>() const { return m_impl7.get(); }
 
+	void* Surface::getDdObject() const
+	{
+		return m_ddObject;
+	}
+
+	const DDSURFACEDESC2& Surface::getDesc() const
+	{
+		return m_desc.get();
+	}
+
 	template <typename TSurface>
 	Surface* Surface::getSurface(TSurface& dds)
 	{
@@ -223,4 +235,12 @@ namespace DDraw
 	template Surface* Surface::getSurface(IDirectDrawSurface3& dds);
 	template Surface* Surface::getSurface(IDirectDrawSurface4& dds);
 	template Surface* Surface::getSurface(IDirectDrawSurface7& dds);
+
+	void Surface::updateDesc(CompatRef<IDirectDrawSurface7> dds)
+	{
+		m_desc.update([&](DDSURFACEDESC2& desc)
+		{
+			CompatVtable<IDirectDrawSurface7Vtbl>::s_origVtable.GetSurfaceDesc(&dds, &desc);
+		});
+	}
 }
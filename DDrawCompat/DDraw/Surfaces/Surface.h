@@ -8,6 +8,7 @@
 
 #include "Common/CompatPtr.h"
 #include "Common/CompatRef.h"
+#include "DDraw/Surfaces/SurfaceDescCache.h"
 
 namespace DDraw
 {
@@ -32,6 +33,10 @@ namespace DDraw
 		template <typename TSurface>
 		SurfaceImpl<TSurface>* getImpl() const;
 
+		void* getDdObject() const;
+		const DDSURFACEDESC2& getDesc() const;
+		virtual void updateDesc(CompatRef<IDirectDrawSurface7> dds);
+
 	protected:
 		Surface();
 
@@ -54,5 +59,6 @@ namespace DDraw
 
 		IID m_ddId;
 		DWORD m_refCount;
+		SurfaceDescCache<DDSURFACEDESC2> m_desc;
 	};
 }
@@ -0,0 +1,44 @@
+#pragma once
+
+// Caches the description of a surface, so that blits do not need to query it.
+// This file must stay free of Windows dependencies so the cache can be tested on any platform.
+
+namespace DDraw
+{
+	template <typename Desc>
+	class SurfaceDescCache
+	{
+	public:
+		SurfaceDescCache() : m_desc() {}
+
+		const Desc& get() const { return m_desc; }
+
+		// Queries the description with getDesc(Desc&). Only the immutable properties are meaningful,
+		// so lpSurface, which is not valid outside of Lock, is not kept.
+		template <typename GetDesc>
+		void update(GetDesc getDesc)
+		{
+			Desc desc = {};
+			desc.dwSize = sizeof(desc);
+			getDesc(desc);
+			desc.lpSurface = nullptr;
+			m_desc = desc;
+		}
+
+		// Forwards a call that can change the description, such as Restore or SetSurfaceDesc,
+		// and runs update() if the call returns a success code
+		template <typename Call, typename Update>
+		static auto updateAfter(Call call, Update update) -> decltype(call())
+		{
+			const auto result = call();
+			if (result >= 0)
+			{
+				update();
+			}
+			return result;
+		}
+
+	private:
+		Desc m_desc;
+	};
+}
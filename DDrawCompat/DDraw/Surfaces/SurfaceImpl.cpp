@@ -1,6 +1,11 @@
 #include <set>
+#include <vector>
 
+#include "Common/CompatPtr.h"
 #include "Common/CompatRef.h"
+#include "Config/Config.h"
+#include "DDraw/Blitter.h"
+#include "DDraw/FourCcConverter.h"
 #include "DDraw/Repository.h"
 #include "DDraw/Surfaces/Surface.h"
 #include "DDraw/Surfaces/SurfaceImpl.h"
@@ -26,6 +31,94 @@ namespace
 			dst->SetColorKey(&dst, ckFlag, &ck);
 		}
 	}
+
+	bool getBltRect(const RECT* rect, const DDSURFACEDESC2& desc, RECT& bltRect)
+	{
+		if (!rect)
+		{
+			bltRect = { 0, 0, static_cast<LONG>(desc.dwWidth), static_cast<LONG>(desc.dwHeight) };
+			return true;
+		}
+
+		bltRect = *rect;
+		return bltRect.left >= 0 && bltRect.top >= 0 && bltRect.left < bltRect.right && bltRect.top < bltRect.bottom &&
+			bltRect.right <= static_cast<LONG>(desc.dwWidth) && bltRect.bottom <= static_cast<LONG>(desc.dwHeight);
+	}
+
+	DWORD getColorKeyMask(const DDPIXELFORMAT& pf)
+	{
+		const DWORD mask = pf.dwRBitMask | pf.dwGBitMask | pf.dwBBitMask |
+			((pf.dwFlags & DDPF_ALPHAPIXELS) ? pf.dwRGBAlphaBitMask : 0);
+		if (0 != mask)
+		{
+			return mask;
+		}
+		return pf.dwRGBBitCount >= 32 ? 0xFFFFFFFF : (1U << pf.dwRGBBitCount) - 1;
+	}
+
+	// DDRAWCOMPAT_SOFTWARE_BLITTER=0 or 1 overrides Config::softwareBlitter, for comparisons without rebuilding
+	bool isSoftwareBlitterEnabled()
+	{
+		static const bool isEnabled = []()
+		{
+			char value[2] = {};
+			if (1 == GetEnvironmentVariable("DDRAWCOMPAT_SOFTWARE_BLITTER", value, sizeof(value)))
+			{
+				return '0' != value[0];
+			}
+			return Config::softwareBlitter;
+		}();
+		return isEnabled;
+	}
+
+	template <typename TSurface>
+	DDSURFACEDESC2 getDesc(TSurface* surface)
+	{
+		DDraw::Surface* surfaceData = DDraw::Surface::getSurface(*surface);
+		if (surfaceData)
+		{
+			return surfaceData->getDesc();
+		}
+
+		typename DDraw::Types<TSurface>::TSurfaceDesc desc = {};
+		desc.dwSize = sizeof(desc);
+		CompatVtable<Vtable<TSurface>>::s_origVtable.GetSurfaceDesc(surface, &desc);
+
+		// DDSURFACEDESC is a prefix of DDSURFACEDESC2 up to the first DWORD of ddsCaps
+		DDSURFACEDESC2 desc2 = {};
+		memcpy(&desc2, &desc, sizeof(desc));
+		desc2.dwSize = sizeof(desc2);
+		return desc2;
+	}
+
+	template <typename TSurface>
+	RECT getBltFastDstRect(DWORD x, DWORD y, TSurface* srcSurface, const RECT* srcRect)
+	{
+		RECT dstRect = { static_cast<LONG>(x), static_cast<LONG>(y) };
+		if (srcRect)
+		{
+			dstRect.right = x + srcRect->right - srcRect->left;
+			dstRect.bottom = y + srcRect->bottom - srcRect->top;
+		}
+		else if (srcSurface)
+		{
+			const DDSURFACEDESC2 desc = getDesc(srcSurface);
+			dstRect.right = x + desc.dwWidth;
+			dstRect.bottom = y + desc.dwHeight;
+		}
+		return dstRect;
+	}
+
+	template <typename TSurface>
+	void updateDesc(TSurface* surface)
+	{
+		DDraw::Surface* surfaceData = DDraw::Surface::getSurface(*surface);
+		if (surfaceData)
+		{
+			CompatPtr<IDirectDrawSurface7> surface7(Compat::queryInterface<IDirectDrawSurface7>(surface));
+			surfaceData->updateDesc(*surface7);
+		}
+	}
 }
 
 namespace DDraw
@@ -37,7 +130,7 @@ namespace DDraw
 
 	template <typename TSurface>
 	bool SurfaceImpl<TSurface>::bltRetry(TSurface*& dstSurface, RECT*& dstRect,
-		TSurface*& srcSurface, RECT*& srcRect, bool isTransparentBlt,
+		TSurface*& srcSurface, RECT*& srcRect, bool isTransparentBlt, bool isSimpleCopy,
 		const std::function<HRESULT()>& blt)
 	{
 		if (!dstSurface || !srcSurface)
@@ -45,13 +138,14 @@ namespace DDraw
 			return false;
 		}
 
-		TSurfaceDesc dstDesc = {};
-		dstDesc.dwSize = sizeof(dstDesc);
-		s_origVtable.GetSurfaceDesc(dstSurface, &dstDesc);
+		const DDSURFACEDESC2 dstDesc = getDesc(dstSurface);
+		const DDSURFACEDESC2 srcDesc = getDesc(srcSurface);
 
-		TSurfaceDesc srcDesc = {};
-		srcDesc.dwSize = sizeof(srcDesc);
-		s_origVtable.GetSurfaceDesc(srcSurface, &srcDesc);
+		if (isSimpleCopy && FourCcConverter::isSupported(srcDesc.ddpfPixelFormat, dstDesc.ddpfPixelFormat) &&
+			convertFourCcBlt(dstSurface, dstRect, dstDesc, srcSurface, srcRect, srcDesc))
+		{
+			return true;
+		}
 
 		if ((dstDesc.ddpfPixelFormat.dwFlags & DDPF_FOURCC) &&
 			(dstDesc.ddsCaps.dwCaps & DDSCAPS_VIDEOMEMORY) &&
@@ -77,9 +171,298 @@ namespace DDraw
 		return false;
 	}
 
+	template <typename TSurface>
+	bool SurfaceImpl<TSurface>::convertFourCcBlt(TSurface* dstSurface, const RECT* dstRect, const DDSURFACEDESC2& dstDesc,
+		TSurface* srcSurface, const RECT* srcRect, const DDSURFACEDESC2& srcDesc)
+	{
+		RECT srcBltRect = {};
+		RECT dstBltRect = {};
+		if (!getBltRect(srcRect, srcDesc, srcBltRect) || !getBltRect(dstRect, dstDesc, dstBltRect))
+		{
+			return false;
+		}
+
+		// The clip list is not applied by the converter, so clipped blits are left to the driver
+		CompatPtr<IDirectDrawClipper> clipper;
+		if (SUCCEEDED(s_origVtable.GetClipper(dstSurface, &clipper.getRef())))
+		{
+			return false;
+		}
+
+		TSurfaceDesc srcLockDesc = {};
+		srcLockDesc.dwSize = sizeof(srcLockDesc);
+		if (FAILED(s_origVtable.Lock(srcSurface, nullptr, &srcLockDesc, DDLOCK_READONLY | DDLOCK_WAIT, nullptr)))
+		{
+			return false;
+		}
+
+		TSurfaceDesc dstLockDesc = {};
+		dstLockDesc.dwSize = sizeof(dstLockDesc);
+		if (FAILED(s_origVtable.Lock(dstSurface, nullptr, &dstLockDesc, DDLOCK_WRITEONLY | DDLOCK_WAIT, nullptr)))
+		{
+			s_origVtable.Unlock(srcSurface, nullptr);
+			return false;
+		}
+
+		const FourCcConverter::Image src = {
+			srcLockDesc.lpSurface, srcLockDesc.lPitch, srcLockDesc.dwWidth, srcLockDesc.dwHeight };
+		const FourCcConverter::Image dst = {
+			dstLockDesc.lpSurface, dstLockDesc.lPitch, dstLockDesc.dwWidth, dstLockDesc.dwHeight };
+		FourCcConverter::convert(srcDesc.ddpfPixelFormat, src, srcBltRect, dstDesc.ddpfPixelFormat, dst, dstBltRect);
+
+		s_origVtable.Unlock(dstSurface, nullptr);
+		s_origVtable.Unlock(srcSurface, nullptr);
+		return true;
+	}
+
+	template <typename TSurface>
+	bool SurfaceImpl<TSurface>::softwareFill(TSurface* This, const RECT* dstRect, DWORD flags,
+		const DDBLTFX* bltFx)
+	{
+		const DWORD fillFlags = flags & (DDBLT_COLORFILL | DDBLT_ROP);
+		if (!isSoftwareBlitterEnabled() || !bltFx || (DDBLT_COLORFILL != fillFlags && DDBLT_ROP != fillFlags) ||
+			0 != (flags & ~(fillFlags | DDBLT_ASYNC | DDBLT_DONOTWAIT | DDBLT_WAIT)))
+		{
+			return false;
+		}
+
+		// Only the raster operations that ignore the source are handled here
+		const DWORD rop = (flags & DDBLT_ROP) ? bltFx->dwROP : 0;
+		if ((flags & DDBLT_ROP) && BLACKNESS != rop && WHITENESS != rop && DSTINVERT != rop)
+		{
+			return false;
+		}
+
+		const DDSURFACEDESC2 dstDesc = getDesc(This);
+		RECT fillRect = {};
+		if (!(dstDesc.ddsCaps.dwCaps & DDSCAPS_SYSTEMMEMORY) ||
+			!Blitter::isSupported(dstDesc.ddpfPixelFormat, dstDesc.ddpfPixelFormat) ||
+			!getBltRect(dstRect, dstDesc, fillRect))
+		{
+			return false;
+		}
+
+		// Clippers without a window have a fixed clip list in surface coordinates, which is filled rect by rect
+		std::vector<unsigned char> clipListBuffer;
+		CompatPtr<IDirectDrawClipper> clipper;
+		if (SUCCEEDED(s_origVtable.GetClipper(This, &clipper.getRef())))
+		{
+			HWND hwnd = nullptr;
+			DWORD clipListSize = 0;
+			if (FAILED(clipper->GetHWnd(clipper, &hwnd)) || hwnd ||
+				FAILED(clipper->GetClipList(clipper, &fillRect, nullptr, &clipListSize)))
+			{
+				return false;
+			}
+
+			clipListBuffer.resize(clipListSize);
+			if (FAILED(clipper->GetClipList(clipper, &fillRect,
+				reinterpret_cast<RGNDATA*>(clipListBuffer.data()), &clipListSize)))
+			{
+				return false;
+			}
+		}
+
+		TSurfaceDesc dstLockDesc = {};
+		dstLockDesc.dwSize = sizeof(dstLockDesc);
+		if (FAILED(s_origVtable.Lock(This, nullptr, &dstLockDesc,
+			(DSTINVERT == rop ? 0 : DDLOCK_WRITEONLY) | DDLOCK_WAIT, nullptr)))
+		{
+			return false;
+		}
+
+		const Blitter::Image dst = {
+			dstLockDesc.lpSurface, dstLockDesc.lPitch, dstDesc.ddpfPixelFormat.dwRGBBitCount / 8 };
+		auto fill = [&](const RECT& rect)
+		{
+			switch (rop)
+			{
+			case BLACKNESS:
+				Blitter::colorFill(dst, rect, 0);
+				break;
+			case WHITENESS:
+				Blitter::colorFill(dst, rect, 0xFFFFFFFF);
+				break;
+			case DSTINVERT:
+				Blitter::invert(dst, rect);
+				break;
+			default:
+				Blitter::colorFill(dst, rect, bltFx->dwFillColor);
+				break;
+			}
+		};
+
+		if (clipListBuffer.empty())
+		{
+			fill(fillRect);
+		}
+		else
+		{
+			const RGNDATA* clipList = reinterpret_cast<const RGNDATA*>(clipListBuffer.data());
+			const RECT* clipRects = reinterpret_cast<const RECT*>(clipList->Buffer);
+			for (DWORD i = 0; i < clipList->rdh.nCount; ++i)
+			{
+				fill(clipRects[i]);
+			}
+		}
+
+		s_origVtable.Unlock(This, nullptr);
+		return true;
+	}
+
+	template <typename TSurface>
+	bool SurfaceImpl<TSurface>::softwareBlt(TSurface* This, const RECT* dstRect, TSurface* srcSurface,
+		const RECT* srcRect, DWORD flags, const DDBLTFX* bltFx)
+	{
+		const DWORD fxFlags = DDBLT_DDFX | DDBLT_KEYDESTOVERRIDE | DDBLT_KEYSRCOVERRIDE | DDBLT_ROP;
+		const DWORD supportedFlags = DDBLT_ASYNC | DDBLT_DONOTWAIT | DDBLT_WAIT |
+			DDBLT_KEYDEST | DDBLT_KEYSRC | fxFlags;
+		if (!isSoftwareBlitterEnabled() || !srcSurface || 0 != (flags & ~supportedFlags) ||
+			((flags & fxFlags) && !bltFx))
+		{
+			return false;
+		}
+
+		const DWORD ddFx = (flags & DDBLT_DDFX) ? bltFx->dwDDFX : 0;
+		if (0 != (ddFx & ~(DDBLTFX_ARITHSTRETCHY | DDBLTFX_MIRRORLEFTRIGHT | DDBLTFX_MIRRORUPDOWN | DDBLTFX_ROTATE180)))
+		{
+			return false;
+		}
+
+		const DWORD rop = (flags & DDBLT_ROP) ? bltFx->dwROP : SRCCOPY;
+		if (!Blitter::isRopSupported(rop))
+		{
+			return false;
+		}
+
+		const DDSURFACEDESC2 dstDesc = getDesc(This);
+		const DDSURFACEDESC2 srcDesc = getDesc(srcSurface);
+		if (!(dstDesc.ddsCaps.dwCaps & DDSCAPS_SYSTEMMEMORY) || !(srcDesc.ddsCaps.dwCaps & DDSCAPS_SYSTEMMEMORY) ||
+			!Blitter::isSupported(dstDesc.ddpfPixelFormat, srcDesc.ddpfPixelFormat))
+		{
+			return false;
+		}
+
+		Blitter::BltParams params = {};
+		if (!getBltRect(dstRect, dstDesc, params.dstRect) || !getBltRect(srcRect, srcDesc, params.srcRect))
+		{
+			return false;
+		}
+
+		if ((ddFx & DDBLTFX_ARITHSTRETCHY) && (dstDesc.ddpfPixelFormat.dwFlags & DDPF_RGB))
+		{
+			params.linearFilterPf = &dstDesc.ddpfPixelFormat;
+		}
+
+		// A 180 degree rotation is the same as mirroring on both axes
+		const bool isRotated180 = 0 != (ddFx & DDBLTFX_ROTATE180);
+		params.isMirroredLeftRight = (0 != (ddFx & DDBLTFX_MIRRORLEFTRIGHT)) != isRotated180;
+		params.isMirroredUpDown = (0 != (ddFx & DDBLTFX_MIRRORUPDOWN)) != isRotated180;
+		params.rop = rop;
+
+		DDCOLORKEY srcColorKey = {};
+		if (flags & DDBLT_KEYSRCOVERRIDE)
+		{
+			srcColorKey = bltFx->ddckSrcColorkey;
+			params.srcColorKey = &srcColorKey;
+		}
+		else if (flags & DDBLT_KEYSRC)
+		{
+			if (FAILED(s_origVtable.GetColorKey(srcSurface, DDCKEY_SRCBLT, &srcColorKey)))
+			{
+				return false;
+			}
+			params.srcColorKey = &srcColorKey;
+		}
+
+		DDCOLORKEY dstColorKey = {};
+		if (flags & DDBLT_KEYDESTOVERRIDE)
+		{
+			dstColorKey = bltFx->ddckDestColorkey;
+			params.dstColorKey = &dstColorKey;
+		}
+		else if (flags & DDBLT_KEYDEST)
+		{
+			if (FAILED(s_origVtable.GetColorKey(This, DDCKEY_DESTBLT, &dstColorKey)))
+			{
+				return false;
+			}
+			params.dstColorKey = &dstColorKey;
+		}
+
+		if (srcColorKey.dwColorSpaceLowValue != srcColorKey.dwColorSpaceHighValue ||
+			dstColorKey.dwColorSpaceLowValue != dstColorKey.dwColorSpaceHighValue)
+		{
+			return false;
+		}
+
+		const bool isTransformed = params.isMirroredLeftRight || params.isMirroredUpDown ||
+			params.dstRect.right - params.dstRect.left != params.srcRect.right - params.srcRect.left ||
+			params.dstRect.bottom - params.dstRect.top != params.srcRect.bottom - params.srcRect.top;
+		if (SRCCOPY != rop && (params.srcColorKey || params.dstColorKey || isTransformed))
+		{
+			return false;
+		}
+
+		// Overlapping blits within a surface are done in place by choosing the copy direction,
+		// which only works when each destination pixel depends on the source pixel at the same offset
+		// Different interfaces of the same surface have different pointers, so the private data is compared
+		Surface* const srcData = srcSurface == This ? nullptr : Surface::getSurface(*srcSurface);
+		const bool isSameSurface = srcSurface == This || (srcData && srcData == Surface::getSurface(*This));
+		RECT overlap = {};
+		if (isSameSurface && IntersectRect(&overlap, &params.dstRect, &params.srcRect) &&
+			(isTransformed || SRCCOPY != rop))
+		{
+			return false;
+		}
+
+		CompatPtr<IDirectDrawClipper> clipper;
+		if (SUCCEEDED(s_origVtable.GetClipper(This, &clipper.getRef())))
+		{
+			return false;
+		}
+
+		TSurfaceDesc srcLockDesc = {};
+		srcLockDesc.dwSize = sizeof(srcLockDesc);
+		if (!isSameSurface &&
+			FAILED(s_origVtable.Lock(srcSurface, nullptr, &srcLockDesc, DDLOCK_READONLY | DDLOCK_WAIT, nullptr)))
+		{
+			return false;
+		}
+
+		TSurfaceDesc dstLockDesc = {};
+		dstLockDesc.dwSize = sizeof(dstLockDesc);
+		if (FAILED(s_origVtable.Lock(This, nullptr, &dstLockDesc, DDLOCK_WAIT, nullptr)))
+		{
+			if (!isSameSurface)
+			{
+				s_origVtable.Unlock(srcSurface, nullptr);
+			}
+			return false;
+		}
+
+		if (isSameSurface)
+		{
+			srcLockDesc = dstLockDesc;
+		}
+
+		const DWORD bytesPerPixel = dstDesc.ddpfPixelFormat.dwRGBBitCount / 8;
+		const Blitter::Image dst = { dstLockDesc.lpSurface, dstLockDesc.lPitch, bytesPerPixel };
+		const Blitter::Image src = { srcLockDesc.lpSurface, srcLockDesc.lPitch, bytesPerPixel };
+		params.colorKeyMask = getColorKeyMask(dstDesc.ddpfPixelFormat);
+		Blitter::blt(dst, src, params);
+
+		s_origVtable.Unlock(This, nullptr);
+		if (!isSameSurface)
+		{
+			s_origVtable.Unlock(srcSurface, nullptr);
+		}
+		return true;
+	}
+
 	template <typename TSurface>
 	bool SurfaceImpl<TSurface>::prepareBltRetrySurface(TSurface*& surface, RECT*& rect,
-		const TSurfaceDesc& desc, bool isTransparentBlt, bool isCopyNeeded)
+		const DDSURFACEDESC2& desc, bool isTransparentBlt, bool isCopyNeeded)
 	{
 		TSurface* replSurface = surface;
 		RECT* replRect = rect;
@@ -107,7 +490,7 @@ namespace DDraw
 
 	template <typename TSurface>
 	void SurfaceImpl<TSurface>::replaceWithVidMemSurface(TSurface*& surface, RECT*& rect,
-		const TSurfaceDesc& desc)
+		const DDSURFACEDESC2& desc)
 	{
 		static RECT replRect = {};
 		replRect = rect ? RECT{ 0, 0, rect->right - rect->left, rect->bottom - rect->top } :
@@ -121,12 +504,7 @@ namespace DDraw
 		replDesc.ddpfPixelFormat = desc.ddpfPixelFormat;
 		replDesc.ddsCaps.dwCaps = DDSCAPS_OFFSCREENPLAIN | DDSCAPS_VIDEOMEMORY;
 
-		CompatPtr<IUnknown> ddUnk;
-		GetDDInterface(surface, reinterpret_cast<void**>(&ddUnk.getRef()));
-		CompatPtr<IDirectDraw7> dd;
-		ddUnk->QueryInterface(ddUnk, IID_IDirectDraw7, reinterpret_cast<void**>(&dd.getRef()));
-
-		DDraw::Repository::ScopedSurface replacementSurface(*dd, replDesc);
+		DDraw::Repository::ScopedSurface replacementSurface(m_data->getDdObject(), replDesc);
 		if (replacementSurface.surface)
 		{
 			surface = CompatPtr<TSurface>::from(replacementSurface.surface.get());
@@ -143,10 +521,7 @@ namespace DDraw
 		}
 		else
 		{
-			TSurfaceDesc desc = {};
-			desc.dwSize = sizeof(desc);
-			s_origVtable.GetSurfaceDesc(This, &desc);
-
+			const DDSURFACEDESC2 desc = getDesc(This);
 			for (DWORD i = 0; i < desc.dwBackBufferCount; ++i)
 			{
 				SurfaceImpl::Flip(This, nullptr, DDFLIP_WAIT);
@@ -159,12 +534,19 @@ namespace DDraw
 		TSurface* This, LPRECT lpDestRect, TSurface* lpDDSrcSurface, LPRECT lpSrcRect,
 		DWORD dwFlags, LPDDBLTFX lpDDBltFx)
 	{
+		if (softwareFill(This, lpDestRect, dwFlags, lpDDBltFx) ||
+			softwareBlt(This, lpDestRect, lpDDSrcSurface, lpSrcRect, dwFlags, lpDDBltFx))
+		{
+			return DD_OK;
+		}
+
 		HRESULT result = s_origVtable.Blt(This, lpDestRect, lpDDSrcSurface, lpSrcRect, dwFlags, lpDDBltFx);
 		if (DDERR_UNSUPPORTED == result || DDERR_GENERIC == result)
 		{
 			const bool isTransparentBlt = 0 !=
 				(dwFlags & (DDBLT_KEYDEST | DDBLT_KEYSRC | DDBLT_KEYDESTOVERRIDE | DDBLT_KEYSRCOVERRIDE));
-			if (bltRetry(This, lpDestRect, lpDDSrcSurface, lpSrcRect, isTransparentBlt,
+			const bool isSimpleCopy = 0 == (dwFlags & ~(DDBLT_ASYNC | DDBLT_DONOTWAIT | DDBLT_WAIT));
+			if (bltRetry(This, lpDestRect, lpDDSrcSurface, lpSrcRect, isTransparentBlt, isSimpleCopy,
 				[&]() { return s_origVtable.Blt(
 					This, lpDestRect, lpDDSrcSurface, lpSrcRect, dwFlags, lpDDBltFx); }))
 			{
@@ -178,28 +560,25 @@ namespace DDraw
 	HRESULT SurfaceImpl<TSurface>::BltFast(
 		TSurface* This, DWORD dwX, DWORD dwY, TSurface* lpDDSrcSurface, LPRECT lpSrcRect, DWORD dwTrans)
 	{
-		HRESULT result = s_origVtable.BltFast(This, dwX, dwY, lpDDSrcSurface, lpSrcRect, dwTrans);
-		if (DDERR_UNSUPPORTED == result || DDERR_GENERIC == result)
+		if (isSoftwareBlitterEnabled() && 0 == (dwTrans & ~(DDBLTFAST_WAIT | DDBLTFAST_SRCCOLORKEY | DDBLTFAST_DESTCOLORKEY)))
 		{
-			RECT dstRect = { static_cast<LONG>(dwX), static_cast<LONG>(dwY) };
-			if (lpSrcRect)
+			const RECT dstRect = getBltFastDstRect(dwX, dwY, lpDDSrcSurface, lpSrcRect);
+			const DWORD flags = ((dwTrans & DDBLTFAST_SRCCOLORKEY) ? DDBLT_KEYSRC : 0) |
+				((dwTrans & DDBLTFAST_DESTCOLORKEY) ? DDBLT_KEYDEST : 0);
+			if (softwareBlt(This, &dstRect, lpDDSrcSurface, lpSrcRect, flags, nullptr))
 			{
-				dstRect.right = dwX + lpSrcRect->right - lpSrcRect->left;
-				dstRect.bottom = dwY + lpSrcRect->bottom - lpSrcRect->top;
-			}
-			else
-			{
-				TSurfaceDesc desc = {};
-				desc.dwSize = sizeof(desc);
-				s_origVtable.GetSurfaceDesc(lpDDSrcSurface, &desc);
-
-				dstRect.right = dwX + desc.dwWidth;
-				dstRect.bottom = dwY + desc.dwHeight;
+				return DD_OK;
 			}
+		}
 
+		HRESULT result = s_origVtable.BltFast(This, dwX, dwY, lpDDSrcSurface, lpSrcRect, dwTrans);
+		if (DDERR_UNSUPPORTED == result || DDERR_GENERIC == result)
+		{
+			RECT dstRect = getBltFastDstRect(dwX, dwY, lpDDSrcSurface, lpSrcRect);
 			RECT* dstRectPtr = &dstRect;
 			const bool isTransparentBlt = 0 != (dwTrans & (DDBLTFAST_DESTCOLORKEY | DDBLTFAST_SRCCOLORKEY));
-			if (bltRetry(This, dstRectPtr, lpDDSrcSurface, lpSrcRect, isTransparentBlt,
+			const bool isSimpleCopy = 0 == (dwTrans & ~DDBLTFAST_WAIT);
+			if (bltRetry(This, dstRectPtr, lpDDSrcSurface, lpSrcRect, isTransparentBlt, isSimpleCopy,
 				[&]() { return s_origVtable.BltFast(
 					This, dstRectPtr->left, dstRectPtr->top, lpDDSrcSurface, lpSrcRect, dwTrans); }))
 			{
@@ -275,7 +654,9 @@ namespace DDraw
 	template <typename TSurface>
 	HRESULT SurfaceImpl<TSurface>::Restore(TSurface* This)
 	{
-		return s_origVtable.Restore(This);
+		return SurfaceDescCache<DDSURFACEDESC2>::updateAfter(
+			[=]() { return s_origVtable.Restore(This); },
+			[=]() { updateDesc(This); });
 	}
 
 	template <typename TSurface>
@@ -284,6 +665,26 @@ namespace DDraw
 		return s_origVtable.SetPalette(This, lpDDPalette);
 	}
 
+	template <typename TSurface>
+	HRESULT SurfaceImpl<TSurface>::SetSurfaceDesc(TSurface* This, TSurfaceDesc* lpddsd, DWORD dwFlags)
+	{
+		return SurfaceDescCache<DDSURFACEDESC2>::updateAfter(
+			[=]() { return s_origVtable.SetSurfaceDesc(This, lpddsd, dwFlags); },
+			[=]() { updateDesc(This); });
+	}
+
+	template <>
+	HRESULT SurfaceImpl<IDirectDrawSurface>::SetSurfaceDesc(IDirectDrawSurface*, DDSURFACEDESC*, DWORD)
+	{
+		return DDERR_UNSUPPORTED;
+	}
+
+	template <>
+	HRESULT SurfaceImpl<IDirectDrawSurface2>::SetSurfaceDesc(IDirectDrawSurface2*, DDSURFACEDESC*, DWORD)
+	{
+		return DDERR_UNSUPPORTED;
+	}
+
 	template <typename TSurface>
 	HRESULT SurfaceImpl<TSurface>::Unlock(TSurface* This, TUnlockParam lpRect)
 	{
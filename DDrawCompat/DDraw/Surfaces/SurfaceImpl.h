@@ -50,6 +50,7 @@ namespace DDraw
 		virtual HRESULT ReleaseDC(TSurface* This, HDC hDC);
 		virtual HRESULT Restore(TSurface* This);
 		virtual HRESULT SetPalette(TSurface* This, LPDIRECTDRAWPALETTE lpDDPalette);
+		virtual HRESULT SetSurfaceDesc(TSurface* This, TSurfaceDesc* lpddsd, DWORD dwFlags);
 		virtual HRESULT Unlock(TSurface* This, TUnlockParam lpRect);
 
 	protected:
@@ -59,10 +60,15 @@ namespace DDraw
 
 	private:
 		bool bltRetry(TSurface*& dstSurface, RECT*& dstRect,
-			TSurface*& srcSurface, RECT*& srcRect, bool isTransparentBlt,
+			TSurface*& srcSurface, RECT*& srcRect, bool isTransparentBlt, bool isSimpleCopy,
 			const std::function<HRESULT()>& blt);
+		bool convertFourCcBlt(TSurface* dstSurface, const RECT* dstRect, const DDSURFACEDESC2& dstDesc,
+			TSurface* srcSurface, const RECT* srcRect, const DDSURFACEDESC2& srcDesc);
+		bool softwareFill(TSurface* This, const RECT* dstRect, DWORD flags, const DDBLTFX* bltFx);
+		bool softwareBlt(TSurface* This, const RECT* dstRect, TSurface* srcSurface, const RECT* srcRect,
+			DWORD flags, const DDBLTFX* bltFx);
 		bool prepareBltRetrySurface(TSurface*& surface, RECT*& rect,
-			const TSurfaceDesc& desc, bool isTransparentBlt, bool isCopyNeeded);
-		void replaceWithVidMemSurface(TSurface*& surface, RECT*& rect, const TSurfaceDesc& desc);
+			const DDSURFACEDESC2& desc, bool isTransparentBlt, bool isCopyNeeded);
+		void replaceWithVidMemSurface(TSurface*& surface, RECT*& rect, const DDSURFACEDESC2& desc);
 	};
 }
@@ -6,7 +6,9 @@
 
 #include "Common/CompatPtr.h"
 #include "Common/CompatRef.h"
+#include "Common/DeferredInstallation.h"
 #include "Common/Log.h"
+#include "Common/PhaseTimer.h"
 #include "DDraw/Repository.h"
 #include "Direct3d/Direct3d.h"
 #include "Direct3d/Direct3dDevice.h"
@@ -187,25 +189,64 @@ namespace
 	}
 }
 
-namespace Direct3d
+namespace
 {
-	void installHooks()
+	class HookInstaller : public Compat::DeferredInstallation::Installer
 	{
-		auto dd7(DDraw::Repository::getDirectDraw());
-		CompatPtr<IDirectDraw> dd;
-		CALL_ORIG_PROC(DirectDrawCreate, nullptr, &dd.getRef(), nullptr);
-		if (!dd || !dd7 || FAILED(dd->SetCooperativeLevel(dd, nullptr, DDSCL_NORMAL)))
+	public:
+		virtual bool install() override
 		{
-			Compat::Log() << "Failed to hook Direct3d interfaces";
-			return;
-		}
+			Compat::ScopedPhase phase("Direct3d::installHooks");
+			Compat::Log() << "Installing Direct3D hooks";
+
+			auto dd7(DDraw::Repository::getDirectDraw());
+			CompatPtr<IDirectDraw> dd;
+			CALL_ORIG_PROC(DirectDrawCreate, nullptr, &dd.getRef(), nullptr);
+			if (!dd || !dd7 || FAILED(dd->SetCooperativeLevel(dd, nullptr, DDSCL_NORMAL)))
+			{
+				Compat::Log() << "Failed to hook Direct3d interfaces";
+				return false;
+			}
+
+			CompatPtr<IDirectDrawSurface7> renderTarget7(createRenderTarget(*dd7));
+			if (!renderTarget7)
+			{
+				return false;
+			}
 
-		CompatPtr<IDirectDrawSurface7> renderTarget7(createRenderTarget(*dd7));
-		if (renderTarget7)
-		{
 			CompatPtr<IDirectDrawSurface4> renderTarget4(renderTarget7);
 			hookDirect3d(*dd, *renderTarget4);
 			hookDirect3d7(*dd7);
+			return true;
 		}
+	};
+
+	HookInstaller g_hookInstaller;
+	Compat::DeferredInstallation g_hookInstallation(g_hookInstaller);
+}
+
+namespace Direct3d
+{
+	// Patching the vtables is safe without suspending other threads, because an application can only obtain
+	// Direct3D interfaces from DirectDraw objects and surfaces through their hooked QueryInterface, or from
+	// other Direct3D interfaces. The query that triggers the installation returns only after the hooks are
+	// installed, and so does any concurrent query from another thread, so no application thread can call into
+	// a Direct3D vtable while it is being patched. The queries made by the installer on its own objects are
+	// reentrant and return immediately.
+	void installHooks()
+	{
+		g_hookInstallation.run();
+	}
+
+	bool isDirect3dIid(REFIID riid)
+	{
+		// DirectX 3 era devices and textures are queried directly from surfaces, without IDirect3D
+		return IID_IDirect3D == riid || IID_IDirect3D2 == riid ||
+			IID_IDirect3D3 == riid || IID_IDirect3D7 == riid ||
+			IID_IDirect3DRGBDevice == riid || IID_IDirect3DHALDevice == riid ||
+			IID_IDirect3DMMXDevice == riid || IID_IDirect3DRampDevice == riid ||
+			IID_IDirect3DRefDevice == riid || IID_IDirect3DNullDevice == riid ||
+			IID_IDirect3DTnLHalDevice == riid ||
+			IID_IDirect3DTexture == riid || IID_IDirect3DTexture2 == riid;
 	}
 }
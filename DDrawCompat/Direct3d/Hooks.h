@@ -1,6 +1,11 @@
 #pragma once
 
+#include <Windows.h>
+
 namespace Direct3d
 {
+	// Installed on demand when the application first queries a Direct3D interface, either an IDirect3D
+	// interface from a DirectDraw object or a device or texture interface from a surface
 	void installHooks();
+	bool isDirect3dIid(REFIID riid);
 }
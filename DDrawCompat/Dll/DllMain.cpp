@@ -6,13 +6,15 @@
 #include <timeapi.h>
 #include <Uxtheme.h>
 
+#include "Common/CallStats.h"
 #include "Common/Hook.h"
 #include "Common/Log.h"
+#include "Common/PhaseTimer.h"
+#include "Common/ProfiledLock.h"
 #include "Common/Time.h"
 #include "D3dDdi/Hooks.h"
 #include "DDraw/DirectDraw.h"
 #include "DDraw/Hooks.h"
-#include "Direct3d/Hooks.h"
 #include "Dll/Procs.h"
 #include "Gdi/Gdi.h"
 #include "Win32/DisplayMode.h"
@@ -34,19 +36,36 @@ namespace
 		static bool isAlreadyInstalled = false;
 		if (!isAlreadyInstalled)
 		{
-			Win32::DisplayMode::disableDwm8And16BitMitigation();
-			Compat::Log() << "Installing registry hooks";
-			Win32::Registry::installHooks();
-			Compat::Log() << "Installing Direct3D driver hooks";
-			D3dDdi::installHooks();
-			Compat::Log() << "Installing DirectDraw hooks";
-			DDraw::installHooks();
-			Compat::Log() << "Installing Direct3D hooks";
-			Direct3d::installHooks();
-			Compat::Log() << "Installing GDI hooks";
-			Gdi::installHooks();
-			Compat::Log() << "Installing display mode hooks";
-			Win32::DisplayMode::installHooks(g_origDDrawModule);
+			Compat::ScopedPhase phase("installHooks");
+			{
+				Compat::ScopedPhase dwmPhase("disableDwm8And16BitMitigation");
+				Win32::DisplayMode::disableDwm8And16BitMitigation();
+			}
+			{
+				Compat::ScopedPhase registryPhase("Registry");
+				Compat::Log() << "Installing registry hooks";
+				Win32::Registry::installHooks();
+			}
+			{
+				Compat::ScopedPhase d3dDdiPhase("D3dDdi");
+				Compat::Log() << "Installing Direct3D driver hooks";
+				D3dDdi::installHooks();
+			}
+			{
+				Compat::ScopedPhase ddrawPhase("DDraw");
+				Compat::Log() << "Installing DirectDraw hooks";
+				DDraw::installHooks();
+			}
+			{
+				Compat::ScopedPhase gdiPhase("Gdi");
+				Compat::Log() << "Installing GDI hooks";
+				Gdi::installHooks();
+			}
+			{
+				Compat::ScopedPhase displayModePhase("DisplayMode");
+				Compat::Log() << "Installing display mode hooks";
+				Win32::DisplayMode::installHooks(g_origDDrawModule);
+			}
 			Compat::Log() << "Finished installing hooks";
 			isAlreadyInstalled = true;
 		}
@@ -86,11 +105,15 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID /*lpvReserved*/)
 {
 	if (fdwReason == DLL_PROCESS_ATTACH)
 	{
+		Time::init();
+		Compat::ScopedPhase phase("DllMain");
+
 		char currentProcessPath[MAX_PATH] = {};
 		GetModuleFileName(nullptr, currentProcessPath, MAX_PATH);
 		Compat::Log() << "Process path: " << currentProcessPath;
 
 		printEnvironmentVariable("__COMPAT_LAYER");
+		printEnvironmentVariable("DDRAWCOMPAT_SOFTWARE_BLITTER");
 
 		char currentDllPath[MAX_PATH] = {};
 		GetModuleFileName(hinstDLL, currentDllPath, MAX_PATH);
@@ -106,28 +129,35 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID /*lpvReserved*/)
 			return FALSE;
 		}
 
-		if (!loadLibrary(systemDirectory, "ddraw.dll", g_origDDrawModule) ||
-			!loadLibrary(systemDirectory, "dinput.dll", g_origDInputModule))
 		{
-			return FALSE;
+			Compat::ScopedPhase loadPhase("loadSystemDlls");
+			if (!loadLibrary(systemDirectory, "ddraw.dll", g_origDDrawModule) ||
+				!loadLibrary(systemDirectory, "dinput.dll", g_origDInputModule))
+			{
+				return FALSE;
+			}
+
+			VISIT_ALL_PROCS(LOAD_ORIGINAL_PROC);
+			Dll::g_origProcs.DirectInputCreateA = GetProcAddress(g_origDInputModule, "DirectInputCreateA");
 		}
 
-		VISIT_ALL_PROCS(LOAD_ORIGINAL_PROC);
-		Dll::g_origProcs.DirectInputCreateA = GetProcAddress(g_origDInputModule, "DirectInputCreateA");
-
 		const BOOL disablePriorityBoost = TRUE;
 		SetProcessPriorityBoost(GetCurrentProcess(), disablePriorityBoost);
 		SetProcessAffinityMask(GetCurrentProcess(), 1);
 		timeBeginPeriod(1);
 		SetThemeAppProperties(0);
 
-		Compat::redirectIatHooks("ddraw.dll", "DirectDrawCreate",
-			Compat::getProcAddress(hinstDLL, "DirectDrawCreate"));
-		Compat::redirectIatHooks("ddraw.dll", "DirectDrawCreateEx",
-			Compat::getProcAddress(hinstDLL, "DirectDrawCreateEx"));
+		{
+			Compat::ScopedPhase iatPhase("redirectIatHooks");
+			Compat::redirectIatHooks({
+				{ "ddraw.dll", "DirectDrawCreate", Compat::getProcAddress(hinstDLL, "DirectDrawCreate") },
+				{ "ddraw.dll", "DirectDrawCreateEx", Compat::getProcAddress(hinstDLL, "DirectDrawCreateEx") } });
+		}
 		Win32::FontSmoothing::g_origSystemSettings = Win32::FontSmoothing::getSystemSettings();
-		Win32::MsgHooks::installHooks();
-		Time::init();
+		{
+			Compat::ScopedPhase msgHooksPhase("MsgHooks");
+			Win32::MsgHooks::installHooks();
+		}
 
 		const DWORD disableMaxWindowedMode = 12;
 		CALL_ORIG_PROC(SetAppCompatData, disableMaxWindowedMode, 0);
@@ -137,6 +167,8 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID /*lpvReserved*/)
 	else if (fdwReason == DLL_PROCESS_DETACH)
 	{
 		Compat::Log() << "Detaching DDrawCompat";
+		Compat::LockProfile::logReport();
+		Compat::LockProfile::writeChromeTrace("ddraw.locks.json");
 		DDraw::uninstallHooks();
 		D3dDdi::uninstallHooks();
 		Gdi::uninstallHooks();
@@ -145,7 +177,12 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID /*lpvReserved*/)
 		FreeLibrary(g_origDDrawModule);
 		Win32::FontSmoothing::setSystemSettingsForced(Win32::FontSmoothing::g_origSystemSettings);
 		timeEndPeriod(1);
+		for (const auto& line : Compat::CallStats::getReport())
+		{
+			Compat::Log() << line;
+		}
 		Compat::Log() << "DDrawCompat detached successfully";
+		Compat::Log::stopWriterThread();
 	}
 
 	return TRUE;
@@ -1,15 +1,19 @@
-#include <algorithm>
 #include <unordered_map>
 
 #include "Common/Hook.h"
 #include "Common/Log.h"
 #include "Common/ScopedCriticalSection.h"
 #include "Gdi/Dc.h"
+#include "Gdi/DcAttributes.h"
 #include "Gdi/DcCache.h"
+#include "Gdi/DcClassificationCache.h"
+#include "Gdi/DcReverseMap.h"
+#include "Gdi/DirtyRect.h"
 #include "Gdi/Gdi.h"
 
 namespace
 {
+	using Gdi::DcAttributes;
 	using Gdi::DcCache::CachedDc;
 
 	struct CompatDc : CachedDc
@@ -18,84 +22,225 @@ namespace
 		DWORD refCount;
 		HDC origDc;
 		int savedState;
+		bool isReadOnly;
+	};
+
+	class SrwLockPolicy
+	{
+	public:
+		SrwLockPolicy() { InitializeSRWLock(&m_srwLock); }
+
+		void lock() { AcquireSRWLockExclusive(&m_srwLock); }
+		void unlock() { ReleaseSRWLockExclusive(&m_srwLock); }
+		void lockShared() { AcquireSRWLockShared(&m_srwLock); }
+		void unlockShared() { ReleaseSRWLockShared(&m_srwLock); }
+
+	private:
+		SRWLOCK m_srwLock;
 	};
 
 	typedef std::unordered_map<HDC, CompatDc> CompatDcMap;
 	CompatDcMap g_origDcToCompatDc;
+	// Has its own lock, because getOrigDc is called from hooked functions like WindowFromDC, which may run while
+	// another thread holds the GDI lock and waits for the DD thread lock
+	Gdi::DcReverseMap<HDC, SrwLockPolicy> g_compatDcToOrigDc;
+
+	// Cached DCs are always restored to their initial state before reuse, so only the attributes
+	// of the original DC that differ from this initial state need to be applied
+	DcAttributes g_defaultDcAttributes = {};
+	bool g_isDefaultDcAttributesInitialized = false;
+
+	// Reused by setClippingRegion, which only runs while holding the GDI lock
+	HRGN g_sysRgn = nullptr;
+	HRGN g_clipRgn = nullptr;
+
+	DcAttributes getDcAttributes(HDC dc)
+	{
+		DcAttributes attr = {};
+		attr.font = GetCurrentObject(dc, OBJ_FONT);
+		attr.brush = GetCurrentObject(dc, OBJ_BRUSH);
+		attr.pen = GetCurrentObject(dc, OBJ_PEN);
+
+		attr.graphicsMode = GetGraphicsMode(dc);
+		if (GM_ADVANCED == attr.graphicsMode)
+		{
+			GetWorldTransform(dc, &attr.worldTransform);
+		}
+
+		attr.mapMode = GetMapMode(dc);
+		GetViewportOrgEx(dc, &attr.viewportOrg);
+		GetViewportExtEx(dc, &attr.viewportExt);
+		GetWindowOrgEx(dc, &attr.windowOrg);
+		GetWindowExtEx(dc, &attr.windowExt);
+
+		attr.arcDirection = GetArcDirection(dc);
+		attr.bkColor = GetBkColor(dc);
+		attr.bkMode = GetBkMode(dc);
+		attr.dcBrushColor = GetDCBrushColor(dc);
+		attr.dcPenColor = GetDCPenColor(dc);
+		attr.layout = GetLayout(dc);
+		attr.polyFillMode = GetPolyFillMode(dc);
+		attr.rop2 = GetROP2(dc);
+		attr.stretchBltMode = GetStretchBltMode(dc);
+		attr.textAlign = GetTextAlign(dc);
+		attr.textCharacterExtra = GetTextCharacterExtra(dc);
+		attr.textColor = GetTextColor(dc);
+
+		GetBrushOrgEx(dc, &attr.brushOrg);
+		GetCurrentPositionEx(dc, &attr.currentPos);
+		return attr;
+	}
 
 	void copyDcAttributes(CompatDc& compatDc, HDC origDc, POINT& origin)
 	{
-		SelectObject(compatDc.dc, GetCurrentObject(origDc, OBJ_FONT));
-		SelectObject(compatDc.dc, GetCurrentObject(origDc, OBJ_BRUSH));
-		SelectObject(compatDc.dc, GetCurrentObject(origDc, OBJ_PEN));
-
-		if (GM_ADVANCED == GetGraphicsMode(origDc))
-		{
-			SetGraphicsMode(compatDc.dc, GM_ADVANCED);
-			XFORM transform = {};
-			GetWorldTransform(origDc, &transform);
-			SetWorldTransform(compatDc.dc, &transform);
-		}
-
-		SetMapMode(compatDc.dc, GetMapMode(origDc));
-
-		POINT viewportOrg = {};
-		GetViewportOrgEx(origDc, &viewportOrg);
-		SetViewportOrgEx(compatDc.dc, viewportOrg.x + origin.x, viewportOrg.y + origin.y, nullptr);
-		SIZE viewportExt = {};
-		GetViewportExtEx(origDc, &viewportExt);
-		SetViewportExtEx(compatDc.dc, viewportExt.cx, viewportExt.cy, nullptr);
-
-		POINT windowOrg = {};
-		GetWindowOrgEx(origDc, &windowOrg);
-		SetWindowOrgEx(compatDc.dc, windowOrg.x, windowOrg.y, nullptr);
-		SIZE windowExt = {};
-		GetWindowExtEx(origDc, &windowExt);
-		SetWindowExtEx(compatDc.dc, windowExt.cx, windowExt.cy, nullptr);
-
-		SetArcDirection(compatDc.dc, GetArcDirection(origDc));
-		SetBkColor(compatDc.dc, GetBkColor(origDc));
-		SetBkMode(compatDc.dc, GetBkMode(origDc));
-		SetDCBrushColor(compatDc.dc, GetDCBrushColor(origDc));
-		SetDCPenColor(compatDc.dc, GetDCPenColor(origDc));
-		SetLayout(compatDc.dc, GetLayout(origDc));
-		SetPolyFillMode(compatDc.dc, GetPolyFillMode(origDc));
-		SetROP2(compatDc.dc, GetROP2(origDc));
-		SetStretchBltMode(compatDc.dc, GetStretchBltMode(origDc));
-		SetTextAlign(compatDc.dc, GetTextAlign(origDc));
-		SetTextCharacterExtra(compatDc.dc, GetTextCharacterExtra(origDc));
-		SetTextColor(compatDc.dc, GetTextColor(origDc));
-
-		POINT brushOrg = {};
-		GetBrushOrgEx(origDc, &brushOrg);
-		SetBrushOrgEx(compatDc.dc, brushOrg.x, brushOrg.y, nullptr);
-
-		POINT currentPos = {};
-		GetCurrentPositionEx(origDc, &currentPos);
-		MoveToEx(compatDc.dc, currentPos.x, currentPos.y, nullptr);
+		if (!g_isDefaultDcAttributesInitialized)
+		{
+			g_defaultDcAttributes = getDcAttributes(compatDc.dc);
+			g_isDefaultDcAttributesInitialized = true;
+		}
+
+		DcAttributes attr = getDcAttributes(origDc);
+		attr.viewportOrg.x += origin.x;
+		attr.viewportOrg.y += origin.y;
+
+		const HDC dc = compatDc.dc;
+		const unsigned int changes = Gdi::getChangedDcAttributes(attr, g_defaultDcAttributes);
+		if (changes & Gdi::DCA_FONT)
+		{
+			SelectObject(dc, attr.font);
+		}
+		if (changes & Gdi::DCA_BRUSH)
+		{
+			SelectObject(dc, attr.brush);
+		}
+		if (changes & Gdi::DCA_PEN)
+		{
+			SelectObject(dc, attr.pen);
+		}
+
+		if (changes & Gdi::DCA_WORLDTRANSFORM)
+		{
+			SetGraphicsMode(dc, GM_ADVANCED);
+			SetWorldTransform(dc, &attr.worldTransform);
+		}
+
+		if (changes & Gdi::DCA_MAPMODE)
+		{
+			SetMapMode(dc, attr.mapMode);
+		}
+		if (changes & Gdi::DCA_VIEWPORTORG)
+		{
+			SetViewportOrgEx(dc, attr.viewportOrg.x, attr.viewportOrg.y, nullptr);
+		}
+		if (changes & Gdi::DCA_VIEWPORTEXT)
+		{
+			SetViewportExtEx(dc, attr.viewportExt.cx, attr.viewportExt.cy, nullptr);
+		}
+		if (changes & Gdi::DCA_WINDOWORG)
+		{
+			SetWindowOrgEx(dc, attr.windowOrg.x, attr.windowOrg.y, nullptr);
+		}
+		if (changes & Gdi::DCA_WINDOWEXT)
+		{
+			SetWindowExtEx(dc, attr.windowExt.cx, attr.windowExt.cy, nullptr);
+		}
+
+		if (changes & Gdi::DCA_ARCDIRECTION)
+		{
+			SetArcDirection(dc, attr.arcDirection);
+		}
+		if (changes & Gdi::DCA_BKCOLOR)
+		{
+			SetBkColor(dc, attr.bkColor);
+		}
+		if (changes & Gdi::DCA_BKMODE)
+		{
+			SetBkMode(dc, attr.bkMode);
+		}
+		if (changes & Gdi::DCA_DCBRUSHCOLOR)
+		{
+			SetDCBrushColor(dc, attr.dcBrushColor);
+		}
+		if (changes & Gdi::DCA_DCPENCOLOR)
+		{
+			SetDCPenColor(dc, attr.dcPenColor);
+		}
+		if (changes & Gdi::DCA_LAYOUT)
+		{
+			SetLayout(dc, attr.layout);
+		}
+		if (changes & Gdi::DCA_POLYFILLMODE)
+		{
+			SetPolyFillMode(dc, attr.polyFillMode);
+		}
+		if (changes & Gdi::DCA_ROP2)
+		{
+			SetROP2(dc, attr.rop2);
+		}
+		if (changes & Gdi::DCA_STRETCHBLTMODE)
+		{
+			SetStretchBltMode(dc, attr.stretchBltMode);
+		}
+		if (changes & Gdi::DCA_TEXTALIGN)
+		{
+			SetTextAlign(dc, attr.textAlign);
+		}
+		if (changes & Gdi::DCA_TEXTCHARACTEREXTRA)
+		{
+			SetTextCharacterExtra(dc, attr.textCharacterExtra);
+		}
+		if (changes & Gdi::DCA_TEXTCOLOR)
+		{
+			SetTextColor(dc, attr.textColor);
+		}
+
+		if (changes & Gdi::DCA_BRUSHORG)
+		{
+			SetBrushOrgEx(dc, attr.brushOrg.x, attr.brushOrg.y, nullptr);
+		}
+		if (changes & Gdi::DCA_CURRENTPOS)
+		{
+			MoveToEx(dc, attr.currentPos.x, attr.currentPos.y, nullptr);
+		}
+	}
+
+	void addDirtyRect(HDC dc)
+	{
+		RECT bounds = {};
+		const UINT result = GetBoundsRect(dc, &bounds, DCB_RESET);
+		Gdi::addDirtyRect(Gdi::DirtyRect::getBoundsRect(result, bounds, GM_ADVANCED == GetGraphicsMode(dc),
+			[=](RECT& rect) { LPtoDP(dc, reinterpret_cast<POINT*>(&rect), 2); }));
 	}
 
+	bool classifyDc(HDC dc)
+	{
+		return dc && OBJ_DC == GetObjectType(dc) && DT_RASDISPLAY == GetDeviceCaps(dc, TECHNOLOGY);
+	}
+
+	thread_local Gdi::DcClassificationCache<HDC> g_displayDcClassifications(&classifyDc);
+
 	void setClippingRegion(HDC compatDc, HDC origDc, HWND hwnd, const POINT& origin)
 	{
+		if (!g_sysRgn)
+		{
+			g_sysRgn = CreateRectRgn(0, 0, 0, 0);
+			g_clipRgn = CreateRectRgn(0, 0, 0, 0);
+		}
+
 		if (hwnd)
 		{
-			HRGN sysRgn = CreateRectRgn(0, 0, 0, 0);
-			if (1 == GetRandomRgn(origDc, sysRgn, SYSRGN))
+			if (1 == GetRandomRgn(origDc, g_sysRgn, SYSRGN))
 			{
-				SelectClipRgn(compatDc, sysRgn);
+				SelectClipRgn(compatDc, g_sysRgn);
 				SetMetaRgn(compatDc);
 			}
-			DeleteObject(sysRgn);
 		}
 
-		HRGN clipRgn = CreateRectRgn(0, 0, 0, 0);
-		if (1 == GetClipRgn(origDc, clipRgn))
+		if (1 == GetClipRgn(origDc, g_clipRgn))
 		{
-			OffsetRgn(clipRgn, origin.x, origin.y);
-			SelectClipRgn(compatDc, clipRgn);
+			OffsetRgn(g_clipRgn, origin.x, origin.y);
+			SelectClipRgn(compatDc, g_clipRgn);
 		}
-		DeleteObject(clipRgn);
-
 	}
 }
 
@@ -103,19 +248,30 @@ namespace Gdi
 {
 	namespace Dc
 	{
-		HDC getDc(HDC origDc)
+		DisplayDcCacheScope::DisplayDcCacheScope()
+		{
+			g_displayDcClassifications.beginScope();
+		}
+
+		DisplayDcCacheScope::~DisplayDcCacheScope()
 		{
-			if (!origDc || OBJ_DC != GetObjectType(origDc) || DT_RASDISPLAY != GetDeviceCaps(origDc, TECHNOLOGY))
+			g_displayDcClassifications.endScope();
+		}
+
+		HDC getDc(HDC origDc, bool isReadOnly)
+		{
+			if (!isDisplayDc(origDc))
 			{
 				return nullptr;
 			}
 
-			Compat::ScopedCriticalSection gdiLock(Gdi::g_gdiCriticalSection);
+			Compat::ScopedProfiledCriticalSection gdiLock(Gdi::g_gdiLock, __FUNCTION__);
 
 			auto it = g_origDcToCompatDc.find(origDc);
 			if (it != g_origDcToCompatDc.end())
 			{
 				++it->second.refCount;
+				it->second.isReadOnly = it->second.isReadOnly && isReadOnly;
 				return it->second.dc;
 			}
 
@@ -129,26 +285,32 @@ namespace Gdi
 			GetDCOrgEx(origDc, &origin);
 
 			compatDc.savedState = SaveDC(compatDc.dc);
+			SetBoundsRect(compatDc.dc, nullptr, DCB_ENABLE | DCB_RESET);
 			copyDcAttributes(compatDc, origDc, origin);
 			setClippingRegion(compatDc.dc, origDc, CALL_ORIG_FUNC(WindowFromDC)(origDc), origin);
 
 			compatDc.refCount = 1;
 			compatDc.origDc = origDc;
+			compatDc.isReadOnly = isReadOnly;
 			g_origDcToCompatDc.insert(CompatDcMap::value_type(origDc, compatDc));
+			g_compatDcToOrigDc.add(compatDc.dc, origDc);
 
 			return compatDc.dc;
 		}
 
 		HDC getOrigDc(HDC dc)
 		{
-			const auto it = std::find_if(g_origDcToCompatDc.begin(), g_origDcToCompatDc.end(),
-				[dc](const CompatDcMap::value_type& compatDc) { return compatDc.second.dc == dc; });
-			return it != g_origDcToCompatDc.end() ? it->first : dc;
+			return g_compatDcToOrigDc.getOrigDc(dc);
+		}
+
+		bool isDisplayDc(HDC dc)
+		{
+			return g_displayDcClassifications.classify(dc);
 		}
 
 		void releaseDc(HDC origDc)
 		{
-			Compat::ScopedCriticalSection gdiLock(Gdi::g_gdiCriticalSection);
+			Compat::ScopedProfiledCriticalSection gdiLock(Gdi::g_gdiLock, __FUNCTION__);
 
 			auto it = g_origDcToCompatDc.find(origDc);
 			if (it == g_origDcToCompatDc.end())
@@ -160,8 +322,14 @@ namespace Gdi
 			--compatDc.refCount;
 			if (0 == compatDc.refCount)
 			{
+				if (!compatDc.isReadOnly)
+				{
+					addDirtyRect(compatDc.dc);
+				}
+				SetBoundsRect(compatDc.dc, nullptr, DCB_DISABLE);
 				RestoreDC(compatDc.dc, compatDc.savedState);
 				Gdi::DcCache::releaseDc(compatDc);
+				g_compatDcToOrigDc.remove(compatDc.dc);
 				g_origDcToCompatDc.erase(origDc);
 			}
 		}
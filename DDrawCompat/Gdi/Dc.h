@@ -8,8 +8,19 @@ namespace Gdi
 {
 	namespace Dc
 	{
-		HDC getDc(HDC origDc);
+		// Memoizes isDisplayDc results on the current thread until the outermost scope ends.
+		// DC handles can be reused after being released, so the results are not kept between scopes.
+		class DisplayDcCacheScope
+		{
+		public:
+			DisplayDcCacheScope();
+			~DisplayDcCacheScope();
+		};
+
+		// Output to DCs acquired only for reading is not added to the dirty rect
+		HDC getDc(HDC origDc, bool isReadOnly = false);
 		HDC getOrigDc(HDC dc);
+		bool isDisplayDc(HDC dc);
 		void releaseDc(HDC origDc);
 	}
 }
@@ -0,0 +1,120 @@
+#include <cstring>
+
+#include "Gdi/DcAttributes.h"
+
+namespace
+{
+	template <typename T>
+	bool isChanged(const T& value, const T& defaultValue)
+	{
+		return 0 != std::memcmp(&value, &defaultValue, sizeof(T));
+	}
+}
+
+namespace Gdi
+{
+	unsigned int getChangedDcAttributes(const DcAttributes& attr, const DcAttributes& defaultAttr)
+	{
+		const DcAttributes& def = defaultAttr;
+		unsigned int changes = 0;
+
+		if (attr.font != def.font)
+		{
+			changes |= DCA_FONT;
+		}
+		if (attr.brush != def.brush)
+		{
+			changes |= DCA_BRUSH;
+		}
+		if (attr.pen != def.pen)
+		{
+			changes |= DCA_PEN;
+		}
+
+		if (GM_ADVANCED == attr.graphicsMode)
+		{
+			changes |= DCA_WORLDTRANSFORM;
+		}
+
+		if (attr.mapMode != def.mapMode)
+		{
+			changes |= DCA_MAPMODE | DCA_VIEWPORTEXT | DCA_WINDOWEXT;
+		}
+		if (isChanged(attr.viewportOrg, def.viewportOrg))
+		{
+			changes |= DCA_VIEWPORTORG;
+		}
+		if (isChanged(attr.viewportExt, def.viewportExt))
+		{
+			changes |= DCA_VIEWPORTEXT;
+		}
+		if (isChanged(attr.windowOrg, def.windowOrg))
+		{
+			changes |= DCA_WINDOWORG;
+		}
+		if (isChanged(attr.windowExt, def.windowExt))
+		{
+			changes |= DCA_WINDOWEXT;
+		}
+
+		if (attr.arcDirection != def.arcDirection)
+		{
+			changes |= DCA_ARCDIRECTION;
+		}
+		if (attr.bkColor != def.bkColor)
+		{
+			changes |= DCA_BKCOLOR;
+		}
+		if (attr.bkMode != def.bkMode)
+		{
+			changes |= DCA_BKMODE;
+		}
+		if (attr.dcBrushColor != def.dcBrushColor)
+		{
+			changes |= DCA_DCBRUSHCOLOR;
+		}
+		if (attr.dcPenColor != def.dcPenColor)
+		{
+			changes |= DCA_DCPENCOLOR;
+		}
+		if (attr.layout != def.layout)
+		{
+			changes |= DCA_LAYOUT;
+		}
+		if (attr.polyFillMode != def.polyFillMode)
+		{
+			changes |= DCA_POLYFILLMODE;
+		}
+		if (attr.rop2 != def.rop2)
+		{
+			changes |= DCA_ROP2;
+		}
+		if (attr.stretchBltMode != def.stretchBltMode)
+		{
+			changes |= DCA_STRETCHBLTMODE;
+		}
+		if (attr.textAlign != def.textAlign)
+		{
+			changes |= DCA_TEXTALIGN;
+		}
+		if (attr.textCharacterExtra != def.textCharacterExtra)
+		{
+			changes |= DCA_TEXTCHARACTEREXTRA;
+		}
+		if (attr.textColor != def.textColor)
+		{
+			changes |= DCA_TEXTCOLOR;
+		}
+
+		if (isChanged(attr.brushOrg, def.brushOrg))
+		{
+			changes |= DCA_BRUSHORG;
+		}
+		if (isChanged(attr.currentPos, def.currentPos))
+		{
+			changes |= DCA_CURRENTPOS;
+		}
+
+		return changes;
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Windows.h>
+
+// Attributes of the original DC that are copied to the compatible DC.
+// The diff only uses plain GDI types, so it can be tested on any platform.
+
+namespace Gdi
+{
+	struct DcAttributes
+	{
+		HGDIOBJ font;
+		HGDIOBJ brush;
+		HGDIOBJ pen;
+		int graphicsMode;
+		XFORM worldTransform;
+		int mapMode;
+		POINT viewportOrg;
+		SIZE viewportExt;
+		POINT windowOrg;
+		SIZE windowExt;
+		int arcDirection;
+		COLORREF bkColor;
+		int bkMode;
+		COLORREF dcBrushColor;
+		COLORREF dcPenColor;
+		DWORD layout;
+		int polyFillMode;
+		int rop2;
+		int stretchBltMode;
+		UINT textAlign;
+		int textCharacterExtra;
+		COLORREF textColor;
+		POINT brushOrg;
+		POINT currentPos;
+	};
+
+	enum DcAttributeChange : unsigned int
+	{
+		DCA_FONT = 1u << 0,
+		DCA_BRUSH = 1u << 1,
+		DCA_PEN = 1u << 2,
+		DCA_WORLDTRANSFORM = 1u << 3,
+		DCA_MAPMODE = 1u << 4,
+		DCA_VIEWPORTORG = 1u << 5,
+		DCA_VIEWPORTEXT = 1u << 6,
+		DCA_WINDOWORG = 1u << 7,
+		DCA_WINDOWEXT = 1u << 8,
+		DCA_ARCDIRECTION = 1u << 9,
+		DCA_BKCOLOR = 1u << 10,
+		DCA_BKMODE = 1u << 11,
+		DCA_DCBRUSHCOLOR = 1u << 12,
+		DCA_DCPENCOLOR = 1u << 13,
+		DCA_LAYOUT = 1u << 14,
+		DCA_POLYFILLMODE = 1u << 15,
+		DCA_ROP2 = 1u << 16,
+		DCA_STRETCHBLTMODE = 1u << 17,
+		DCA_TEXTALIGN = 1u << 18,
+		DCA_TEXTCHARACTEREXTRA = 1u << 19,
+		DCA_TEXTCOLOR = 1u << 20,
+		DCA_BRUSHORG = 1u << 21,
+		DCA_CURRENTPOS = 1u << 22
+	};
+
+	// Returns the DcAttributeChange flags of the attributes that need to be applied to a DC in the default state.
+	// The world transform is always applied in advanced graphics mode, and the extents are always applied when the
+	// mapping mode changes, because changing the mapping mode can reset them.
+	unsigned int getChangedDcAttributes(const DcAttributes& attr, const DcAttributes& defaultAttr);
+}
@@ -1,5 +1,4 @@
 #include <cstring>
-#include <vector>
 
 #include "Common/CompatPtr.h"
 #include "Common/Log.h"
@@ -8,14 +7,13 @@
 #include "DDraw/Surfaces/PrimarySurface.h"
 #include "Dll/Procs.h"
 #include "Gdi/DcCache.h"
+#include "Gdi/DcPool.h"
+#include "Gdi/Gdi.h"
 
 namespace
 {
 	using Gdi::DcCache::CachedDc;
 	
-	std::vector<CachedDc> g_cache;
-	DWORD g_cacheSize = 0;
-	DWORD g_cacheId = 0;
 	DWORD g_maxUsedCacheSize = 0;
 	DWORD g_ddLockThreadId = 0;
 
@@ -49,7 +47,6 @@ namespace
 
 		cachedDc.surface = surface.detach();
 		cachedDc.dc = dc;
-		cachedDc.cacheId = g_cacheId;
 		return cachedDc;
 	}
 
@@ -78,28 +75,22 @@ namespace
 		return surface;
 	}
 
-	void extendCache()
+	bool updateDcPalette(CachedDc& cachedDc)
 	{
-		if (g_cacheSize >= Config::preallocatedGdiDcCount)
+		RGBQUAD colors[256] = {};
+		for (int i = 0; i < 256; ++i)
 		{
-			LOG_ONCE("Warning: Preallocated GDI DC count is insufficient. This may lead to graphical issues.");
+			colors[i].rgbRed = g_paletteEntries[i].peRed;
+			colors[i].rgbGreen = g_paletteEntries[i].peGreen;
+			colors[i].rgbBlue = g_paletteEntries[i].peBlue;
 		}
 
-		if (GetCurrentThreadId() != g_ddLockThreadId)
+		if (0 == SetDIBColorTable(cachedDc.dc, 0, 256, colors))
 		{
-			return;
-		}
-
-		for (DWORD i = 0; i < Config::preallocatedGdiDcCount; ++i)
-		{
-			CachedDc cachedDc = createCachedDc();
-			if (!cachedDc.dc)
-			{
-				return;
-			}
-			g_cache.push_back(cachedDc);
-			++g_cacheSize;
+			LOG_ONCE("Failed to update the color table of a cached DC");
+			return false;
 		}
+		return true;
 	}
 
 	void releaseCachedDc(CachedDc cachedDc)
@@ -115,6 +106,31 @@ namespace
 
 		cachedDc.surface.release();
 	}
+
+	class DcFactory : public Gdi::DcPool<CachedDc>::Factory
+	{
+	public:
+		virtual bool create(CachedDc& cachedDc) override
+		{
+			cachedDc = createCachedDc();
+			return nullptr != cachedDc.dc;
+		}
+
+		virtual void destroy(CachedDc& cachedDc) override
+		{
+			releaseCachedDc(cachedDc);
+		}
+
+		virtual bool updatePalette(CachedDc& cachedDc) override
+		{
+			return updateDcPalette(cachedDc);
+		}
+	};
+
+	DcFactory g_dcFactory;
+	// Cached DCs are tagged with the epoch they were created in. Clearing the pool starts a new epoch, which
+	// invalidates all DCs, including the ones currently in use, which are released instead of being returned.
+	Gdi::DcPool<CachedDc> g_dcPool(g_dcFactory, Config::preallocatedGdiDcCount);
 }
 
 namespace Gdi
@@ -123,13 +139,7 @@ namespace Gdi
 	{
 		void clear()
 		{
-			for (auto& cachedDc : g_cache)
-			{
-				releaseCachedDc(cachedDc);
-			}
-			g_cache.clear();
-			g_cacheSize = 0;
-			++g_cacheId;
+			g_dcPool.clear();
 		}
 
 		CachedDc getDc()
@@ -140,22 +150,21 @@ namespace Gdi
 				return cachedDc;
 			}
 
-			if (g_cache.empty())
+			// Only the thread holding the DD lock can create new DCs without risking a deadlock,
+			// so it refills the cache early to leave enough free DCs for the other GDI threads
+			if (!g_dcPool.get(cachedDc, GetCurrentThreadId() == g_ddLockThreadId))
 			{
-				extendCache();
+				LOG_ONCE("Warning: Preallocated GDI DC count is insufficient. This may lead to graphical issues.");
+				return cachedDc;
 			}
 
-			if (!g_cache.empty())
+			const DWORD usedCacheSize = g_dcPool.getUsedCount();
+			if (usedCacheSize > g_maxUsedCacheSize)
 			{
-				cachedDc = g_cache.back();
-				g_cache.pop_back();
-
-				const DWORD usedCacheSize = g_cacheSize - g_cache.size();
-				if (usedCacheSize > g_maxUsedCacheSize)
-				{
-					g_maxUsedCacheSize = usedCacheSize;
-					Compat::Log() << "GDI used DC cache size: " << g_maxUsedCacheSize;
-				}
+				g_maxUsedCacheSize = usedCacheSize;
+				Compat::Log() << "GDI used DC cache size: " << g_maxUsedCacheSize <<
+					" (created: " << g_dcPool.getCreatedCount() <<
+					", missed: " << g_dcPool.getMissedCount() << ')';
 			}
 
 			return cachedDc;
@@ -171,14 +180,7 @@ namespace Gdi
 
 		void releaseDc(const CachedDc& cachedDc)
 		{
-			if (cachedDc.cacheId == g_cacheId)
-			{
-				g_cache.push_back(cachedDc);
-			}
-			else
-			{
-				releaseCachedDc(cachedDc);
-			}
+			g_dcPool.release(cachedDc);
 		}
 
 		void setDdLockThreadId(DWORD ddLockThreadId)
@@ -200,6 +202,8 @@ namespace Gdi
 
 		void updatePalette(DWORD startingEntry, DWORD count)
 		{
+			Compat::ScopedProfiledCriticalSection gdiLock(Gdi::g_gdiLock, __FUNCTION__);
+
 			PALETTEENTRY entries[256] = {};
 			std::memcpy(&entries[startingEntry],
 				&DDraw::PrimarySurface::s_paletteEntries[startingEntry],
@@ -220,7 +224,7 @@ namespace Gdi
 				std::memcpy(&g_paletteEntries[startingEntry], &entries[startingEntry],
 					count * sizeof(PALETTEENTRY));
 				g_palette->SetEntries(g_palette, 0, startingEntry, count, g_paletteEntries);
-				clear();
+				g_dcPool.invalidatePalette();
 			}
 		}
 	}
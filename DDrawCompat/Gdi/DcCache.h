@@ -16,7 +16,8 @@ namespace Gdi
 		{
 			CompatWeakPtr<IDirectDrawSurface7> surface;
 			HDC dc;
-			DWORD cacheId;
+			DWORD epoch;
+			DWORD paletteGeneration;
 		};
 
 		void clear();
@@ -0,0 +1,78 @@
+#pragma once
+
+// Memoizes the results of a DC classification function on one thread until the outermost scope ends.
+// DC handles can be reused after being released, so the results are not kept between scopes.
+// This file must stay free of Windows dependencies so the cache can be tested on any platform.
+
+namespace Gdi
+{
+	template <typename Dc>
+	class DcClassificationCache
+	{
+	public:
+		typedef bool(*Classify)(Dc dc);
+
+		// Constant initialized, so that it can be used as a thread_local without dynamic initialization
+		constexpr DcClassificationCache(Classify classify)
+			: m_classify(classify)
+			, m_entries()
+			, m_count(0)
+			, m_scopeDepth(0)
+		{
+		}
+
+		void beginScope()
+		{
+			++m_scopeDepth;
+		}
+
+		void endScope()
+		{
+			if (0 == --m_scopeDepth)
+			{
+				m_count = 0;
+			}
+		}
+
+		// Only a few DCs are passed to a single hooked call, so once the cache is full, further DCs are classified
+		// on each call instead of evicting earlier results
+		bool classify(Dc dc)
+		{
+			if (0 == m_scopeDepth || !dc)
+			{
+				return m_classify(dc);
+			}
+
+			for (unsigned int i = 0; i < m_count; ++i)
+			{
+				if (m_entries[i].dc == dc)
+				{
+					return m_entries[i].result;
+				}
+			}
+
+			const bool result = m_classify(dc);
+			if (m_count < MAX_ENTRIES)
+			{
+				m_entries[m_count].dc = dc;
+				m_entries[m_count].result = result;
+				++m_count;
+			}
+			return result;
+		}
+
+	private:
+		struct Entry
+		{
+			Dc dc = Dc();
+			bool result = false;
+		};
+
+		static const unsigned int MAX_ENTRIES = 8;
+
+		Classify m_classify;
+		Entry m_entries[MAX_ENTRIES];
+		unsigned int m_count;
+		unsigned int m_scopeDepth;
+	};
+}
@@ -28,7 +28,7 @@ namespace
 
 	bool hasDisplayDcArg(HDC dc)
 	{
-		return dc && OBJ_DC == GetObjectType(dc) && DT_RASDISPLAY == GetDeviceCaps(dc, TECHNOLOGY);
+		return Gdi::Dc::isDisplayDc(dc);
 	}
 
 	template <typename T>
@@ -44,14 +44,14 @@ namespace
 	}
 
 	template <typename T>
-	T replaceDc(T t)
+	T replaceDc(T t, bool /*isReadOnly*/)
 	{
 		return t;
 	}
 
-	HDC replaceDc(HDC dc)
+	HDC replaceDc(HDC dc, bool isReadOnly)
 	{
-		HDC compatDc = Gdi::Dc::getDc(dc);
+		HDC compatDc = Gdi::Dc::getDc(dc, isReadOnly);
 		return compatDc ? compatDc : dc;
 	}
 
@@ -77,8 +77,9 @@ namespace
 		Compat::LogEnter(g_funcNames[origFunc], params...);
 #endif
 
-		if (!hasDisplayDcArg(params...) ||
-			!Gdi::beginGdiRendering(getDdLockFlags<OrigFuncPtr, origFunc>(params...)))
+		Gdi::Dc::DisplayDcCacheScope displayDcCacheScope;
+		const DWORD lockFlags = getDdLockFlags<OrigFuncPtr, origFunc>(params...);
+		if (!hasDisplayDcArg(params...) || !Gdi::beginGdiRendering(lockFlags))
 		{
 			Result result = Compat::getOrigFuncPtr<OrigFuncPtr, origFunc>()(params...);
 
@@ -101,7 +102,8 @@ namespace
 			return result;
 		}
 
-		Result result = Compat::getOrigFuncPtr<OrigFuncPtr, origFunc>()(replaceDc(params)...);
+		Result result = Compat::getOrigFuncPtr<OrigFuncPtr, origFunc>()(
+			replaceDc(params, DDLOCK_READONLY == lockFlags)...);
 		releaseDc(params...);
 		Gdi::endGdiRendering();
 
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <vector>
+
+// Pool of cached DCs, which are expensive to create.
+// This file must stay free of Windows dependencies so the pool can be tested on any platform.
+
+namespace Gdi
+{
+	// CachedDc must be copyable and have epoch and paletteGeneration members, which are maintained by the pool
+	template <typename CachedDc>
+	class DcPool
+	{
+	public:
+		class Factory
+		{
+		public:
+			virtual ~Factory() {}
+
+			// Returns false if no DC could be created
+			virtual bool create(CachedDc& cachedDc) = 0;
+			virtual void destroy(CachedDc& cachedDc) = 0;
+			// Applies the current palette to a DC created before the last palette change
+			virtual bool updatePalette(CachedDc& cachedDc) = 0;
+		};
+
+		DcPool(Factory& factory, unsigned int batchSize)
+			: m_factory(factory)
+			, m_batchSize(batchSize)
+			, m_size(0)
+			, m_epoch(0)
+			, m_paletteGeneration(0)
+			, m_createdCount(0)
+			, m_missedCount(0)
+		{
+		}
+
+		// Takes a free DC and returns false if there is none. If canCreate, a batch of new DCs is added first
+		// when at most half a batch is free, so that callers that cannot create DCs still find free ones.
+		// DCs are updated to the current palette when taken, and DCs that fail to update are destroyed.
+		bool get(CachedDc& cachedDc, bool canCreate)
+		{
+			if (canCreate && m_free.size() <= m_batchSize / 2)
+			{
+				extend();
+			}
+
+			while (!m_free.empty())
+			{
+				cachedDc = m_free.back();
+				m_free.pop_back();
+
+				if (cachedDc.paletteGeneration == m_paletteGeneration || m_factory.updatePalette(cachedDc))
+				{
+					cachedDc.paletteGeneration = m_paletteGeneration;
+					return true;
+				}
+
+				--m_size;
+				m_factory.destroy(cachedDc);
+			}
+
+			++m_missedCount;
+			return false;
+		}
+
+		// DCs created before the last clear are destroyed instead of being returned to the pool
+		void release(const CachedDc& cachedDc)
+		{
+			if (cachedDc.epoch == m_epoch)
+			{
+				m_free.push_back(cachedDc);
+			}
+			else
+			{
+				CachedDc oldDc(cachedDc);
+				m_factory.destroy(oldDc);
+			}
+		}
+
+		// Destroys the free DCs and starts a new epoch, which invalidates the DCs in use
+		void clear()
+		{
+			for (auto& cachedDc : m_free)
+			{
+				m_factory.destroy(cachedDc);
+			}
+			m_free.clear();
+			m_size = 0;
+			++m_epoch;
+		}
+
+		// Palette changes only start a new generation, cached DCs are updated lazily when they are reused
+		void invalidatePalette()
+		{
+			++m_paletteGeneration;
+		}
+
+		unsigned int getCreatedCount() const { return m_createdCount; }
+		unsigned long getEpoch() const { return m_epoch; }
+		unsigned int getMissedCount() const { return m_missedCount; }
+		unsigned int getUsedCount() const { return m_size - static_cast<unsigned int>(m_free.size()); }
+
+	private:
+		DcPool(const DcPool&) = delete;
+		DcPool& operator=(const DcPool&) = delete;
+
+		void extend()
+		{
+			for (unsigned int i = 0; i < m_batchSize; ++i)
+			{
+				CachedDc cachedDc = {};
+				if (!m_factory.create(cachedDc))
+				{
+					return;
+				}
+
+				cachedDc.epoch = m_epoch;
+				cachedDc.paletteGeneration = m_paletteGeneration;
+				m_free.push_back(cachedDc);
+				++m_size;
+				++m_createdCount;
+			}
+		}
+
+		Factory& m_factory;
+		const unsigned int m_batchSize;
+		std::vector<CachedDc> m_free;
+		// The number of DCs of the current epoch, either free or in use
+		unsigned int m_size;
+		unsigned long m_epoch;
+		unsigned long m_paletteGeneration;
+		unsigned int m_createdCount;
+		unsigned int m_missedCount;
+	};
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <unordered_map>
+
+// Maps compatible DCs back to the original DCs they were created for.
+// LockPolicy must provide lock(), unlock(), lockShared() and unlockShared(). The lock is never held across other
+// calls, and lookups skip it entirely while nothing is mapped, which is the common case in hooked functions.
+// This file must stay free of Windows dependencies so the map can be tested on any platform.
+
+namespace Gdi
+{
+	template <typename Dc, typename LockPolicy>
+	class DcReverseMap
+	{
+	public:
+		DcReverseMap() : m_count(0) {}
+
+		void add(Dc compatDc, Dc origDc)
+		{
+			m_lock.lock();
+			m_map[compatDc] = origDc;
+			m_count = m_map.size();
+			m_lock.unlock();
+		}
+
+		void remove(Dc compatDc)
+		{
+			m_lock.lock();
+			m_map.erase(compatDc);
+			m_count = m_map.size();
+			m_lock.unlock();
+		}
+
+		// Returns dc itself if it is not a mapped compatible DC
+		Dc getOrigDc(Dc dc)
+		{
+			if (0 == m_count)
+			{
+				return dc;
+			}
+
+			m_lock.lockShared();
+			const auto it = m_map.find(dc);
+			const Dc origDc = it != m_map.end() ? it->second : dc;
+			m_lock.unlockShared();
+			return origDc;
+		}
+
+		std::size_t getCount() const { return m_count; }
+
+	private:
+		LockPolicy m_lock;
+		std::unordered_map<Dc, Dc> m_map;
+		std::atomic<std::size_t> m_count;
+	};
+}
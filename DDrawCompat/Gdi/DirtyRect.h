@@ -0,0 +1,80 @@
+#pragma once
+
+#include <Windows.h>
+
+// Accumulates the device bounds of GDI output on the GDI surface between updates of the real primary surface.
+// Only uses plain GDI types, so it can be tested on any platform.
+
+namespace Gdi
+{
+	class DirtyRect
+	{
+	public:
+		DirtyRect() : m_rect(), m_isFull(false) {}
+
+		// A null rect marks the whole surface dirty
+		void add(const RECT* rect)
+		{
+			if (!rect)
+			{
+				m_isFull = true;
+			}
+			else if (!IsRectEmpty(rect))
+			{
+				if (IsRectEmpty(&m_rect))
+				{
+					m_rect = *rect;
+				}
+				else
+				{
+					m_rect.left = rect->left < m_rect.left ? rect->left : m_rect.left;
+					m_rect.top = rect->top < m_rect.top ? rect->top : m_rect.top;
+					m_rect.right = rect->right > m_rect.right ? rect->right : m_rect.right;
+					m_rect.bottom = rect->bottom > m_rect.bottom ? rect->bottom : m_rect.bottom;
+				}
+			}
+		}
+
+		// Returns null if the whole surface is dirty, otherwise rect, which receives the dirty rect and may be empty
+		const RECT* take(RECT& rect)
+		{
+			const bool isFull = m_isFull;
+			rect = m_rect;
+			m_rect = {};
+			m_isFull = false;
+			return isFull ? nullptr : &rect;
+		}
+
+		// Converts the result of GetBoundsRect(DCB_RESET) for a DC that was written to into the rect to add.
+		// Logical bounds are converted to device coordinates by lpToDp(RECT&). GDI does not accumulate bounds for
+		// all output, and they are unreliable with world transforms, so the whole surface is marked dirty instead
+		// if the bounds are missing or the DC is in advanced graphics mode.
+		template <typename LpToDp>
+		static const RECT* getBoundsRect(UINT boundsResult, RECT& bounds, bool isAdvancedGraphicsMode, LpToDp lpToDp)
+		{
+			if (DCB_SET != (boundsResult & DCB_SET) || isAdvancedGraphicsMode)
+			{
+				return nullptr;
+			}
+
+			lpToDp(bounds);
+			if (bounds.left > bounds.right)
+			{
+				const LONG left = bounds.left;
+				bounds.left = bounds.right;
+				bounds.right = left;
+			}
+			if (bounds.top > bounds.bottom)
+			{
+				const LONG top = bounds.top;
+				bounds.top = bounds.bottom;
+				bounds.bottom = top;
+			}
+			return &bounds;
+		}
+
+	private:
+		RECT m_rect;
+		bool m_isFull;
+	};
+}
@@ -1,14 +1,18 @@
 #include <atomic>
 
 #include "Common/ScopedCriticalSection.h"
+#include "Config/Config.h"
+#include "DDraw/DirectDrawSurface.h"
 #include "DDraw/RealPrimarySurface.h"
+#include "DDraw/ScopedThreadLock.h"
 #include "DDraw/Surfaces/PrimarySurface.h"
-#include "Dll/Procs.h"
 #include "Gdi/Caret.h"
 #include "Gdi/DcCache.h"
 #include "Gdi/DcFunctions.h"
+#include "Gdi/DirtyRect.h"
 #include "Gdi/Gdi.h"
 #include "Gdi/PaintHandlers.h"
+#include "Gdi/RenderingSession.h"
 #include "Gdi/ScrollFunctions.h"
 #include "Gdi/WinProc.h"
 
@@ -22,6 +26,14 @@ namespace
 	HANDLE g_ddUnlockBeginEvent = nullptr;
 	HANDLE g_ddUnlockEndEvent = nullptr;
 	bool g_isDelayedUnlockPending = false;
+	CRITICAL_SECTION g_gdiCriticalSection;
+	// Acquisitions that span beginGdiRendering and endGdiRendering
+	Compat::ProfiledCriticalSection::AcquisitionId g_gdiLockAcquisitionId = 0;
+	decltype(DDraw::g_threadLock)::AcquisitionId g_threadLockAcquisitionId = 0;
+
+	// Device bounds of the GDI output since the last update of the real primary surface.
+	// Only accessed while holding the GDI lock.
+	Gdi::DirtyRect g_dirtyRect;
 
 	bool lockGdiSurface(DWORD lockFlags)
 	{
@@ -37,47 +49,95 @@ namespace
 		g_ddLockFlags = lockFlags;
 		if (0 != lockFlags)
 		{
-			EnterCriticalSection(&Gdi::g_gdiCriticalSection);
+			g_gdiLockAcquisitionId = Gdi::g_gdiLock.lock(__FUNCTION__);
 		}
 
-		g_ddLockThreadId = GetCurrentThreadId();
-		Gdi::DcCache::setDdLockThreadId(g_ddLockThreadId);
 		Gdi::DcCache::setSurfaceMemory(desc.lpSurface, desc.lPitch);
 		return true;
 	}
 
+	bool isRenderingSessionAllowed()
+	{
+		return Config::batchGdiRendering &&
+			0 != (DDraw::PrimarySurface::getDesc().ddsCaps.dwCaps & DDSCAPS_SYSTEMMEMORY);
+	}
+
 	BOOL CALLBACK redrawWindowCallback(HWND hwnd, LPARAM lParam)
 	{
 		Gdi::redrawWindow(hwnd, reinterpret_cast<HRGN>(lParam));
 		return TRUE;
 	}
 
-	void unlockGdiSurface()
+	// Returns null if the whole surface is dirty
+	const RECT* takeDirtyRect(RECT& rect)
+	{
+		Compat::ScopedProfiledCriticalSection gdiLock(Gdi::g_gdiLock, __FUNCTION__);
+		return g_dirtyRect.take(rect);
+	}
+
+	void unlockGdiSurface(bool isIdle)
 	{
 		GdiFlush();
 		auto gdiSurface(DDraw::PrimarySurface::getGdiSurface());
 		if (gdiSurface)
 		{
-			gdiSurface.get()->lpVtbl->Unlock(gdiSurface, nullptr);
+			// The original Unlock is used to update only the dirty rect instead of the whole surface
+			CompatVtable<IDirectDrawSurface7Vtbl>::s_origVtable.Unlock(gdiSurface, nullptr);
 			if (DDLOCK_READONLY != g_ddLockFlags)
 			{
-				DDraw::RealPrimarySurface::update();
+				RECT rect = {};
+				const RECT* dirtyRect = takeDirtyRect(rect);
+				if (isIdle)
+				{
+					// Idle sessions end inside other DD thread lock owners, which must not be presented from
+					DDraw::RealPrimarySurface::scheduleUpdate(dirtyRect);
+				}
+				else
+				{
+					DDraw::RealPrimarySurface::update(dirtyRect);
+				}
 			}
 		}
 
 		if (0 != g_ddLockFlags)
 		{
-			LeaveCriticalSection(&Gdi::g_gdiCriticalSection);
+			Gdi::g_gdiLock.unlock(g_gdiLockAcquisitionId);
 		}
 		g_ddLockFlags = 0;
-
-		Dll::g_origProcs.ReleaseDDThreadLock();
 	}
+
+	class GdiSurface : public Gdi::RenderingSession::Surface
+	{
+	public:
+		virtual bool lock(unsigned long lockFlags) override
+		{
+			return lockGdiSurface(lockFlags);
+		}
+
+		virtual void unlock(bool isIdle) override
+		{
+			unlockGdiSurface(isIdle);
+		}
+
+		virtual void flush() override
+		{
+			GdiFlush();
+			RECT rect = {};
+			DDraw::RealPrimarySurface::scheduleUpdate(takeDirtyRect(rect));
+		}
+	};
+
+	GdiSurface g_gdiSurface;
+
+	// An idle rendering session keeps the GDI surface locked after the last GDI call ends, while the
+	// DD thread lock is released. It ends when the DD thread lock is taken through ScopedThreadLock and at the
+	// scheduled update of the real primary surface. Only used while holding the DD thread lock.
+	Gdi::RenderingSession g_renderingSession(g_gdiSurface);
 }
 
 namespace Gdi
 {
-	CRITICAL_SECTION g_gdiCriticalSection;
+	Compat::ProfiledCriticalSection g_gdiLock("GDI lock", Config::lockProfiling, g_gdiCriticalSection);
 
 	bool beginGdiRendering(DWORD lockFlags)
 	{
@@ -86,18 +146,20 @@ namespace Gdi
 			return false;
 		}
 
-		Compat::ScopedCriticalSection gdiLock(g_gdiCriticalSection);
+		Compat::ScopedProfiledCriticalSection gdiLock(g_gdiLock, __FUNCTION__);
 
 		if (0 == g_renderingRefCount)
 		{
-			LeaveCriticalSection(&g_gdiCriticalSection);
-			Dll::g_origProcs.AcquireDDThreadLock();
-			EnterCriticalSection(&g_gdiCriticalSection);
-			if (!lockGdiSurface(lockFlags))
+			gdiLock.unlock();
+			g_threadLockAcquisitionId = DDraw::g_threadLock.lock(__FUNCTION__);
+			gdiLock.lock(__FUNCTION__);
+			if (!g_renderingSession.begin(lockFlags))
 			{
-				Dll::g_origProcs.ReleaseDDThreadLock();
+				DDraw::g_threadLock.unlock(g_threadLockAcquisitionId);
 				return false;
 			}
+			g_ddLockThreadId = GetCurrentThreadId();
+			Gdi::DcCache::setDdLockThreadId(g_ddLockThreadId);
 		}
 
 		if (GetCurrentThreadId() == g_ddLockThreadId)
@@ -111,13 +173,14 @@ namespace Gdi
 
 	void endGdiRendering()
 	{
-		Compat::ScopedCriticalSection gdiLock(g_gdiCriticalSection);
+		Compat::ScopedProfiledCriticalSection gdiLock(g_gdiLock, __FUNCTION__);
 
 		if (GetCurrentThreadId() == g_ddLockThreadId)
 		{
 			if (1 == g_renderingRefCount)
 			{
-				unlockGdiSurface();
+				g_renderingSession.end(isRenderingSessionAllowed());
+				DDraw::g_threadLock.unlock(g_threadLockAcquisitionId);
 				g_ddLockThreadRenderingRefCount = 0;
 				g_renderingRefCount = 0;
 			}
@@ -126,7 +189,8 @@ namespace Gdi
 				g_isDelayedUnlockPending = true;
 				gdiLock.unlock();
 				WaitForSingleObject(g_ddUnlockBeginEvent, INFINITE);
-				unlockGdiSurface();
+				g_renderingSession.end(false);
+				DDraw::g_threadLock.unlock(g_threadLockAcquisitionId);
 				g_ddLockThreadRenderingRefCount = 0;
 				g_renderingRefCount = 0;
 				SetEvent(g_ddUnlockEndEvent);
@@ -149,6 +213,26 @@ namespace Gdi
 		}
 	}
 
+	void endRenderingSession()
+	{
+		if (!g_renderingSession.isIdle())
+		{
+			return;
+		}
+
+		Compat::ScopedProfiledCriticalSection gdiLock(g_gdiLock, __FUNCTION__);
+		if (0 == g_renderingRefCount)
+		{
+			g_renderingSession.close();
+		}
+	}
+
+	void addDirtyRect(const RECT* rect)
+	{
+		Compat::ScopedProfiledCriticalSection gdiLock(g_gdiLock, __FUNCTION__);
+		g_dirtyRect.add(rect);
+	}
+
 	void disableEmulation()
 	{
 		++g_disableEmulationCount;
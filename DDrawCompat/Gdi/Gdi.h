@@ -4,12 +4,17 @@
 
 #include <Windows.h>
 
+#include "Common/ScopedCriticalSection.h"
+
 namespace Gdi
 {
 	typedef void(*WindowPosChangeNotifyFunc)(HWND, const RECT&, const RECT&);
 
 	bool beginGdiRendering(DWORD lockFlags = 0);
 	void endGdiRendering();
+	void endRenderingSession();
+	// A null rect marks the whole GDI surface dirty
+	void addDirtyRect(const RECT* rect);
 
 	void disableEmulation();
 	void enableEmulation();
@@ -24,5 +29,5 @@ namespace Gdi
 	void updatePalette(DWORD startingEntry, DWORD count);
 	void watchWindowPosChanges(WindowPosChangeNotifyFunc notifyFunc);
 
-	extern CRITICAL_SECTION g_gdiCriticalSection;
+	extern Compat::ProfiledCriticalSection g_gdiLock;
 };
@@ -0,0 +1,61 @@
+#include "Gdi/RenderingSession.h"
+
+namespace Gdi
+{
+	RenderingSession::RenderingSession(Surface& surface)
+		: m_surface(surface)
+		, m_lockFlags(0)
+		, m_isLocked(false)
+		, m_isIdle(false)
+	{
+	}
+
+	bool RenderingSession::begin(unsigned long lockFlags)
+	{
+		if (m_isIdle && 0 == lockFlags)
+		{
+			m_isIdle = false;
+			return true;
+		}
+
+		close();
+		if (!m_surface.lock(lockFlags))
+		{
+			return false;
+		}
+
+		m_lockFlags = lockFlags;
+		m_isLocked = true;
+		return true;
+	}
+
+	void RenderingSession::end(bool isIdleAllowed)
+	{
+		if (!m_isLocked || m_isIdle)
+		{
+			return;
+		}
+
+		if (isIdleAllowed && 0 == m_lockFlags)
+		{
+			m_surface.flush();
+			m_isIdle = true;
+			return;
+		}
+
+		m_isLocked = false;
+		m_surface.unlock(false);
+	}
+
+	void RenderingSession::close()
+	{
+		if (!m_isIdle)
+		{
+			return;
+		}
+
+		m_isIdle = false;
+		m_isLocked = false;
+		m_surface.unlock(true);
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+// Decides when the GDI surface is locked and unlocked for GDI rendering.
+// This file must stay free of Windows dependencies so the state machine can be tested on any platform.
+
+namespace Gdi
+{
+	class RenderingSession
+	{
+	public:
+		class Surface
+		{
+		public:
+			virtual ~Surface() {}
+
+			virtual bool lock(unsigned long lockFlags) = 0;
+			// isIdle is true if the surface was kept locked in an idle session after the rendering ended
+			virtual void unlock(bool isIdle) = 0;
+			// Schedules the rendering done so far for presentation while the surface stays locked
+			virtual void flush() = 0;
+		};
+
+		RenderingSession(Surface& surface);
+
+		// Starts rendering with the surface locked. An idle session is reused if no lock flags are requested,
+		// otherwise it is ended first.
+		bool begin(unsigned long lockFlags);
+		// Ends rendering. If isIdleAllowed and the surface was locked without flags, it stays locked in an
+		// idle session, so that a burst of GDI rendering needs only one lock and unlock.
+		void end(bool isIdleAllowed);
+		// Ends an idle session. Has no effect while rendering is in progress.
+		void close();
+
+		bool isIdle() const { return m_isIdle; }
+		bool isLocked() const { return m_isLocked; }
+
+	private:
+		Surface& m_surface;
+		unsigned long m_lockFlags;
+		bool m_isLocked;
+		bool m_isIdle;
+	};
+}
@@ -50,7 +50,7 @@ namespace
 			}
 			else if (WM_DESTROY == ret->message)
 			{
-				Compat::ScopedCriticalSection lock(Gdi::g_gdiCriticalSection);
+				Compat::ScopedProfiledCriticalSection lock(Gdi::g_gdiLock, __FUNCTION__);
 				g_windowData.erase(ret->hwnd);
 			}
 			else if (WM_WINDOWPOSCHANGED == ret->message)
@@ -191,7 +191,7 @@ namespace
 			return;
 		}
 
-		Compat::ScopedCriticalSection lock(Gdi::g_gdiCriticalSection);
+		Compat::ScopedProfiledCriticalSection lock(Gdi::g_gdiLock, __FUNCTION__);
 
 		WindowData prevData = g_windowData[hwnd];
 		WindowData data = getWindowData(hwnd);
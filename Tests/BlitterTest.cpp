@@ -0,0 +1,526 @@
+#include <cstdlib>
+#include <vector>
+
+// Included directly to test the row functions in its anonymous namespace
+#include "DDraw/Blitter.cpp"
+#include "Test.h"
+
+namespace
+{
+	// Draws most values from the keys, so that both matching and non-matching pixels are frequent
+	DWORD getRandomPixel(const KeyParams& keys)
+	{
+		switch (std::rand() % 4)
+		{
+		case 0:
+			return keys.srcKey | (std::rand() & ~keys.mask);
+		case 1:
+			return keys.dstKey | (std::rand() & ~keys.mask);
+		default:
+			return (static_cast<DWORD>(std::rand()) << 16) ^ static_cast<DWORD>(std::rand());
+		}
+	}
+
+	template <typename Pixel>
+	void checkKeyedRowMatchesScalar(DWORD maxMask)
+	{
+		const DWORD masks[] = { maxMask, maxMask & 0xF0F0F0F0, maxMask & 0x00FF00FF };
+		std::vector<Pixel> src(80);
+		std::vector<Pixel> dst(80);
+		std::vector<Pixel> expected(80);
+
+		for (int i = 0; i < 2000; ++i)
+		{
+			KeyParams keys = {};
+			keys.mask = masks[std::rand() % 3];
+			keys.srcKey = static_cast<DWORD>(std::rand()) & keys.mask;
+			keys.dstKey = static_cast<DWORD>(std::rand()) & keys.mask;
+			keys.isSrcKey = 0 != (i & 1);
+			keys.isDstKey = 0 != (i & 2) || !keys.isSrcKey;
+
+			for (std::size_t x = 0; x < src.size(); ++x)
+			{
+				src[x] = static_cast<Pixel>(getRandomPixel(keys));
+				dst[x] = static_cast<Pixel>(getRandomPixel(keys));
+			}
+			expected = dst;
+
+			// Unaligned offsets and widths that leave a scalar tail of every length
+			const int srcOffset = std::rand() % 16;
+			const int dstOffset = std::rand() % 16;
+			const LONG width = std::rand() % 64;
+			bltKeyedRowScalar(expected.data() + dstOffset, src.data() + srcOffset, width, keys);
+			bltKeyedRow(dst.data() + dstOffset, src.data() + srcOffset, width, keys);
+			CHECK(expected == dst);
+		}
+	}
+}
+
+TEST(keyedRowMatchesScalarFor8BitPixels)
+{
+	std::srand(1);
+	checkKeyedRowMatchesScalar<BYTE>(0xFF);
+}
+
+TEST(keyedRowMatchesScalarFor16BitPixels)
+{
+	std::srand(2);
+	checkKeyedRowMatchesScalar<WORD>(0xFFFF);
+}
+
+TEST(keyedRowMatchesScalarFor32BitPixels)
+{
+	std::srand(3);
+	checkKeyedRowMatchesScalar<DWORD>(0xFFFFFFFF);
+}
+
+namespace
+{
+	struct Surface
+	{
+		DWORD bytesPerPixel;
+		LONG pitch;
+		std::vector<BYTE> data;
+
+		Surface(LONG width, LONG height, DWORD bytesPerPixel)
+			: bytesPerPixel(bytesPerPixel)
+			, pitch(width * bytesPerPixel + 5)
+			, data(pitch * height)
+		{
+		}
+
+		DDraw::Blitter::Image getImage()
+		{
+			return { data.data(), pitch, bytesPerPixel };
+		}
+	};
+
+	// Blits between overlapping rects of the same surface, and compares the result with copying the
+	// source rect to a separate surface first
+	void checkOverlappingBlt(DWORD bytesPerPixel, LONG dx, LONG dy, bool isSrcKey, bool isDstKey)
+	{
+		const LONG width = 24;
+		const LONG height = 8;
+		const DWORD mask = 4 == bytesPerPixel ? 0xFFFFFFFF : (1u << (bytesPerPixel * 8)) - 1;
+		const DDCOLORKEY srcColorKey = { 0x01010101 & mask, 0x01010101 & mask };
+		const DDCOLORKEY dstColorKey = { 0x02020202 & mask, 0x02020202 & mask };
+
+		// Half of the pixels are set to one of the keys, so that both keys match often
+		Surface surface(width + 8, height + 8, bytesPerPixel);
+		for (auto& value : surface.data)
+		{
+			value = static_cast<BYTE>(std::rand());
+		}
+		for (LONG y = 0; y < height + 8; ++y)
+		{
+			for (LONG x = 0; x < width + 8; ++x)
+			{
+				const DWORD key = 0 == std::rand() % 2
+					? srcColorKey.dwColorSpaceLowValue : dstColorKey.dwColorSpaceLowValue;
+				if (0 == std::rand() % 2)
+				{
+					memcpy(&surface.data[y * surface.pitch + x * bytesPerPixel], &key, bytesPerPixel);
+				}
+			}
+		}
+
+		DDraw::Blitter::BltParams params = {};
+		params.srcRect = { 4, 4, 4 + width, 4 + height };
+		params.dstRect = { 4 + dx, 4 + dy, 4 + dx + width, 4 + dy + height };
+		params.colorKeyMask = mask;
+		params.srcColorKey = isSrcKey ? &srcColorKey : nullptr;
+		params.dstColorKey = isDstKey ? &dstColorKey : nullptr;
+		params.rop = SRCCOPY;
+
+		Surface temp(width, height, bytesPerPixel);
+		for (LONG y = 0; y < height; ++y)
+		{
+			memcpy(&temp.data[y * temp.pitch], &surface.data[(params.srcRect.top + y) * surface.pitch +
+				params.srcRect.left * bytesPerPixel], width * bytesPerPixel);
+		}
+
+		Surface expected(surface);
+		DDraw::Blitter::BltParams tempParams = params;
+		tempParams.srcRect = { 0, 0, width, height };
+		DDraw::Blitter::blt(expected.getImage(), temp.getImage(), tempParams);
+
+		DDraw::Blitter::blt(surface.getImage(), surface.getImage(), params);
+		CHECK(expected.data == surface.data);
+	}
+
+	void checkOverlappingBlts(bool isSrcKey, bool isDstKey)
+	{
+		for (DWORD bytesPerPixel = 1; bytesPerPixel <= 4; ++bytesPerPixel)
+		{
+			for (LONG dy = -3; dy <= 3; ++dy)
+			{
+				for (LONG dx = -3; dx <= 3; ++dx)
+				{
+					checkOverlappingBlt(bytesPerPixel, dx, dy, isSrcKey, isDstKey);
+				}
+			}
+		}
+	}
+}
+
+TEST(overlappingBltMatchesCopyViaTemp)
+{
+	std::srand(4);
+	checkOverlappingBlts(false, false);
+}
+
+TEST(overlappingBltWithSrcColorKeyMatchesCopyViaTemp)
+{
+	std::srand(5);
+	checkOverlappingBlts(true, false);
+}
+
+TEST(overlappingBltWithDstColorKeyMatchesCopyViaTemp)
+{
+	std::srand(6);
+	checkOverlappingBlts(false, true);
+}
+
+TEST(overlappingBltWithBothColorKeysMatchesCopyViaTemp)
+{
+	std::srand(7);
+	checkOverlappingBlts(true, true);
+}
+
+namespace
+{
+	DWORD readPixel(const Surface& surface, LONG x, LONG y)
+	{
+		DWORD value = 0;
+		memcpy(&value, &surface.data[y * surface.pitch + x * surface.bytesPerPixel], surface.bytesPerPixel);
+		return value;
+	}
+
+	void writePixel(Surface& surface, LONG x, LONG y, DWORD value)
+	{
+		memcpy(&surface.data[y * surface.pitch + x * surface.bytesPerPixel], &value, surface.bytesPerPixel);
+	}
+
+	DWORD lerpReference(DWORD a, DWORD b, const DDPIXELFORMAT& pf, DWORD weight)
+	{
+		DWORD masks[] = { pf.dwRBitMask, pf.dwGBitMask, pf.dwBBitMask,
+			(pf.dwFlags & DDPF_ALPHAPIXELS) ? pf.dwRGBAlphaBitMask : 0 };
+		DWORD result = 0;
+		for (DWORD mask : masks)
+		{
+			const unsigned long long channel = (1ull * (a & mask) * (256 - weight) + 1ull * (b & mask) * weight) >> 8;
+			result |= static_cast<DWORD>(channel) & mask;
+		}
+		return result;
+	}
+
+	// Pixel by pixel reference for stretched and mirrored blits, computing the 16.16 source position of each
+	// destination pixel directly instead of stepping through it
+	void bltReference(Surface& dst, const Surface& src, const DDraw::Blitter::BltParams& params)
+	{
+		const LONG dstWidth = params.dstRect.right - params.dstRect.left;
+		const LONG dstHeight = params.dstRect.bottom - params.dstRect.top;
+		const LONG srcWidth = params.srcRect.right - params.srcRect.left;
+		const LONG srcHeight = params.srcRect.bottom - params.srcRect.top;
+		const LONG stepX = (srcWidth << 16) / dstWidth;
+		const LONG stepY = (srcHeight << 16) / dstHeight;
+
+		auto readSrcPixel = [&](LONG column, LONG row)
+		{
+			if (params.isMirroredLeftRight)
+			{
+				column = srcWidth - 1 - column;
+			}
+			if (params.isMirroredUpDown)
+			{
+				row = srcHeight - 1 - row;
+			}
+			return readPixel(src, params.srcRect.left + column, params.srcRect.top + row);
+		};
+
+		for (LONG y = 0; y < dstHeight; ++y)
+		{
+			const LONG srcY = stepY / 2 + y * stepY;
+			for (LONG x = 0; x < dstWidth; ++x)
+			{
+				const LONG srcX = (stepX / 2 + x * stepX) / 65536;
+				DWORD value = readSrcPixel(srcX, srcY / 65536);
+				DWORD keyedValue = value;
+				if (params.linearFilterPf && srcHeight != dstHeight && srcY >= 0x8000)
+				{
+					const LONG row = (srcY - 0x8000) / 65536;
+					const LONG nextRow = row + 1 < srcHeight ? row + 1 : row;
+					const DWORD weight = ((srcY - 0x8000) / 256) % 256;
+					keyedValue = readSrcPixel(srcX, row);
+					value = 0 == weight ? keyedValue :
+						lerpReference(keyedValue, readSrcPixel(srcX, nextRow), *params.linearFilterPf, weight);
+				}
+
+				const LONG dstX = params.dstRect.left + x;
+				const LONG dstY = params.dstRect.top + y;
+				if ((params.srcColorKey &&
+						(keyedValue & params.colorKeyMask) == params.srcColorKey->dwColorSpaceLowValue) ||
+					(params.dstColorKey &&
+						(readPixel(dst, dstX, dstY) & params.colorKeyMask) != params.dstColorKey->dwColorSpaceLowValue))
+				{
+					continue;
+				}
+				writePixel(dst, dstX, dstY, value);
+			}
+		}
+	}
+
+	void fillRandom(Surface& surface)
+	{
+		for (auto& value : surface.data)
+		{
+			value = static_cast<BYTE>(std::rand());
+		}
+	}
+
+	RECT getRandomRect(LONG maxWidth, LONG maxHeight)
+	{
+		RECT rect = {};
+		rect.left = std::rand() % (maxWidth / 2);
+		rect.top = std::rand() % (maxHeight / 2);
+		rect.right = rect.left + 1 + std::rand() % (maxWidth - rect.left);
+		rect.bottom = rect.top + 1 + std::rand() % (maxHeight - rect.top);
+		return rect;
+	}
+
+	void checkStretchedBlts(const DDPIXELFORMAT& pf, bool isLinearFilter, bool isSrcKey,
+		bool isMirroredLeftRight = false, bool isMirroredUpDown = false)
+	{
+		const DWORD bytesPerPixel = pf.dwRGBBitCount / 8;
+		const DWORD mask = 4 == bytesPerPixel ? 0xFFFFFFFF : (1u << pf.dwRGBBitCount) - 1;
+		for (int i = 0; i < 300; ++i)
+		{
+			Surface src(40, 40, bytesPerPixel);
+			Surface dst(60, 60, bytesPerPixel);
+			fillRandom(src);
+			fillRandom(dst);
+
+			// Few distinct values, so that the source color key matches often
+			const DDCOLORKEY srcColorKey = { 0x00FF00FF & mask, 0x00FF00FF & mask };
+			if (isSrcKey)
+			{
+				for (LONG y = 0; y < 40; ++y)
+				{
+					for (LONG x = 0; x < 40; ++x)
+					{
+						if (0 == std::rand() % 3)
+						{
+							writePixel(src, x, y, srcColorKey.dwColorSpaceLowValue);
+						}
+					}
+				}
+			}
+
+			DDraw::Blitter::BltParams params = {};
+			params.srcRect = getRandomRect(40, 40);
+			params.dstRect = getRandomRect(60, 60);
+			params.colorKeyMask = mask;
+			params.srcColorKey = isSrcKey ? &srcColorKey : nullptr;
+			params.linearFilterPf = isLinearFilter ? &pf : nullptr;
+			params.rop = SRCCOPY;
+			params.isMirroredLeftRight = isMirroredLeftRight;
+			params.isMirroredUpDown = isMirroredUpDown;
+
+			Surface expected(dst);
+			bltReference(expected, src, params);
+			DDraw::Blitter::blt(dst.getImage(), src.getImage(), params);
+			CHECK(expected.data == dst.data);
+		}
+	}
+
+	DDPIXELFORMAT getPixelFormat(DWORD flags, DWORD bitCount, DWORD r, DWORD g, DWORD b, DWORD a)
+	{
+		DDPIXELFORMAT pf = {};
+		pf.dwSize = sizeof(pf);
+		pf.dwFlags = flags;
+		pf.dwRGBBitCount = bitCount;
+		pf.dwRBitMask = r;
+		pf.dwGBitMask = g;
+		pf.dwBBitMask = b;
+		pf.dwRGBAlphaBitMask = a;
+		return pf;
+	}
+
+	const DDPIXELFORMAT g_pf8 = getPixelFormat(DDPF_PALETTEINDEXED8 | DDPF_RGB, 8, 0, 0, 0, 0);
+	const DDPIXELFORMAT g_pf565 = getPixelFormat(DDPF_RGB, 16, 0xF800, 0x07E0, 0x001F, 0);
+	const DDPIXELFORMAT g_pf888 = getPixelFormat(DDPF_RGB, 24, 0xFF0000, 0x00FF00, 0x0000FF, 0);
+	const DDPIXELFORMAT g_pfX888 = getPixelFormat(DDPF_RGB, 32, 0xFF0000, 0x00FF00, 0x0000FF, 0);
+	const DDPIXELFORMAT g_pfA888 = getPixelFormat(DDPF_RGB | DDPF_ALPHAPIXELS, 32,
+		0xFF0000, 0x00FF00, 0x0000FF, 0xFF000000);
+}
+
+TEST(stretchedBltMatchesReference)
+{
+	std::srand(8);
+	for (const DDPIXELFORMAT* pf : { &g_pf8, &g_pf565, &g_pf888, &g_pfX888 })
+	{
+		checkStretchedBlts(*pf, false, false);
+	}
+}
+
+TEST(stretchedBltWithSrcColorKeyMatchesReference)
+{
+	std::srand(9);
+	for (const DDPIXELFORMAT* pf : { &g_pf8, &g_pf565, &g_pf888, &g_pfX888 })
+	{
+		checkStretchedBlts(*pf, false, true);
+	}
+}
+
+TEST(arithStretchYBltMatchesReference)
+{
+	std::srand(10);
+	for (const DDPIXELFORMAT* pf : { &g_pf565, &g_pf888, &g_pfX888, &g_pfA888 })
+	{
+		checkStretchedBlts(*pf, true, false);
+		checkStretchedBlts(*pf, true, true);
+	}
+}
+
+namespace
+{
+	// Covers unaligned rows of every width, and a fill large enough to bypass the cache
+	void checkColorFills(DWORD bytesPerPixel)
+	{
+		for (int i = 0; i < 300; ++i)
+		{
+			const LONG width = 0 == i ? 512 : 40;
+			const LONG height = 0 == i ? 300 : 40;
+			Surface dst(width, height, bytesPerPixel);
+			fillRandom(dst);
+
+			const RECT rect = 0 == i ? RECT{ 0, 0, width, height } : getRandomRect(width, height);
+			const DWORD color = (static_cast<DWORD>(std::rand()) << 16) ^ static_cast<DWORD>(std::rand());
+			const DWORD mask = 4 == bytesPerPixel ? 0xFFFFFFFF : (1u << (bytesPerPixel * 8)) - 1;
+
+			Surface expected(dst);
+			for (LONG y = rect.top; y < rect.bottom; ++y)
+			{
+				for (LONG x = rect.left; x < rect.right; ++x)
+				{
+					writePixel(expected, x, y, color & mask);
+				}
+			}
+
+			DDraw::Blitter::colorFill(dst.getImage(), rect, color);
+			CHECK(expected.data == dst.data);
+		}
+	}
+
+	void checkInverts(DWORD bytesPerPixel)
+	{
+		for (int i = 0; i < 300; ++i)
+		{
+			Surface dst(40, 40, bytesPerPixel);
+			fillRandom(dst);
+			const RECT rect = getRandomRect(40, 40);
+
+			Surface expected(dst);
+			const DWORD mask = 4 == bytesPerPixel ? 0xFFFFFFFF : (1u << (bytesPerPixel * 8)) - 1;
+			for (LONG y = rect.top; y < rect.bottom; ++y)
+			{
+				for (LONG x = rect.left; x < rect.right; ++x)
+				{
+					writePixel(expected, x, y, ~readPixel(expected, x, y) & mask);
+				}
+			}
+
+			DDraw::Blitter::invert(dst.getImage(), rect);
+			CHECK(expected.data == dst.data);
+		}
+	}
+}
+
+TEST(colorFillMatchesReference)
+{
+	std::srand(11);
+	for (DWORD bytesPerPixel = 1; bytesPerPixel <= 4; ++bytesPerPixel)
+	{
+		checkColorFills(bytesPerPixel);
+	}
+}
+
+TEST(invertMatchesReference)
+{
+	std::srand(12);
+	for (DWORD bytesPerPixel = 1; bytesPerPixel <= 4; ++bytesPerPixel)
+	{
+		checkInverts(bytesPerPixel);
+	}
+}
+
+TEST(mirroredBltMatchesReference)
+{
+	std::srand(13);
+	for (const DDPIXELFORMAT* pf : { &g_pf8, &g_pf565, &g_pf888, &g_pfX888 })
+	{
+		checkStretchedBlts(*pf, false, false, true, false);
+		checkStretchedBlts(*pf, false, false, false, true);
+		checkStretchedBlts(*pf, false, true, true, true);
+	}
+}
+
+TEST(mirroredArithStretchYBltMatchesReference)
+{
+	std::srand(14);
+	for (const DDPIXELFORMAT* pf : { &g_pf565, &g_pf888, &g_pfA888 })
+	{
+		checkStretchedBlts(*pf, true, false, true, false);
+		checkStretchedBlts(*pf, true, false, false, true);
+		checkStretchedBlts(*pf, true, true, true, true);
+	}
+}
+
+namespace
+{
+	template <typename Op>
+	void checkRopBlts(DWORD rop, Op op)
+	{
+		for (DWORD bytesPerPixel = 1; bytesPerPixel <= 4; ++bytesPerPixel)
+		{
+			for (int i = 0; i < 100; ++i)
+			{
+				Surface src(40, 40, bytesPerPixel);
+				Surface dst(40, 40, bytesPerPixel);
+				fillRandom(src);
+				fillRandom(dst);
+
+				DDraw::Blitter::BltParams params = {};
+				params.srcRect = getRandomRect(20, 20);
+				const LONG left = std::rand() % 20;
+				const LONG top = std::rand() % 20;
+				params.dstRect = { left, top, left + params.srcRect.right - params.srcRect.left,
+					top + params.srcRect.bottom - params.srcRect.top };
+				params.rop = rop;
+
+				Surface expected(dst);
+				for (LONG y = 0; y < params.dstRect.bottom - params.dstRect.top; ++y)
+				{
+					for (LONG x = 0; x < params.dstRect.right - params.dstRect.left; ++x)
+					{
+						const LONG dstX = params.dstRect.left + x;
+						const LONG dstY = params.dstRect.top + y;
+						writePixel(expected, dstX, dstY, op(readPixel(expected, dstX, dstY),
+							readPixel(src, params.srcRect.left + x, params.srcRect.top + y)));
+					}
+				}
+
+				DDraw::Blitter::blt(dst.getImage(), src.getImage(), params);
+				CHECK(expected.data == dst.data);
+			}
+		}
+	}
+}
+
+TEST(ropBltMatchesReference)
+{
+	std::srand(15);
+	checkRopBlts(SRCAND, [](DWORD dst, DWORD src) { return dst & src; });
+	checkRopBlts(SRCPAINT, [](DWORD dst, DWORD src) { return dst | src; });
+	checkRopBlts(SRCINVERT, [](DWORD dst, DWORD src) { return dst ^ src; });
+}
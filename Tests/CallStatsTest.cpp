@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Common/CallStats.h"
+#include "Test.h"
+
+namespace
+{
+	using Compat::CallStats;
+
+	const unsigned int HISTOGRAM_SIZE = CallStats::HISTOGRAM_SIZE;
+
+	unsigned int getHistogramBucketScalar(unsigned long long durationNs)
+	{
+		for (unsigned int i = HISTOGRAM_SIZE - 1; i > 0; --i)
+		{
+			if (durationNs >= 1ull << i)
+			{
+				return i;
+			}
+		}
+		return 0;
+	}
+}
+
+TEST(callStatsSampleEveryIntervalthCall)
+{
+	CallStats stats("sampling");
+	for (unsigned int i = 1; i <= 10 * Config::callSamplingInterval; ++i)
+	{
+		CHECK_EQUAL(0 == i % Config::callSamplingInterval, stats.beginCall());
+	}
+	CHECK_EQUAL(10ull * Config::callSamplingInterval, stats.getCallCount());
+}
+
+TEST(callStatsHistogramBucketsArePowersOfTwo)
+{
+	const unsigned long long durations[] = {
+		0, 1, 2, 3, 4, 7, 8, 1023, 1024, 1025, (1ull << 30) - 1, 1ull << 30, 1ull << 31, 1ull << 40, ~0ull };
+
+	for (auto duration : durations)
+	{
+		CallStats stats("bucket");
+		stats.addSample(duration);
+		const unsigned int bucket = getHistogramBucketScalar(duration);
+		for (unsigned int i = 0; i < HISTOGRAM_SIZE; ++i)
+		{
+			CHECK_EQUAL(i == bucket ? 1u : 0u, stats.getHistogram()[i]);
+		}
+	}
+}
+
+TEST(callStatsPercentilesBoundTheSampledDurations)
+{
+	std::mt19937 rng(5);
+	for (unsigned int round = 0; round < 200; ++round)
+	{
+		CallStats stats("percentile");
+		std::vector<unsigned long long> durations(1 + rng() % 300);
+		for (auto& duration : durations)
+		{
+			duration = rng() >> (rng() % 32);
+			if (0 == round % 10)
+			{
+				duration <<= 8;
+			}
+			stats.addSample(duration);
+		}
+		std::sort(durations.begin(), durations.end());
+
+		for (unsigned int percent : { 1u, 50u, 90u, 99u, 100u })
+		{
+			const std::size_t index = (durations.size() * percent + 99) / 100 - 1;
+			const unsigned long long exact = durations[index];
+			const unsigned long long bound = stats.getPercentileNs(percent);
+			CHECK(exact <= bound);
+			CHECK(bound <= durations.back());
+			if (getHistogramBucketScalar(exact) < HISTOGRAM_SIZE - 1)
+			{
+				CHECK(bound < 2 * std::max(exact, 1ull));
+			}
+		}
+	}
+}
+
+TEST(callStatsReportIsSortedByTotalTime)
+{
+	CallStats* rarelyCalled = CallStats::registerFunc("IDirectDraw7::GetCaps");
+	CallStats* blt = CallStats::registerFunc("IDirectDrawSurface7::Blt");
+	CallStats::registerFunc("IDirectDrawSurface7::Flip");
+
+	for (int i = 0; i < 3; ++i)
+	{
+		rarelyCalled->beginCall();
+	}
+	for (unsigned int i = 0; i < 2 * Config::callSamplingInterval; ++i)
+	{
+		blt->beginCall();
+	}
+	blt->addSample(1000);
+	blt->addSample(2000);
+
+	const auto report = CallStats::getReport();
+	CHECK_EQUAL(3u, report.size());
+	CHECK(report[0] == "COM call statistics (1 in " + std::to_string(Config::callSamplingInterval) + " calls timed):");
+	CHECK(report[1] == "  IDirectDrawSurface7::Blt: " + std::to_string(2 * Config::callSamplingInterval) +
+		" calls, avg 1.5 us, p50 <= 1.0 us, p99 <= 2.0 us");
+	CHECK(report[2] == "  IDirectDraw7::GetCaps: 3 calls");
+}
@@ -0,0 +1,68 @@
+#include "Gdi/DcAttributes.h"
+#include "Test.h"
+
+namespace
+{
+	using Gdi::DcAttributes;
+
+	DcAttributes getDefaultAttributes()
+	{
+		DcAttributes attr = {};
+		attr.font = reinterpret_cast<HGDIOBJ>(1);
+		attr.brush = reinterpret_cast<HGDIOBJ>(2);
+		attr.pen = reinterpret_cast<HGDIOBJ>(3);
+		attr.graphicsMode = GM_COMPATIBLE;
+		attr.mapMode = 1;
+		attr.viewportExt = { 1, 1 };
+		attr.windowExt = { 1, 1 };
+		attr.arcDirection = 1;
+		attr.bkColor = 0xFFFFFF;
+		attr.bkMode = 2;
+		attr.polyFillMode = 1;
+		attr.rop2 = 13;
+		attr.stretchBltMode = 1;
+		return attr;
+	}
+}
+
+TEST(unchangedDcAttributesAreNotApplied)
+{
+	const DcAttributes def = getDefaultAttributes();
+	CHECK_EQUAL(0u, Gdi::getChangedDcAttributes(def, def));
+}
+
+TEST(eachChangedDcAttributeIsReportedOnItsOwn)
+{
+	const DcAttributes def = getDefaultAttributes();
+	DcAttributes attr = def;
+	attr.font = reinterpret_cast<HGDIOBJ>(4);
+	attr.textColor = 0xFF;
+	attr.currentPos = { 10, 20 };
+	CHECK_EQUAL(Gdi::DCA_FONT | Gdi::DCA_TEXTCOLOR | Gdi::DCA_CURRENTPOS, Gdi::getChangedDcAttributes(attr, def));
+
+	attr = def;
+	attr.viewportOrg = { 0, 5 };
+	attr.brushOrg = { 3, 0 };
+	CHECK_EQUAL(Gdi::DCA_VIEWPORTORG | Gdi::DCA_BRUSHORG, Gdi::getChangedDcAttributes(attr, def));
+}
+
+TEST(changedMapModeAlwaysAppliesExtents)
+{
+	const DcAttributes def = getDefaultAttributes();
+	DcAttributes attr = def;
+	attr.mapMode = 8;
+	CHECK_EQUAL(Gdi::DCA_MAPMODE | Gdi::DCA_VIEWPORTEXT | Gdi::DCA_WINDOWEXT, Gdi::getChangedDcAttributes(attr, def));
+
+	attr = def;
+	attr.windowExt = { 640, 480 };
+	CHECK_EQUAL(static_cast<unsigned int>(Gdi::DCA_WINDOWEXT), Gdi::getChangedDcAttributes(attr, def));
+}
+
+TEST(advancedGraphicsModeAlwaysAppliesWorldTransform)
+{
+	const DcAttributes def = getDefaultAttributes();
+	DcAttributes attr = def;
+	attr.graphicsMode = GM_ADVANCED;
+	attr.worldTransform = { 1, 0, 0, 1, 0, 0 };
+	CHECK_EQUAL(static_cast<unsigned int>(Gdi::DCA_WORLDTRANSFORM), Gdi::getChangedDcAttributes(attr, def));
+}
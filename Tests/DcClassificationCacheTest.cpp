@@ -0,0 +1,77 @@
+#include "Gdi/DcClassificationCache.h"
+#include "Test.h"
+
+namespace
+{
+	int g_classifyCount = 0;
+
+	bool isEven(int dc)
+	{
+		++g_classifyCount;
+		return 0 == dc % 2;
+	}
+
+	typedef Gdi::DcClassificationCache<int> DcClassificationCache;
+}
+
+TEST(dcClassificationIsNotCachedOutsideScope)
+{
+	DcClassificationCache cache(&isEven);
+	g_classifyCount = 0;
+	CHECK(cache.classify(2));
+	CHECK(cache.classify(2));
+	CHECK_EQUAL(2, g_classifyCount);
+}
+
+TEST(dcClassificationIsCachedUntilOutermostScopeEnds)
+{
+	DcClassificationCache cache(&isEven);
+	g_classifyCount = 0;
+
+	cache.beginScope();
+	CHECK(cache.classify(2));
+	CHECK(!cache.classify(3));
+	cache.beginScope();
+	CHECK(cache.classify(2));
+	CHECK(!cache.classify(3));
+	cache.endScope();
+	CHECK(!cache.classify(3));
+	CHECK_EQUAL(2, g_classifyCount);
+	cache.endScope();
+
+	// A DC handle reused in a later call is classified again
+	cache.beginScope();
+	CHECK(cache.classify(2));
+	CHECK_EQUAL(3, g_classifyCount);
+	cache.endScope();
+}
+
+TEST(nullDcIsNeverCached)
+{
+	DcClassificationCache cache(&isEven);
+	g_classifyCount = 0;
+	cache.beginScope();
+	cache.classify(0);
+	cache.classify(0);
+	CHECK_EQUAL(2, g_classifyCount);
+	cache.endScope();
+}
+
+TEST(dcsBeyondCacheCapacityAreClassifiedOnEachCall)
+{
+	DcClassificationCache cache(&isEven);
+	g_classifyCount = 0;
+	cache.beginScope();
+	for (int dc = 1; dc <= 10; ++dc)
+	{
+		CHECK_EQUAL(0 == dc % 2, cache.classify(dc));
+	}
+	CHECK_EQUAL(10, g_classifyCount);
+
+	for (int dc = 1; dc <= 10; ++dc)
+	{
+		CHECK_EQUAL(0 == dc % 2, cache.classify(dc));
+	}
+	CHECK_EQUAL(12, g_classifyCount);
+	cache.endScope();
+}
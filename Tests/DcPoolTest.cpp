@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <vector>
+
+#include "Gdi/DcPool.h"
+#include "Test.h"
+
+namespace
+{
+	struct FakeDc
+	{
+		int id;
+		unsigned long epoch;
+		unsigned long paletteGeneration;
+	};
+
+	typedef Gdi::DcPool<FakeDc> DcPool;
+
+	class FakeFactory : public DcPool::Factory
+	{
+	public:
+		FakeFactory() : lastId(0), createLimit(1000), isPaletteUpdateFailing(false) {}
+
+		virtual bool create(FakeDc& cachedDc) override
+		{
+			if (lastId >= createLimit)
+			{
+				return false;
+			}
+			cachedDc.id = ++lastId;
+			return true;
+		}
+
+		virtual void destroy(FakeDc& cachedDc) override
+		{
+			destroyedIds.push_back(cachedDc.id);
+		}
+
+		virtual bool updatePalette(FakeDc& cachedDc) override
+		{
+			updatedPaletteIds.push_back(cachedDc.id);
+			return !isPaletteUpdateFailing;
+		}
+
+		bool isDestroyed(int id) const
+		{
+			return std::find(destroyedIds.begin(), destroyedIds.end(), id) != destroyedIds.end();
+		}
+
+		int lastId;
+		int createLimit;
+		bool isPaletteUpdateFailing;
+		std::vector<int> destroyedIds;
+		std::vector<int> updatedPaletteIds;
+	};
+
+	const unsigned int BATCH_SIZE = 4;
+}
+
+TEST(dcPoolCreatesBatchOnlyWhenAllowed)
+{
+	FakeFactory factory;
+	DcPool pool(factory, BATCH_SIZE);
+	FakeDc dc = {};
+
+	CHECK(!pool.get(dc, false));
+	CHECK_EQUAL(1u, pool.getMissedCount());
+	CHECK_EQUAL(0, factory.lastId);
+
+	CHECK(pool.get(dc, true));
+	CHECK_EQUAL(4, factory.lastId);
+	CHECK_EQUAL(4u, pool.getCreatedCount());
+	CHECK_EQUAL(1u, pool.getUsedCount());
+	CHECK_EQUAL(0ul, dc.epoch);
+}
+
+TEST(dcPoolRefillsWhenHalfEmpty)
+{
+	FakeFactory factory;
+	DcPool pool(factory, BATCH_SIZE);
+	FakeDc dcs[4] = {};
+
+	CHECK(pool.get(dcs[0], true));
+	CHECK(pool.get(dcs[1], true));
+	CHECK_EQUAL(4, factory.lastId);
+
+	// 2 of 4 free DCs left, which is half a batch
+	CHECK(pool.get(dcs[2], true));
+	CHECK_EQUAL(8, factory.lastId);
+	CHECK_EQUAL(3u, pool.getUsedCount());
+
+	// Threads that cannot create DCs use the free DCs left by the refill
+	CHECK(pool.get(dcs[3], false));
+	CHECK_EQUAL(8, factory.lastId);
+	CHECK_EQUAL(0u, pool.getMissedCount());
+}
+
+TEST(dcPoolMissesWhenCreationFails)
+{
+	FakeFactory factory;
+	factory.createLimit = 1;
+	DcPool pool(factory, BATCH_SIZE);
+	FakeDc dcs[2] = {};
+
+	CHECK(pool.get(dcs[0], true));
+	CHECK(!pool.get(dcs[1], true));
+	CHECK_EQUAL(1u, pool.getCreatedCount());
+	CHECK_EQUAL(1u, pool.getMissedCount());
+
+	pool.release(dcs[0]);
+	CHECK(pool.get(dcs[1], false));
+	CHECK_EQUAL(dcs[0].id, dcs[1].id);
+}
+
+TEST(dcPoolClearInvalidatesDcsInUse)
+{
+	FakeFactory factory;
+	DcPool pool(factory, BATCH_SIZE);
+	FakeDc usedDc = {};
+	CHECK(pool.get(usedDc, true));
+
+	pool.clear();
+	CHECK_EQUAL(1ul, pool.getEpoch());
+	CHECK_EQUAL(3u, factory.destroyedIds.size());
+	CHECK(!factory.isDestroyed(usedDc.id));
+	CHECK_EQUAL(0u, pool.getUsedCount());
+
+	// The DC from the old epoch is destroyed on release instead of being reused
+	pool.release(usedDc);
+	CHECK(factory.isDestroyed(usedDc.id));
+	FakeDc newDc = {};
+	CHECK(!pool.get(newDc, false));
+
+	CHECK(pool.get(newDc, true));
+	CHECK_EQUAL(1ul, newDc.epoch);
+	CHECK(newDc.id > usedDc.id);
+	pool.release(newDc);
+	CHECK(!factory.isDestroyed(newDc.id));
+	CHECK_EQUAL(0u, pool.getUsedCount());
+}
+
+TEST(dcPoolUpdatesPaletteOnlyOfReusedStaleDcs)
+{
+	FakeFactory factory;
+	DcPool pool(factory, BATCH_SIZE);
+	FakeDc dc = {};
+	CHECK(pool.get(dc, true));
+	pool.release(dc);
+
+	pool.invalidatePalette();
+	pool.invalidatePalette();
+	CHECK(factory.updatedPaletteIds.empty());
+
+	CHECK(pool.get(dc, true));
+	CHECK_EQUAL(1u, factory.updatedPaletteIds.size());
+	CHECK_EQUAL(dc.id, factory.updatedPaletteIds.back());
+	CHECK_EQUAL(2ul, dc.paletteGeneration);
+
+	// DCs that are already up to date are not updated again
+	pool.release(dc);
+	CHECK(pool.get(dc, false));
+	CHECK_EQUAL(1u, factory.updatedPaletteIds.size());
+
+	// The refill creates DCs with the current palette
+	FakeDc dcs[2] = {};
+	CHECK(pool.get(dcs[0], true));
+	CHECK_EQUAL(2u, factory.updatedPaletteIds.size());
+	CHECK(pool.get(dcs[1], true));
+	CHECK_EQUAL(8, dcs[1].id);
+	CHECK_EQUAL(2ul, dcs[1].paletteGeneration);
+	CHECK_EQUAL(2u, factory.updatedPaletteIds.size());
+}
+
+TEST(dcPoolDestroysDcsFailingPaletteUpdate)
+{
+	FakeFactory factory;
+	DcPool pool(factory, BATCH_SIZE);
+	FakeDc dc = {};
+	CHECK(pool.get(dc, true));
+	pool.release(dc);
+
+	pool.invalidatePalette();
+	factory.isPaletteUpdateFailing = true;
+	CHECK(!pool.get(dc, false));
+	CHECK_EQUAL(4u, factory.destroyedIds.size());
+	CHECK_EQUAL(1u, pool.getMissedCount());
+	CHECK_EQUAL(0u, pool.getUsedCount());
+
+	factory.isPaletteUpdateFailing = false;
+	CHECK(pool.get(dc, true));
+	CHECK(dc.id > 4);
+	CHECK_EQUAL(1u, pool.getUsedCount());
+}
@@ -0,0 +1,103 @@
+#include <atomic>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "Gdi/DcReverseMap.h"
+#include "Test.h"
+
+namespace
+{
+	std::atomic<int> g_lockCount(0);
+
+	class SharedMutexLockPolicy
+	{
+	public:
+		void lock() { ++g_lockCount; m_mutex.lock(); }
+		void unlock() { m_mutex.unlock(); }
+		void lockShared() { ++g_lockCount; m_mutex.lock_shared(); }
+		void unlockShared() { m_mutex.unlock_shared(); }
+
+	private:
+		std::shared_timed_mutex m_mutex;
+	};
+
+	typedef Gdi::DcReverseMap<int, SharedMutexLockPolicy> DcReverseMap;
+}
+
+TEST(dcReverseMapReturnsOrigDcOfMappedDcsOnly)
+{
+	DcReverseMap map;
+	map.add(10, 1);
+	map.add(20, 2);
+	CHECK_EQUAL(1, map.getOrigDc(10));
+	CHECK_EQUAL(2, map.getOrigDc(20));
+	CHECK_EQUAL(30, map.getOrigDc(30));
+	CHECK_EQUAL(2u, map.getCount());
+
+	map.remove(10);
+	CHECK_EQUAL(10, map.getOrigDc(10));
+	CHECK_EQUAL(2, map.getOrigDc(20));
+	CHECK_EQUAL(1u, map.getCount());
+}
+
+TEST(dcReverseMapLookupSkipsLockWhileEmpty)
+{
+	DcReverseMap map;
+	g_lockCount = 0;
+	CHECK_EQUAL(5, map.getOrigDc(5));
+	CHECK_EQUAL(0, g_lockCount);
+
+	map.add(10, 1);
+	map.remove(10);
+	g_lockCount = 0;
+	CHECK_EQUAL(10, map.getOrigDc(10));
+	CHECK_EQUAL(0, g_lockCount);
+
+	map.add(10, 1);
+	g_lockCount = 0;
+	CHECK_EQUAL(5, map.getOrigDc(5));
+	CHECK_EQUAL(1, g_lockCount);
+}
+
+TEST(dcReverseMapLookupsRaceWithUpdates)
+{
+	DcReverseMap map;
+	map.add(1000, 1);
+	std::atomic<bool> isDone(false);
+	std::atomic<int> errorCount(0);
+
+	std::vector<std::thread> readers;
+	for (int i = 0; i < 4; ++i)
+	{
+		readers.emplace_back([&]()
+		{
+			while (!isDone)
+			{
+				if (1 != map.getOrigDc(1000))
+				{
+					++errorCount;
+				}
+				const int dc = map.getOrigDc(2000);
+				if (2000 != dc && 2 != dc)
+				{
+					++errorCount;
+				}
+			}
+		});
+	}
+
+	for (int i = 0; i < 10000; ++i)
+	{
+		map.add(2000, 2);
+		map.remove(2000);
+	}
+	isDone = true;
+	for (auto& reader : readers)
+	{
+		reader.join();
+	}
+
+	CHECK_EQUAL(0, errorCount);
+	CHECK_EQUAL(1u, map.getCount());
+}
@@ -0,0 +1,149 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "Common/DeferredInstallation.h"
+#include "Test.h"
+
+namespace
+{
+	using Compat::DeferredInstallation;
+
+	class StubInstaller : public DeferredInstallation::Installer
+	{
+	public:
+		StubInstaller(bool isSuccessful = true)
+			: installation(nullptr)
+			, installCount(0)
+			, isSuccessful(isSuccessful)
+			, isReentrant(false)
+			, isStarted(false)
+			, isReleased(true)
+		{
+		}
+
+		virtual bool install() override
+		{
+			++installCount;
+			isStarted = true;
+			if (isReentrant)
+			{
+				// Like the QueryInterface calls on the objects created while hooking
+				installation->run();
+				stateDuringReentrantRun = installation->getState();
+			}
+			while (!isReleased)
+			{
+				std::this_thread::yield();
+			}
+			return isSuccessful;
+		}
+
+		DeferredInstallation* installation;
+		std::atomic<int> installCount;
+		bool isSuccessful;
+		bool isReentrant;
+		DeferredInstallation::State stateDuringReentrantRun;
+		std::atomic<bool> isStarted;
+		std::atomic<bool> isReleased;
+	};
+}
+
+TEST(deferredInstallationRunsInstallerOnFirstUseOnly)
+{
+	StubInstaller installer;
+	DeferredInstallation installation(installer);
+	CHECK(DeferredInstallation::State::NOT_INSTALLED == installation.getState());
+	CHECK_EQUAL(0, installer.installCount);
+
+	installation.run();
+	CHECK(DeferredInstallation::State::INSTALLED == installation.getState());
+	installation.run();
+	CHECK_EQUAL(1, installer.installCount);
+}
+
+TEST(failedDeferredInstallationIsNotRetried)
+{
+	StubInstaller installer(false);
+	DeferredInstallation installation(installer);
+
+	installation.run();
+	CHECK(DeferredInstallation::State::FAILED == installation.getState());
+	installation.run();
+	CHECK_EQUAL(1, installer.installCount);
+}
+
+TEST(reentrantDeferredInstallationReturnsImmediately)
+{
+	StubInstaller installer;
+	DeferredInstallation installation(installer);
+	installer.installation = &installation;
+	installer.isReentrant = true;
+
+	installation.run();
+	CHECK(DeferredInstallation::State::INSTALLING == installer.stateDuringReentrantRun);
+	CHECK(DeferredInstallation::State::INSTALLED == installation.getState());
+	CHECK_EQUAL(1, installer.installCount);
+}
+
+TEST(concurrentDeferredInstallationWaitsForInstaller)
+{
+	StubInstaller installer;
+	DeferredInstallation installation(installer);
+	installer.isReleased = false;
+
+	std::thread installingThread([&]() { installation.run(); });
+	while (!installer.isStarted)
+	{
+		std::this_thread::yield();
+	}
+
+	std::atomic<bool> isWaitingThreadDone(false);
+	DeferredInstallation::State stateAfterWait = DeferredInstallation::State::NOT_INSTALLED;
+	std::thread waitingThread([&]()
+	{
+		installation.run();
+		stateAfterWait = installation.getState();
+		isWaitingThreadDone = true;
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	const bool isDoneBeforeRelease = isWaitingThreadDone;
+	installer.isReleased = true;
+	installingThread.join();
+	waitingThread.join();
+
+	CHECK(!isDoneBeforeRelease);
+	CHECK(DeferredInstallation::State::INSTALLED == stateAfterWait);
+	CHECK_EQUAL(1, installer.installCount);
+}
+
+TEST(racingDeferredInstallationsRunInstallerOnce)
+{
+	for (int i = 0; i < 100; ++i)
+	{
+		StubInstaller installer;
+		DeferredInstallation installation(installer);
+		std::atomic<int> installedCount(0);
+
+		std::thread threads[4];
+		for (auto& thread : threads)
+		{
+			thread = std::thread([&]()
+			{
+				installation.run();
+				if (DeferredInstallation::State::INSTALLED == installation.getState())
+				{
+					++installedCount;
+				}
+			});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		CHECK_EQUAL(1, installer.installCount);
+		CHECK_EQUAL(4, installedCount);
+	}
+}
@@ -0,0 +1,84 @@
+#include "Gdi/DirtyRect.h"
+#include "Test.h"
+
+namespace
+{
+	using Gdi::DirtyRect;
+
+	// Shim for LPtoDP with a mapping mode that flips the y axis and offsets the origin
+	struct LpToDp
+	{
+		void operator()(RECT& rect) const
+		{
+			++callCount;
+			rect = { rect.left + 100, -rect.top, rect.right + 100, -rect.bottom };
+		}
+
+		int& callCount;
+	};
+
+	bool isEqual(const RECT& rect, LONG left, LONG top, LONG right, LONG bottom)
+	{
+		return rect.left == left && rect.top == top && rect.right == right && rect.bottom == bottom;
+	}
+}
+
+TEST(dcBoundsAreConvertedToNormalizedDeviceRect)
+{
+	int callCount = 0;
+	RECT bounds = { 10, 20, 30, 40 };
+	const RECT* rect = DirtyRect::getBoundsRect(DCB_SET, bounds, false, LpToDp{ callCount });
+	CHECK(rect == &bounds);
+	CHECK(isEqual(*rect, 110, -40, 130, -20));
+	CHECK_EQUAL(1, callCount);
+}
+
+TEST(missingDcBoundsMarkWholeSurfaceDirty)
+{
+	int callCount = 0;
+	RECT bounds = {};
+	// DCB_RESET alone means that GDI accumulated no bounds, even though the DC was written to
+	CHECK(!DirtyRect::getBoundsRect(DCB_RESET, bounds, false, LpToDp{ callCount }));
+	CHECK(!DirtyRect::getBoundsRect(DCB_ACCUMULATE, bounds, false, LpToDp{ callCount }));
+	CHECK(!DirtyRect::getBoundsRect(0, bounds, false, LpToDp{ callCount }));
+
+	bounds = { 10, 20, 30, 40 };
+	CHECK(!DirtyRect::getBoundsRect(DCB_SET, bounds, true, LpToDp{ callCount }));
+	CHECK_EQUAL(0, callCount);
+}
+
+TEST(dirtyRectsAreMergedUntilTaken)
+{
+	DirtyRect dirtyRect;
+	RECT rect = { 1, 2, 3, 4 };
+	const RECT* taken = dirtyRect.take(rect);
+	CHECK(taken == &rect);
+	CHECK(IsRectEmpty(&rect));
+
+	const RECT rect1 = { 10, 10, 20, 20 };
+	const RECT rect2 = { 15, 5, 30, 12 };
+	const RECT emptyRect = { 0, 0, 0, 50 };
+	dirtyRect.add(&rect1);
+	dirtyRect.add(&emptyRect);
+	dirtyRect.add(&rect2);
+	taken = dirtyRect.take(rect);
+	CHECK(taken == &rect);
+	CHECK(isEqual(rect, 10, 5, 30, 20));
+
+	taken = dirtyRect.take(rect);
+	CHECK(IsRectEmpty(&rect));
+}
+
+TEST(wholeSurfaceStaysDirtyUntilTaken)
+{
+	DirtyRect dirtyRect;
+	const RECT rect1 = { 10, 10, 20, 20 };
+	dirtyRect.add(&rect1);
+	dirtyRect.add(nullptr);
+	dirtyRect.add(&rect1);
+
+	RECT rect = {};
+	CHECK(!dirtyRect.take(rect));
+	CHECK(dirtyRect.take(rect) == &rect);
+	CHECK(IsRectEmpty(&rect));
+}
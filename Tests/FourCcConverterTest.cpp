@@ -0,0 +1,296 @@
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "DDraw/FourCcConverter.h"
+#include "Test.h"
+
+namespace
+{
+	using DDraw::FourCcConverter::Image;
+
+	struct Yuv
+	{
+		int y;
+		int u;
+		int v;
+	};
+
+	struct YuvImage
+	{
+		DWORD fourCc;
+		LONG width;
+		LONG height;
+		LONG pitch;
+		std::vector<BYTE> data;
+
+		YuvImage(DWORD fourCc, LONG width, LONG height)
+			: fourCc(fourCc)
+			, width(width)
+			, height(height)
+			, pitch(isPacked() ? width * 2 + 4 : width + 4)
+			, data(isPacked() ? pitch * height : pitch * height + 2 * (pitch / 2) * (height / 2))
+		{
+		}
+
+		bool isPacked() const
+		{
+			return MAKEFOURCC('Y', 'U', 'Y', '2') == fourCc || MAKEFOURCC('U', 'Y', 'V', 'Y') == fourCc;
+		}
+
+		// Returns the offsets of the Y, U and V components of a pixel, independently of the converter
+		void getOffsets(LONG x, LONG y, std::size_t& yOffset, std::size_t& uOffset, std::size_t& vOffset) const
+		{
+			if (isPacked())
+			{
+				const std::size_t pair = y * pitch + (x / 2) * 4;
+				const bool isYuy2 = MAKEFOURCC('Y', 'U', 'Y', '2') == fourCc;
+				yOffset = pair + (isYuy2 ? 0 : 1) + (x % 2) * 2;
+				uOffset = pair + (isYuy2 ? 1 : 0);
+				vOffset = pair + (isYuy2 ? 3 : 2);
+				return;
+			}
+
+			const std::size_t chromaPlaneSize = (pitch / 2) * (height / 2);
+			const std::size_t firstChromaPlane = pitch * height;
+			const std::size_t chromaOffset = (y / 2) * (pitch / 2) + x / 2;
+			const bool isVFirst = MAKEFOURCC('Y', 'V', '1', '2') == fourCc;
+			yOffset = y * pitch + x;
+			uOffset = firstChromaPlane + (isVFirst ? chromaPlaneSize : 0) + chromaOffset;
+			vOffset = firstChromaPlane + (isVFirst ? 0 : chromaPlaneSize) + chromaOffset;
+		}
+
+		Yuv get(LONG x, LONG y) const
+		{
+			std::size_t yOffset = 0;
+			std::size_t uOffset = 0;
+			std::size_t vOffset = 0;
+			getOffsets(x, y, yOffset, uOffset, vOffset);
+			return { data[yOffset], data[uOffset], data[vOffset] };
+		}
+
+		void set(LONG x, LONG y, const Yuv& yuv)
+		{
+			std::size_t yOffset = 0;
+			std::size_t uOffset = 0;
+			std::size_t vOffset = 0;
+			getOffsets(x, y, yOffset, uOffset, vOffset);
+			data[yOffset] = static_cast<BYTE>(yuv.y);
+			data[uOffset] = static_cast<BYTE>(yuv.u);
+			data[vOffset] = static_cast<BYTE>(yuv.v);
+		}
+
+		void fillRandom()
+		{
+			for (auto& value : data)
+			{
+				value = static_cast<BYTE>(std::rand());
+			}
+		}
+
+		DDPIXELFORMAT getPf() const
+		{
+			DDPIXELFORMAT pf = {};
+			pf.dwSize = sizeof(pf);
+			pf.dwFlags = DDPF_FOURCC;
+			pf.dwFourCC = fourCc;
+			return pf;
+		}
+
+		Image getImage()
+		{
+			return { data.data(), pitch, static_cast<DWORD>(width), static_cast<DWORD>(height) };
+		}
+	};
+
+	struct RgbImage
+	{
+		LONG width;
+		LONG height;
+		DDPIXELFORMAT pf;
+		std::vector<BYTE> data;
+
+		RgbImage(LONG width, LONG height, DWORD bitCount, DWORD rMask, DWORD gMask, DWORD bMask)
+			: width(width)
+			, height(height)
+			, pf()
+			, data(width * height * bitCount / 8, 0xCD)
+		{
+			pf.dwSize = sizeof(pf);
+			pf.dwFlags = DDPF_RGB;
+			pf.dwRGBBitCount = bitCount;
+			pf.dwRBitMask = rMask;
+			pf.dwGBitMask = gMask;
+			pf.dwBBitMask = bMask;
+		}
+
+		DWORD get(LONG x, LONG y) const
+		{
+			const BYTE* pixel = &data[(y * width + x) * pf.dwRGBBitCount / 8];
+			DWORD value = 0;
+			for (DWORD i = 0; i < pf.dwRGBBitCount / 8; ++i)
+			{
+				value |= static_cast<DWORD>(pixel[i]) << (i * 8);
+			}
+			return value;
+		}
+
+		Image getImage()
+		{
+			return { data.data(), static_cast<LONG>(width * pf.dwRGBBitCount / 8),
+				static_cast<DWORD>(width), static_cast<DWORD>(height) };
+		}
+	};
+
+	struct Rgb
+	{
+		int r;
+		int g;
+		int b;
+	};
+
+	int clampRound(double value)
+	{
+		const int result = static_cast<int>(std::floor(value + 0.5));
+		return result < 0 ? 0 : (result > 255 ? 255 : result);
+	}
+
+	// Limited range Y'CbCr to full range R'G'B' as defined by BT.601 and BT.709
+	Rgb convertReference(const Yuv& yuv, bool isBt709)
+	{
+		const double kr = isBt709 ? 0.2126 : 0.299;
+		const double kb = isBt709 ? 0.0722 : 0.114;
+		const double kg = 1 - kr - kb;
+		const double y = (yuv.y - 16) * 255.0 / 219;
+		const double u = (yuv.u - 128) * 255.0 / 112;
+		const double v = (yuv.v - 128) * 255.0 / 112;
+		return {
+			clampRound(y + (1 - kr) * v),
+			clampRound(y - (1 - kb) * kb / kg * u - (1 - kr) * kr / kg * v),
+			clampRound(y + (1 - kb) * u) };
+	}
+
+	bool isNear(int expected, int actual, int tolerance)
+	{
+		return std::abs(expected - actual) <= tolerance;
+	}
+
+	const DWORD FOURCCS[] = {
+		MAKEFOURCC('Y', 'U', 'Y', '2'),
+		MAKEFOURCC('U', 'Y', 'V', 'Y'),
+		MAKEFOURCC('Y', 'V', '1', '2'),
+		MAKEFOURCC('I', '4', '2', '0'),
+		MAKEFOURCC('I', 'Y', 'U', 'V')
+	};
+
+	// Converts srcRect to dstRect both with the SSE2 path (XRGB8888) and the scalar path (XBGR8888),
+	// and checks that they agree and match the reference conversion of the nearest source pixels
+	void checkConversion(YuvImage& src, const RECT& srcRect, const RECT& dstRect, bool isBt709)
+	{
+		RgbImage xrgb(dstRect.right, dstRect.bottom, 32, 0xFF0000, 0xFF00, 0xFF);
+		RgbImage xbgr(dstRect.right, dstRect.bottom, 32, 0xFF, 0xFF00, 0xFF0000);
+		DDraw::FourCcConverter::convert(src.getPf(), src.getImage(), srcRect, xrgb.pf, xrgb.getImage(), dstRect);
+		DDraw::FourCcConverter::convert(src.getPf(), src.getImage(), srcRect, xbgr.pf, xbgr.getImage(), dstRect);
+
+		// Nearest neighbor sampling with 16.16 fixed point steps, as documented by the converter
+		const LONG dstWidth = dstRect.right - dstRect.left;
+		const LONG dstHeight = dstRect.bottom - dstRect.top;
+		const LONG stepX = ((srcRect.right - srcRect.left) << 16) / dstWidth;
+		const LONG stepY = ((srcRect.bottom - srcRect.top) << 16) / dstHeight;
+		for (LONG y = 0; y < dstHeight; ++y)
+		{
+			const LONG srcY = ((srcRect.top << 16) + stepY / 2 + y * stepY) >> 16;
+			for (LONG x = 0; x < dstWidth; ++x)
+			{
+				const LONG srcX = ((srcRect.left << 16) + stepX / 2 + x * stepX) >> 16;
+				const DWORD pixel = xrgb.get(dstRect.left + x, dstRect.top + y);
+				const DWORD swapped = xbgr.get(dstRect.left + x, dstRect.top + y);
+				CHECK_EQUAL(pixel, ((swapped & 0xFF) << 16) | (swapped & 0xFF00) | ((swapped >> 16) & 0xFF));
+
+				const Rgb expected = convertReference(src.get(srcX, srcY), isBt709);
+				CHECK(isNear(expected.r, (pixel >> 16) & 0xFF, 1));
+				CHECK(isNear(expected.g, (pixel >> 8) & 0xFF, 1));
+				CHECK(isNear(expected.b, pixel & 0xFF, 1));
+			}
+		}
+	}
+}
+
+TEST(fourCcConversionOfAllYuvValuesMatchesReference)
+{
+	for (int u = 0; u < 256; ++u)
+	{
+		YuvImage src(MAKEFOURCC('Y', 'U', 'Y', '2'), 512, 256);
+		for (int v = 0; v < 256; ++v)
+		{
+			for (int y = 0; y < 256; ++y)
+			{
+				src.set(2 * y, v, { y, u, v });
+				src.set(2 * y + 1, v, { 255 - y, u, v });
+			}
+		}
+
+		const RECT rect = { 0, 0, 512, 256 };
+		checkConversion(src, rect, rect, false);
+	}
+}
+
+TEST(fourCcConversionWithoutScalingMatchesReference)
+{
+	std::srand(1);
+	for (DWORD fourCc : FOURCCS)
+	{
+		YuvImage src(fourCc, 38, 10);
+		src.fillRandom();
+
+		const RECT fullRect = { 0, 0, 38, 10 };
+		checkConversion(src, fullRect, fullRect, false);
+
+		const RECT srcRect = { 3, 1, 36, 9 };
+		const RECT dstRect = { 5, 2, 38, 10 };
+		checkConversion(src, srcRect, dstRect, false);
+	}
+}
+
+TEST(fourCcConversionWithScalingMatchesReference)
+{
+	std::srand(2);
+	for (DWORD fourCc : FOURCCS)
+	{
+		YuvImage src(fourCc, 38, 10);
+		src.fillRandom();
+		checkConversion(src, { 3, 1, 35, 9 }, { 1, 0, 51, 13 }, false);
+		checkConversion(src, { 0, 0, 38, 10 }, { 2, 3, 17, 7 }, false);
+	}
+}
+
+TEST(fourCcConversionUsesBt709ForHdSources)
+{
+	std::srand(3);
+	YuvImage src(MAKEFOURCC('Y', 'V', '1', '2'), 24, 720);
+	src.fillRandom();
+	checkConversion(src, { 0, 0, 24, 720 }, { 0, 0, 24, 720 }, true);
+}
+
+TEST(fourCcConversionTo16BitMatchesReference)
+{
+	std::srand(4);
+	YuvImage src(MAKEFOURCC('U', 'Y', 'V', 'Y'), 38, 10);
+	src.fillRandom();
+
+	RgbImage rgb565(38, 10, 16, 0xF800, 0x07E0, 0x001F);
+	const RECT rect = { 0, 0, 38, 10 };
+	DDraw::FourCcConverter::convert(src.getPf(), src.getImage(), rect, rgb565.pf, rgb565.getImage(), rect);
+
+	for (LONG y = 0; y < 10; ++y)
+	{
+		for (LONG x = 0; x < 38; ++x)
+		{
+			const Rgb expected = convertReference(src.get(x, y), false);
+			const DWORD pixel = rgb565.get(x, y);
+			CHECK(isNear(expected.r >> 3, pixel >> 11, 1));
+			CHECK(isNear(expected.g >> 2, (pixel >> 5) & 0x3F, 1));
+			CHECK(isNear(expected.b >> 3, pixel & 0x1F, 1));
+		}
+	}
+}
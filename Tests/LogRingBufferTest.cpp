@@ -0,0 +1,214 @@
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Common/LogRingBuffer.h"
+#include "Test.h"
+
+namespace
+{
+	using Compat::LogRingBuffer;
+
+	const std::uint32_t MAX_DATA_SIZE = LogRingBuffer::MAX_RECORD_DATA_SIZE;
+
+	LogRingBuffer::RecordHeader createHeader(long long qpc, std::uint32_t threadId, std::uint32_t size)
+	{
+		LogRingBuffer::RecordHeader header = {};
+		header.qpc = qpc;
+		header.threadId = threadId;
+		header.size = size;
+		return header;
+	}
+
+	std::string createText(std::uint32_t size, unsigned int seed)
+	{
+		std::string text(size, '\0');
+		for (std::uint32_t i = 0; i < size; ++i)
+		{
+			text[i] = static_cast<char>('a' + (seed + i) % 26);
+		}
+		return text;
+	}
+
+	bool pushText(LogRingBuffer& buffer, long long qpc, const std::string& text)
+	{
+		auto header = createHeader(qpc, 1, 0);
+		return Compat::pushLogText(text, [&](const char* data, std::uint32_t size)
+		{
+			header.size = size;
+			return buffer.push(header, data);
+		});
+	}
+}
+
+TEST(logRingBufferPreservesRecordsAcrossWraparound)
+{
+	std::unique_ptr<LogRingBuffer> buffer(new LogRingBuffer());
+	std::vector<LogRingBuffer::Record> records;
+	long long qpc = 0;
+	long long drainedQpc = 0;
+
+	// Odd record sizes make the headers and data straddle the end of the buffer at varying offsets
+	for (unsigned int round = 0; round < 200; ++round)
+	{
+		for (unsigned int i = 0; i < 7; ++i)
+		{
+			const std::uint32_t size = (round * 7 + i) * 1237 % 5000;
+			const std::string text = createText(size, static_cast<unsigned int>(qpc));
+			CHECK(buffer->push(createHeader(qpc, static_cast<std::uint32_t>(qpc % 3), size), text.data()));
+			++qpc;
+		}
+
+		records.clear();
+		buffer->drain(records);
+		CHECK(buffer->isEmpty());
+		for (const auto& record : records)
+		{
+			CHECK_EQUAL(drainedQpc, record.qpc);
+			CHECK_EQUAL(static_cast<std::uint32_t>(drainedQpc % 3), record.threadId);
+			CHECK(!record.traceFuncName);
+			const std::uint32_t size = static_cast<std::uint32_t>(drainedQpc * 1237 % 5000);
+			CHECK(createText(size, static_cast<unsigned int>(drainedQpc)) == record.data);
+			++drainedQpc;
+		}
+	}
+	CHECK_EQUAL(qpc, drainedQpc);
+	CHECK_EQUAL(0u, buffer->takeDroppedCount());
+}
+
+TEST(fullLogRingBufferDropsRecords)
+{
+	std::unique_ptr<LogRingBuffer> buffer(new LogRingBuffer());
+	const std::string text = createText(MAX_DATA_SIZE, 0);
+
+	unsigned int pushedCount = 0;
+	while (buffer->push(createHeader(pushedCount, 1, MAX_DATA_SIZE), text.data()))
+	{
+		++pushedCount;
+	}
+	CHECK_EQUAL(4u, pushedCount);
+	CHECK_EQUAL(LogRingBuffer::SIZE, buffer->getUsedSize());
+	CHECK(!buffer->push(createHeader(0, 1, 0), nullptr));
+	CHECK_EQUAL(2u, buffer->takeDroppedCount());
+	CHECK_EQUAL(0u, buffer->takeDroppedCount());
+
+	std::vector<LogRingBuffer::Record> records;
+	buffer->drain(records);
+	CHECK_EQUAL(4u, records.size());
+	CHECK(buffer->push(createHeader(4, 1, MAX_DATA_SIZE), text.data()));
+}
+
+TEST(longLogTextIsSplitIntoRecords)
+{
+	std::unique_ptr<LogRingBuffer> buffer(new LogRingBuffer());
+	const std::string text = createText(MAX_DATA_SIZE * 2 + MAX_DATA_SIZE / 2, 5);
+	CHECK(pushText(*buffer, 7, text));
+
+	std::vector<LogRingBuffer::Record> records;
+	buffer->drain(records);
+	CHECK_EQUAL(3u, records.size());
+	CHECK_EQUAL(MAX_DATA_SIZE, records[0].data.size());
+	CHECK_EQUAL(MAX_DATA_SIZE, records[1].data.size());
+	CHECK_EQUAL(MAX_DATA_SIZE / 2, records[2].data.size());
+	CHECK(text == records[0].data + records[1].data + records[2].data);
+	for (const auto& record : records)
+	{
+		CHECK_EQUAL(7, record.qpc);
+	}
+}
+
+TEST(shortLogTextIsSingleRecord)
+{
+	std::unique_ptr<LogRingBuffer> buffer(new LogRingBuffer());
+	CHECK(pushText(*buffer, 0, std::string()));
+	CHECK(pushText(*buffer, 1, createText(MAX_DATA_SIZE, 0)));
+
+	std::vector<LogRingBuffer::Record> records;
+	buffer->drain(records);
+	CHECK_EQUAL(2u, records.size());
+	CHECK(records[0].data.empty());
+	CHECK_EQUAL(MAX_DATA_SIZE, records[1].data.size());
+}
+
+TEST(logTextSplittingStopsAtFullBuffer)
+{
+	std::unique_ptr<LogRingBuffer> buffer(new LogRingBuffer());
+	const std::string text = createText(MAX_DATA_SIZE * 6, 0);
+	CHECK(!pushText(*buffer, 0, text));
+	CHECK_EQUAL(1u, buffer->takeDroppedCount());
+
+	std::vector<LogRingBuffer::Record> records;
+	buffer->drain(records);
+	CHECK_EQUAL(4u, records.size());
+	CHECK(text.substr(0, MAX_DATA_SIZE * 4) ==
+		records[0].data + records[1].data + records[2].data + records[3].data);
+}
+
+TEST(logRingBuffersAreDrainedInTimeOrder)
+{
+	const unsigned int producerCount = 4;
+	const unsigned int recordCount = 20000;
+	std::vector<std::unique_ptr<LogRingBuffer>> buffers;
+	std::vector<LogRingBuffer*> bufferPtrs;
+	for (unsigned int i = 0; i < producerCount; ++i)
+	{
+		buffers.emplace_back(new LogRingBuffer());
+		bufferPtrs.push_back(buffers.back().get());
+	}
+
+	std::atomic<long long> clock(0);
+	std::atomic<unsigned int> runningProducerCount(producerCount);
+	std::vector<std::thread> producers;
+	for (unsigned int i = 0; i < producerCount; ++i)
+	{
+		producers.emplace_back([&, i]()
+		{
+			for (unsigned int j = 0; j < recordCount; ++j)
+			{
+				const std::string text = std::to_string(j);
+				const auto header = createHeader(clock++, i, static_cast<std::uint32_t>(text.size()));
+				while (!buffers[i]->push(header, text.data()))
+				{
+					std::this_thread::yield();
+				}
+			}
+			--runningProducerCount;
+		});
+	}
+
+	std::vector<unsigned int> nextIndexes(producerCount, 0);
+	bool isOrdered = true;
+	bool isComplete = false;
+	while (!isComplete)
+	{
+		isComplete = 0 == runningProducerCount;
+		std::vector<LogRingBuffer::Record> records;
+		std::uint32_t droppedCount = 0;
+		Compat::drainLogRingBuffers(bufferPtrs, records, droppedCount);
+
+		for (std::size_t i = 0; i < records.size(); ++i)
+		{
+			const auto& record = records[i];
+			if ((0 != i && record.qpc < records[i - 1].qpc) ||
+				std::to_string(nextIndexes[record.threadId]) != record.data)
+			{
+				isOrdered = false;
+			}
+			++nextIndexes[record.threadId];
+		}
+	}
+
+	for (auto& producer : producers)
+	{
+		producer.join();
+	}
+
+	CHECK(isOrdered);
+	for (unsigned int i = 0; i < producerCount; ++i)
+	{
+		CHECK_EQUAL(recordCount, nextIndexes[i]);
+		CHECK(buffers[i]->isEmpty());
+	}
+}
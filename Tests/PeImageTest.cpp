@@ -0,0 +1,242 @@
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Common/PeImage.h"
+#include "Test.h"
+
+namespace
+{
+	const std::uint32_t TIME_DATE_STAMP = 0x12345678;
+	const std::size_t NT_HEADERS = 0x40;
+	const std::size_t IMPORT_DIRECTORY = 0x200;
+
+	struct FixtureImport
+	{
+		std::string moduleName;
+		std::vector<std::string> procNames;
+	};
+
+	// Builds a PE image in its mapped layout with only the headers and the import directory that the parser reads.
+	// Empty proc names are imported by ordinal.
+	class PeFixture
+	{
+	public:
+		PeFixture(bool isPe32Plus, const std::vector<FixtureImport>& imports)
+			: m_thunkSize(isPe32Plus ? 8 : 4)
+		{
+			write<std::uint16_t>(0, 0x5A4D);
+			write<std::uint32_t>(0x3C, NT_HEADERS);
+			write<std::uint32_t>(NT_HEADERS, 0x00004550);
+			write<std::uint16_t>(NT_HEADERS + 4, isPe32Plus ? 0x8664 : 0x14C);
+			write<std::uint32_t>(NT_HEADERS + 8, TIME_DATE_STAMP);
+
+			const std::size_t optionalHeader = NT_HEADERS + 24;
+			const std::size_t rvaCount = optionalHeader + (isPe32Plus ? 108 : 92);
+			write<std::uint16_t>(optionalHeader, isPe32Plus ? 0x20B : 0x10B);
+			write<std::uint32_t>(rvaCount, 16);
+			write<std::uint32_t>(rvaCount + 4 + 8, IMPORT_DIRECTORY);
+			write<std::uint32_t>(rvaCount + 4 + 12, static_cast<std::uint32_t>((imports.size() + 1) * 20));
+
+			std::size_t next = IMPORT_DIRECTORY + (imports.size() + 1) * 20;
+			for (std::size_t i = 0; i < imports.size(); ++i)
+			{
+				const auto& import = imports[i];
+				const std::size_t lookupTable = next;
+				const std::size_t iat = lookupTable + (import.procNames.size() + 1) * m_thunkSize;
+				next = iat + (import.procNames.size() + 1) * m_thunkSize;
+
+				const std::size_t desc = IMPORT_DIRECTORY + i * 20;
+				write<std::uint32_t>(desc, static_cast<std::uint32_t>(lookupTable));
+				write<std::uint32_t>(desc + 12, static_cast<std::uint32_t>(next));
+				write<std::uint32_t>(desc + 16, static_cast<std::uint32_t>(iat));
+				next = writeString(next, import.moduleName);
+
+				for (std::size_t j = 0; j < import.procNames.size(); ++j)
+				{
+					std::uint64_t thunk = 0;
+					if (import.procNames[j].empty())
+					{
+						thunk = (1ull << (m_thunkSize * 8 - 1)) | (j + 1);
+					}
+					else
+					{
+						thunk = next;
+						write<std::uint16_t>(next, static_cast<std::uint16_t>(j));
+						next = writeString(next + 2, import.procNames[j]);
+					}
+					writeThunk(lookupTable + j * m_thunkSize, thunk);
+					writeThunk(iat + j * m_thunkSize, thunk);
+					m_iatOffsets.push_back(iat + j * m_thunkSize);
+				}
+			}
+			m_image.resize(next);
+		}
+
+		const std::vector<unsigned char>& getImage() const { return m_image; }
+		// Returns the IAT offsets of all procs in the order they were added
+		const std::vector<std::size_t>& getIatOffsets() const { return m_iatOffsets; }
+
+	private:
+		template <typename T>
+		void write(std::size_t offset, T value)
+		{
+			if (m_image.size() < offset + sizeof(value))
+			{
+				m_image.resize(offset + sizeof(value));
+			}
+			std::memcpy(&m_image[offset], &value, sizeof(value));
+		}
+
+		void writeThunk(std::size_t offset, std::uint64_t value)
+		{
+			if (4 == m_thunkSize)
+			{
+				write(offset, static_cast<std::uint32_t>(value));
+			}
+			else
+			{
+				write(offset, value);
+			}
+		}
+
+		std::size_t writeString(std::size_t offset, const std::string& str)
+		{
+			for (char c : str)
+			{
+				write(offset++, c);
+			}
+			write(offset++, '\0');
+			return offset;
+		}
+
+		std::size_t m_thunkSize;
+		std::vector<unsigned char> m_image;
+		std::vector<std::size_t> m_iatOffsets;
+	};
+
+	const std::vector<FixtureImport> FIXTURE_IMPORTS = {
+		{ "KERNEL32.dll", { "GetProcAddress", "", "LoadLibraryA" } },
+		{ "ddraw.dll", { "DirectDrawCreateEx", "DirectDrawCreate" } },
+		{ "USER32.dll", { "ChangeDisplaySettingsA", "", "EnumDisplaySettingsA" } }
+	};
+
+	void checkImports(bool isPe32Plus)
+	{
+		const PeFixture fixture(isPe32Plus, FIXTURE_IMPORTS);
+		const Compat::PeImage image(fixture.getImage().data(), fixture.getImage().size());
+		const auto& iat = fixture.getIatOffsets();
+
+		CHECK(image.isValid());
+		CHECK_EQUAL(TIME_DATE_STAMP, image.getTimeDateStamp());
+		CHECK_EQUAL(fixture.getImage().size(), image.getSize());
+
+		CHECK_EQUAL(iat[0], image.findImport("kernel32.dll", "GetProcAddress"));
+		CHECK_EQUAL(iat[2], image.findImport("KERNEL32.DLL", "LoadLibraryA"));
+		CHECK_EQUAL(iat[4], image.findImport("ddraw.dll", "DirectDrawCreate"));
+		CHECK_EQUAL(iat[7], image.findImport("user32.dll", "EnumDisplaySettingsA"));
+		CHECK_EQUAL(0u, image.findImport("user32.dll", "GetProcAddress"));
+		CHECK_EQUAL(0u, image.findImport("kernel32", "GetProcAddress"));
+		CHECK_EQUAL(0u, image.findImport("gdi32.dll", "BitBlt"));
+		CHECK_EQUAL(0u, image.findImport(nullptr, "GetProcAddress"));
+
+		std::vector<std::size_t> iatOffsets;
+		image.findImports({
+			{ "ddraw.dll", "DirectDrawCreate" },
+			{ "USER32.dll", "ChangeDisplaySettingsA" },
+			{ "ddraw.dll", "DirectDrawCreateEx" },
+			{ "ddraw.dll", "DirectDrawEnumerateA" },
+			{ "kernel32.dll", "LoadLibraryA" },
+			{ nullptr, nullptr } }, iatOffsets);
+		CHECK_EQUAL(6u, iatOffsets.size());
+		CHECK_EQUAL(iat[4], iatOffsets[0]);
+		CHECK_EQUAL(iat[5], iatOffsets[1]);
+		CHECK_EQUAL(iat[3], iatOffsets[2]);
+		CHECK_EQUAL(0u, iatOffsets[3]);
+		CHECK_EQUAL(iat[2], iatOffsets[4]);
+		CHECK_EQUAL(0u, iatOffsets[5]);
+	}
+}
+
+TEST(peImageFindsImportsInPe32Image)
+{
+	checkImports(false);
+}
+
+TEST(peImageFindsImportsInPe32PlusImage)
+{
+	checkImports(true);
+}
+
+TEST(peImageRejectsInvalidHeaders)
+{
+	const PeFixture fixture(false, FIXTURE_IMPORTS);
+
+	auto image = fixture.getImage();
+	image[0] = 'X';
+	CHECK(!Compat::PeImage(image.data(), image.size()).isValid());
+
+	image = fixture.getImage();
+	image[0x40] = 'X';
+	CHECK(!Compat::PeImage(image.data(), image.size()).isValid());
+
+	CHECK(!Compat::PeImage(nullptr, 1000).isValid());
+	CHECK(!Compat::PeImage(image.data(), 0x3C).isValid());
+}
+
+TEST(peImageIgnoresEntriesOutsideTruncatedImage)
+{
+	// Cut the image in the middle of the strings of the last module
+	const PeFixture fixture(true, FIXTURE_IMPORTS);
+	const auto& iat = fixture.getIatOffsets();
+	const Compat::PeImage image(fixture.getImage().data(), fixture.getImage().size() - 5);
+
+	CHECK(image.isValid());
+	CHECK_EQUAL(iat[4], image.findImport("ddraw.dll", "DirectDrawCreate"));
+	CHECK_EQUAL(iat[5], image.findImport("user32.dll", "ChangeDisplaySettingsA"));
+	CHECK_EQUAL(0u, image.findImport("user32.dll", "EnumDisplaySettingsA"));
+}
+
+TEST(peImageResolvesImportsOfManyModules)
+{
+	// Simulates a process with hundreds of modules, most of which don't import the requested functions
+	std::vector<PeFixture> fixtures;
+	for (int i = 0; i < 500; ++i)
+	{
+		std::vector<FixtureImport> imports;
+		for (int j = 0; j < 20; ++j)
+		{
+			imports.push_back({ "module" + std::to_string(j) + ".dll",
+				{ "func1", "func2", "func3", "func4", "func5", "", "func6" } });
+		}
+		if (0 == i % 50)
+		{
+			imports.push_back(FIXTURE_IMPORTS[1]);
+		}
+		fixtures.emplace_back(0 != i % 2, imports);
+	}
+
+	const std::vector<Compat::PeImage::Import> imports = {
+		{ "ddraw.dll", "DirectDrawCreate" },
+		{ "ddraw.dll", "DirectDrawCreateEx" },
+		{ "kernel32.dll", "GetProcAddress" }
+	};
+
+	std::vector<std::size_t> iatOffsets;
+	unsigned foundCount = 0;
+	for (const auto& fixture : fixtures)
+	{
+		const Compat::PeImage image(fixture.getImage().data(), fixture.getImage().size());
+		image.findImports(imports, iatOffsets);
+		if (0 != iatOffsets[0])
+		{
+			const auto& iat = fixture.getIatOffsets();
+			CHECK_EQUAL(iat[iat.size() - 1], iatOffsets[0]);
+			CHECK_EQUAL(iat[iat.size() - 2], iatOffsets[1]);
+			++foundCount;
+		}
+		CHECK_EQUAL(0u, iatOffsets[2]);
+	}
+	CHECK_EQUAL(10u, foundCount);
+}
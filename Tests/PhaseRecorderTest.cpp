@@ -0,0 +1,124 @@
+#include <thread>
+
+#include "Common/PhaseRecorder.h"
+#include "Test.h"
+
+namespace
+{
+	using Compat::PhaseRecorder;
+
+	thread_local long long g_timeNs = 0;
+
+	long long getTimeNs()
+	{
+		return g_timeNs;
+	}
+}
+
+TEST(phaseRecorderBuildsNestedTree)
+{
+	PhaseRecorder recorder(&getTimeNs);
+	PhaseRecorder::Tree tree;
+
+	g_timeNs = 0;
+	recorder.begin("root");
+	recorder.countModuleScan();
+	g_timeNs = 1000000;
+	recorder.begin("first");
+	recorder.countHook();
+	recorder.countHook();
+	g_timeNs = 1500000;
+	CHECK(!recorder.end(tree));
+	recorder.begin("second");
+	recorder.countHook();
+	g_timeNs = 4000000;
+	CHECK(!recorder.end(tree));
+	CHECK(recorder.end(tree));
+
+	CHECK_EQUAL(3u, tree.size());
+	CHECK(-1 == tree[0].parent && 0 == tree[1].parent && 0 == tree[2].parent);
+	CHECK_EQUAL(3u, tree[0].hookCount);
+	CHECK_EQUAL(1u, tree[0].moduleScanCount);
+	CHECK_EQUAL(2u, tree[1].hookCount);
+	CHECK_EQUAL(0u, tree[1].moduleScanCount);
+
+	const auto lines = PhaseRecorder::formatText(tree);
+	CHECK_EQUAL(3u, lines.size());
+	CHECK(lines[0] == "root: 4.000 ms, 3 hooks, 1 modules scanned");
+	CHECK(lines[1] == "  first: 0.500 ms, 2 hooks");
+	CHECK(lines[2] == "  second: 2.500 ms, 1 hooks");
+
+	CHECK(PhaseRecorder::formatJson(tree) ==
+		"{\"name\":\"root\",\"ms\":4.000,\"hooks\":3,\"modulesScanned\":1,\"children\":["
+		"{\"name\":\"first\",\"ms\":0.500,\"hooks\":2,\"modulesScanned\":0,\"children\":[]},"
+		"{\"name\":\"second\",\"ms\":2.500,\"hooks\":1,\"modulesScanned\":0,\"children\":[]}]}");
+}
+
+TEST(laterRootPhaseKeepsEarlierTree)
+{
+	PhaseRecorder recorder(&getTimeNs);
+	PhaseRecorder::Tree tree;
+
+	recorder.begin("installHooks");
+	recorder.begin("DDraw");
+	recorder.countHook();
+	recorder.end(tree);
+	CHECK(recorder.end(tree));
+	CHECK(tree[0].name == "installHooks");
+
+	recorder.begin("Direct3d::installHooks");
+	CHECK(recorder.end(tree));
+	CHECK(tree[0].name == "Direct3d::installHooks");
+
+	const auto trees = recorder.getTrees();
+	CHECK_EQUAL(2u, trees.size());
+	CHECK_EQUAL(2u, trees[0].size());
+	CHECK_EQUAL(1u, trees[0][0].hookCount);
+	CHECK_EQUAL(1u, trees[1].size());
+}
+
+TEST(phaseRecorderIgnoresCountsOutsideOfPhases)
+{
+	PhaseRecorder recorder(&getTimeNs);
+	PhaseRecorder::Tree tree;
+
+	recorder.countHook();
+	recorder.countModuleScan();
+	CHECK(!recorder.end(tree));
+	CHECK(recorder.getTrees().empty());
+}
+
+TEST(phaseRecorderKeepsThreadsApart)
+{
+	PhaseRecorder recorder(&getTimeNs);
+	const unsigned int hookCount = 1000;
+
+	std::thread threads[4];
+	for (auto& thread : threads)
+	{
+		thread = std::thread([&]()
+		{
+			PhaseRecorder::Tree tree;
+			recorder.begin("root");
+			for (unsigned int i = 0; i < hookCount; ++i)
+			{
+				recorder.begin("child");
+				recorder.countHook();
+				recorder.end(tree);
+			}
+			recorder.end(tree);
+		});
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	const auto trees = recorder.getTrees();
+	CHECK_EQUAL(4u, trees.size());
+	for (const auto& tree : trees)
+	{
+		CHECK_EQUAL(hookCount + 1, tree.size());
+		CHECK_EQUAL(hookCount, tree[0].hookCount);
+	}
+}
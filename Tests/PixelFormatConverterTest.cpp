@@ -0,0 +1,213 @@
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Included directly to compare the SSE2 paths with the generic row converter in its anonymous namespace
+#include "DDraw/PixelFormatConverter.cpp"
+#include "Test.h"
+
+namespace
+{
+	DDPIXELFORMAT getPf(DWORD bitCount, DWORD rMask, DWORD gMask, DWORD bMask)
+	{
+		DDPIXELFORMAT pf = {};
+		pf.dwSize = sizeof(pf);
+		pf.dwFlags = DDPF_RGB;
+		pf.dwRGBBitCount = bitCount;
+		pf.dwRBitMask = rMask;
+		pf.dwGBitMask = gMask;
+		pf.dwBBitMask = bMask;
+		return pf;
+	}
+
+	const DDPIXELFORMAT RGB555 = getPf(16, 0x7C00, 0x03E0, 0x001F);
+	const DDPIXELFORMAT RGB565 = getPf(16, 0xF800, 0x07E0, 0x001F);
+	const DDPIXELFORMAT RGB888 = getPf(24, 0xFF0000, 0x00FF00, 0x0000FF);
+	const DDPIXELFORMAT XRGB8888 = getPf(32, 0xFF0000, 0x00FF00, 0x0000FF);
+	const DDPIXELFORMAT XBGR8888 = getPf(32, 0x0000FF, 0x00FF00, 0xFF0000);
+
+	// Converts a single row both with the public function, which selects the SSE2 path for these formats,
+	// and with the generic row converter, over the full row and over a rect with an odd offset and width
+	template <typename SrcPixel, int srcBytesPerPixel>
+	void checkConversionMatchesGeneric(const std::vector<SrcPixel>& src,
+		const DDPIXELFORMAT& srcPf, const DDPIXELFORMAT& dstPf)
+	{
+		const LONG width = static_cast<LONG>(src.size());
+		const RECT rects[] = { { 0, 0, width, 1 }, { 3, 0, width - 2, 1 } };
+		for (const RECT& rect : rects)
+		{
+			std::vector<DWORD> dst(src.size(), 0xCDCDCDCD);
+			std::vector<DWORD> expected(dst);
+
+			DDraw::PixelFormatConverter::convert(srcPf, { const_cast<SrcPixel*>(src.data()), width * srcBytesPerPixel },
+				dstPf, { dst.data(), width * 4 }, rect);
+			convertRow<srcBytesPerPixel, 4>(reinterpret_cast<const BYTE*>(src.data() + rect.left),
+				reinterpret_cast<BYTE*>(expected.data() + rect.left), rect.right - rect.left,
+				getKernel(srcPf, dstPf, nullptr));
+			CHECK(expected == dst);
+		}
+	}
+
+	std::vector<WORD> getAll16BitValues()
+	{
+		std::vector<WORD> values(0x10000);
+		for (DWORD i = 0; i < values.size(); ++i)
+		{
+			values[i] = static_cast<WORD>(i);
+		}
+		return values;
+	}
+}
+
+TEST(rgb565ToXrgb8888MatchesGenericConversion)
+{
+	checkConversionMatchesGeneric<WORD, 2>(getAll16BitValues(), RGB565, XRGB8888);
+}
+
+TEST(rgb555ToXrgb8888MatchesGenericConversion)
+{
+	checkConversionMatchesGeneric<WORD, 2>(getAll16BitValues(), RGB555, XRGB8888);
+}
+
+TEST(swapRedBlueMatchesGenericConversion)
+{
+	// Every 16 bit value appears both in the low and the high half of the pixels, with unused bits set
+	std::vector<DWORD> src(0x10000);
+	for (DWORD i = 0; i < src.size(); ++i)
+	{
+		src[i] = (i << 16) | (i ^ 0xA5C3);
+	}
+
+	checkConversionMatchesGeneric<DWORD, 4>(src, XRGB8888, XBGR8888);
+	checkConversionMatchesGeneric<DWORD, 4>(src, XBGR8888, XRGB8888);
+}
+
+TEST(rgb16ToXrgb8888ReplicatesBits)
+{
+	const std::vector<WORD> src = { 0xFFFF, 0x0000, 0xF800, 0x07E0, 0x001F, 0x0841, 0x8410, 0x4208, 0x7BEF };
+	std::vector<DWORD> dst(src.size());
+	DDraw::PixelFormatConverter::convert(RGB565, { const_cast<WORD*>(src.data()), static_cast<LONG>(src.size() * 2) },
+		XRGB8888, { dst.data(), static_cast<LONG>(dst.size() * 4) }, { 0, 0, static_cast<LONG>(src.size()), 1 });
+
+	CHECK_EQUAL(0xFFFFFFu, dst[0]);
+	CHECK_EQUAL(0x000000u, dst[1]);
+	CHECK_EQUAL(0xFF0000u, dst[2]);
+	CHECK_EQUAL(0x00FF00u, dst[3]);
+	CHECK_EQUAL(0x0000FFu, dst[4]);
+	CHECK_EQUAL(0x080808u, dst[5]);
+	CHECK_EQUAL(0x848284u, dst[6]);
+	CHECK_EQUAL(0x424142u, dst[7]);
+	CHECK_EQUAL(0x7B7D7Bu, dst[8]);
+}
+
+namespace
+{
+	DWORD getMaskShift(DWORD mask)
+	{
+		DWORD shift = 0;
+		while (!(mask & (1u << shift)))
+		{
+			++shift;
+		}
+		return shift;
+	}
+
+	DWORD getMaskBits(DWORD mask)
+	{
+		DWORD bits = 0;
+		for (mask >>= getMaskShift(mask); mask & 1; mask >>= 1)
+		{
+			++bits;
+		}
+		return bits;
+	}
+
+	// Widens a channel to 8 bits by repeating its bits, maps it through the table, and narrows it to the
+	// destination channel by dropping low bits
+	DWORD convertChannelReference(DWORD pixel, DWORD srcMask, DWORD dstMask, const BYTE* lut)
+	{
+		const DWORD srcBits = getMaskBits(srcMask);
+		const DWORD value = (pixel & srcMask) >> getMaskShift(srcMask);
+		DWORD wide = value;
+		DWORD wideBits = srcBits;
+		while (wideBits < 8)
+		{
+			wide = (wide << srcBits) | value;
+			wideBits += srcBits;
+		}
+		const DWORD mapped = lut[wide >> (wideBits - 8)];
+		return (mapped >> (8 - getMaskBits(dstMask))) << getMaskShift(dstMask);
+	}
+
+	DWORD convertPixelReference(DWORD pixel, const DDPIXELFORMAT& srcPf, const DDPIXELFORMAT& dstPf,
+		const DDraw::PixelFormatConverter::Lut& lut)
+	{
+		return convertChannelReference(pixel, srcPf.dwRBitMask, dstPf.dwRBitMask, lut.red) |
+			convertChannelReference(pixel, srcPf.dwGBitMask, dstPf.dwGBitMask, lut.green) |
+			convertChannelReference(pixel, srcPf.dwBBitMask, dstPf.dwBBitMask, lut.blue);
+	}
+
+	// Converts random pixels through a random gamma table, including over rects with odd offsets and widths
+	void checkLutConversionMatchesReference(const DDPIXELFORMAT& srcPf, const DDPIXELFORMAT& dstPf)
+	{
+		const LONG width = 37;
+		const LONG height = 5;
+		const DWORD srcBytesPerPixel = srcPf.dwRGBBitCount / 8;
+		const DWORD dstBytesPerPixel = dstPf.dwRGBBitCount / 8;
+
+		for (int i = 0; i < 20; ++i)
+		{
+			DDraw::PixelFormatConverter::Lut lut = {};
+			for (int j = 0; j < 256; ++j)
+			{
+				lut.red[j] = static_cast<BYTE>(std::rand());
+				lut.green[j] = static_cast<BYTE>(std::rand());
+				lut.blue[j] = static_cast<BYTE>(std::rand());
+			}
+
+			std::vector<BYTE> src(width * height * srcBytesPerPixel);
+			std::vector<BYTE> dst(width * height * dstBytesPerPixel);
+			for (auto& value : src)
+			{
+				value = static_cast<BYTE>(std::rand());
+			}
+			for (auto& value : dst)
+			{
+				value = static_cast<BYTE>(std::rand());
+			}
+
+			RECT rect = {};
+			rect.left = std::rand() % (width / 2);
+			rect.top = std::rand() % height;
+			rect.right = rect.left + 1 + std::rand() % (width - rect.left);
+			rect.bottom = rect.top + 1 + std::rand() % (height - rect.top);
+
+			std::vector<BYTE> expected(dst);
+			for (LONG y = rect.top; y < rect.bottom; ++y)
+			{
+				for (LONG x = rect.left; x < rect.right; ++x)
+				{
+					DWORD pixel = 0;
+					memcpy(&pixel, &src[(y * width + x) * srcBytesPerPixel], srcBytesPerPixel);
+					pixel = convertPixelReference(pixel, srcPf, dstPf, lut);
+					memcpy(&expected[(y * width + x) * dstBytesPerPixel], &pixel, dstBytesPerPixel);
+				}
+			}
+
+			DDraw::PixelFormatConverter::convert(srcPf, { src.data(), static_cast<LONG>(width * srcBytesPerPixel) },
+				dstPf, { dst.data(), static_cast<LONG>(width * dstBytesPerPixel) }, rect, &lut);
+			CHECK(expected == dst);
+		}
+	}
+}
+
+TEST(lutConversionMatchesReference)
+{
+	std::srand(1);
+	const DDPIXELFORMAT* srcPfs[] = { &RGB555, &RGB565, &RGB888, &XRGB8888, &XBGR8888 };
+	for (const DDPIXELFORMAT* srcPf : srcPfs)
+	{
+		checkLutConversionMatchesReference(*srcPf, XRGB8888);
+		checkLutConversionMatchesReference(*srcPf, RGB565);
+	}
+}
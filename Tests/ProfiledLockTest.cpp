@@ -0,0 +1,166 @@
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Common/ProfiledLock.h"
+#include "Test.h"
+
+namespace
+{
+	class MutexLockPolicy
+	{
+	public:
+		void lock() { m_mutex.lock(); }
+		void unlock() { m_mutex.unlock(); }
+
+		static long long getTimeNs()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		static unsigned long getThreadId()
+		{
+			return static_cast<unsigned long>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+		}
+
+	private:
+		std::recursive_mutex m_mutex;
+	};
+
+	// Like a critical section that has not been initialized yet, which must not be entered
+	class UninitializedLockPolicy
+	{
+	public:
+		UninitializedLockPolicy(std::atomic<int>& lockCount) : m_lockCount(lockCount) {}
+
+		void lock() { ++m_lockCount; }
+		void unlock() {}
+
+		static long long getTimeNs() { return 0; }
+		static unsigned long getThreadId() { return 0; }
+
+	private:
+		std::atomic<int>& m_lockCount;
+	};
+
+	typedef Compat::ProfiledLock<MutexLockPolicy> ProfiledMutex;
+	typedef Compat::ScopedProfiledLock<ProfiledMutex> ScopedProfiledMutex;
+
+	const char* const CALL_SITES[] = { "first", "second", "third" };
+	const unsigned int MAX_EVENTS = ProfiledMutex::MAX_EVENTS;
+}
+
+TEST(lockProfileReportsDoNotTakeTheWrappedLock)
+{
+	std::atomic<int> lockCount(0);
+	Compat::ProfiledLock<UninitializedLockPolicy> lock("uninitialized", true, lockCount);
+	CHECK(lock.getSiteStats().empty());
+	CHECK(lock.getEvents().empty());
+	CHECK_EQUAL(0, lockCount);
+}
+
+TEST(lockProfileReportsWhileWrappedLockIsHeld)
+{
+	ProfiledMutex lock("held", true);
+	std::atomic<bool> isLocked(false);
+	std::atomic<bool> isReleased(false);
+	std::thread holder([&]()
+	{
+		ScopedProfiledMutex scopedLock(lock, CALL_SITES[0]);
+		isLocked = true;
+		while (!isReleased)
+		{
+			std::this_thread::yield();
+		}
+	});
+
+	while (!isLocked)
+	{
+		std::this_thread::yield();
+	}
+	const auto sites = lock.getSiteStats();
+	isReleased = true;
+	holder.join();
+
+	CHECK_EQUAL(1u, sites.size());
+	CHECK_EQUAL(1u, sites[0].acquireCount);
+	CHECK_EQUAL(0u, sites[0].holdCount);
+	const auto sitesAfterRelease = lock.getSiteStats();
+	CHECK_EQUAL(1u, sitesAfterRelease[0].holdCount);
+}
+
+TEST(lockProfileStressTest)
+{
+	const unsigned int threadCount = 4;
+	const unsigned int iterationCount = 5000;
+	ProfiledMutex lock("stress", true);
+	unsigned long long counter = 0;
+	std::atomic<unsigned int> runningThreadCount(threadCount);
+
+	std::vector<std::thread> threads;
+	for (unsigned int i = 0; i < threadCount; ++i)
+	{
+		threads.emplace_back([&, i]()
+		{
+			for (unsigned int j = 0; j < iterationCount; ++j)
+			{
+				ScopedProfiledMutex outerLock(lock, CALL_SITES[(i + j) % 2]);
+				++counter;
+				if (0 == j % 5)
+				{
+					// Recursive acquisition, released after the outer one
+					auto innerId = lock.lock(CALL_SITES[2]);
+					outerLock.unlock();
+					lock.unlock(innerId);
+				}
+			}
+			--runningThreadCount;
+		});
+	}
+
+	bool isConsistent = true;
+	while (0 != runningThreadCount)
+	{
+		for (const auto& site : lock.getSiteStats())
+		{
+			if (site.holdCount > site.acquireCount || site.maxWaitNs < 0 || site.maxHoldNs < 0)
+			{
+				isConsistent = false;
+			}
+		}
+		if (lock.getEvents().size() > MAX_EVENTS)
+		{
+			isConsistent = false;
+		}
+	}
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	CHECK(isConsistent);
+	CHECK_EQUAL(threadCount * iterationCount, counter);
+
+	const auto sites = lock.getSiteStats();
+	CHECK_EQUAL(3u, sites.size());
+	unsigned long long acquireCount = 0;
+	for (const auto& site : sites)
+	{
+		CHECK_EQUAL(site.acquireCount, site.holdCount);
+		CHECK(site.totalHoldNs >= site.maxHoldNs);
+		acquireCount += site.acquireCount;
+	}
+	CHECK_EQUAL(threadCount * iterationCount * 6 / 5, acquireCount);
+
+	const auto events = lock.getEvents();
+	CHECK_EQUAL(MAX_EVENTS, events.size());
+	for (const auto& event : events)
+	{
+		CHECK(event.waitStartNs <= event.acquireNs && event.acquireNs <= event.releaseNs);
+	}
+}
@@ -0,0 +1,157 @@
+#include "Gdi/RenderingSession.h"
+#include "Test.h"
+
+namespace
+{
+	class FakeSurface : public Gdi::RenderingSession::Surface
+	{
+	public:
+		FakeSurface()
+			: lockCount(0)
+			, unlockCount(0)
+			, idleUnlockCount(0)
+			, flushCount(0)
+			, lastLockFlags(0)
+			, isLockFailing(false)
+		{
+		}
+
+		virtual bool lock(unsigned long lockFlags) override
+		{
+			if (isLockFailing)
+			{
+				return false;
+			}
+			++lockCount;
+			lastLockFlags = lockFlags;
+			return true;
+		}
+
+		virtual void unlock(bool isIdle) override
+		{
+			++unlockCount;
+			if (isIdle)
+			{
+				++idleUnlockCount;
+			}
+		}
+
+		virtual void flush() override
+		{
+			++flushCount;
+		}
+
+		int getLockDepth() const { return lockCount - unlockCount; }
+
+		int lockCount;
+		int unlockCount;
+		int idleUnlockCount;
+		int flushCount;
+		unsigned long lastLockFlags;
+		bool isLockFailing;
+	};
+
+	const unsigned long LOCK_READONLY = 0x10;
+}
+
+TEST(renderingWithoutIdleSessionUnlocksAtEnd)
+{
+	FakeSurface surface;
+	Gdi::RenderingSession session(surface);
+
+	CHECK(session.begin(0));
+	CHECK_EQUAL(1, surface.getLockDepth());
+	session.end(false);
+	CHECK_EQUAL(0, surface.getLockDepth());
+	CHECK_EQUAL(0, surface.idleUnlockCount);
+	CHECK(!session.isLocked());
+	CHECK(!session.isIdle());
+}
+
+TEST(idleSessionIsReusedWithoutRelocking)
+{
+	FakeSurface surface;
+	Gdi::RenderingSession session(surface);
+
+	for (int i = 0; i < 3; ++i)
+	{
+		CHECK(session.begin(0));
+		CHECK(!session.isIdle());
+		session.end(true);
+		CHECK(session.isIdle());
+		CHECK_EQUAL(1, surface.getLockDepth());
+	}
+
+	CHECK_EQUAL(1, surface.lockCount);
+	CHECK_EQUAL(3, surface.flushCount);
+
+	session.close();
+	CHECK_EQUAL(0, surface.getLockDepth());
+	CHECK_EQUAL(1, surface.idleUnlockCount);
+	CHECK(!session.isIdle());
+	CHECK(!session.isLocked());
+}
+
+TEST(closeHasNoEffectWhileRendering)
+{
+	FakeSurface surface;
+	Gdi::RenderingSession session(surface);
+
+	session.close();
+	CHECK_EQUAL(0, surface.unlockCount);
+
+	CHECK(session.begin(0));
+	session.close();
+	CHECK_EQUAL(1, surface.getLockDepth());
+	CHECK(session.isLocked());
+
+	session.end(false);
+	session.close();
+	CHECK_EQUAL(0, surface.getLockDepth());
+	CHECK_EQUAL(1, surface.unlockCount);
+}
+
+TEST(lockFlagsEndIdleSessionAndPreventNewOne)
+{
+	FakeSurface surface;
+	Gdi::RenderingSession session(surface);
+
+	CHECK(session.begin(0));
+	session.end(true);
+	CHECK(session.isIdle());
+
+	CHECK(session.begin(LOCK_READONLY));
+	CHECK_EQUAL(1, surface.idleUnlockCount);
+	CHECK_EQUAL(1, surface.getLockDepth());
+	CHECK_EQUAL(LOCK_READONLY, surface.lastLockFlags);
+
+	session.end(true);
+	CHECK(!session.isIdle());
+	CHECK_EQUAL(0, surface.getLockDepth());
+
+	CHECK(session.begin(0));
+	CHECK_EQUAL(3, surface.lockCount);
+	CHECK_EQUAL(0ul, surface.lastLockFlags);
+	session.end(false);
+	CHECK_EQUAL(0, surface.getLockDepth());
+}
+
+TEST(failedLockEndsIdleSession)
+{
+	FakeSurface surface;
+	Gdi::RenderingSession session(surface);
+
+	CHECK(session.begin(0));
+	session.end(true);
+
+	surface.isLockFailing = true;
+	CHECK(!session.begin(LOCK_READONLY));
+	CHECK(!session.isIdle());
+	CHECK(!session.isLocked());
+	CHECK_EQUAL(0, surface.getLockDepth());
+
+	session.end(true);
+	session.close();
+	CHECK_EQUAL(0, surface.getLockDepth());
+	CHECK_EQUAL(1, surface.flushCount);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+// Minimal subset of the Windows headers for compiling platform independent DDrawCompat sources in tests
+
+#include <cstdint>
+
+typedef std::uint8_t BYTE;
+typedef std::uint16_t WORD;
+typedef std::uint32_t DWORD;
+typedef std::int32_t LONG;
+typedef int BOOL;
+typedef unsigned int UINT;
+typedef float FLOAT;
+typedef std::uintptr_t UINT_PTR;
+typedef DWORD COLORREF;
+typedef void* HGDIOBJ;
+
+#define DCB_RESET 0x0001
+#define DCB_ACCUMULATE 0x0002
+#define DCB_SET (DCB_RESET | DCB_ACCUMULATE)
+
+#define GM_COMPATIBLE 1
+#define GM_ADVANCED 2
+
+#define SRCCOPY (DWORD)0x00CC0020
+#define SRCPAINT (DWORD)0x00EE0086
+#define SRCAND (DWORD)0x008800C6
+#define SRCINVERT (DWORD)0x00660046
+
+struct POINT
+{
+	LONG x;
+	LONG y;
+};
+
+struct SIZE
+{
+	LONG cx;
+	LONG cy;
+};
+
+struct XFORM
+{
+	FLOAT eM11;
+	FLOAT eM12;
+	FLOAT eM21;
+	FLOAT eM22;
+	FLOAT eDx;
+	FLOAT eDy;
+};
+
+struct RECT
+{
+	LONG left;
+	LONG top;
+	LONG right;
+	LONG bottom;
+};
+
+inline BOOL IsRectEmpty(const RECT* rect)
+{
+	return rect->left >= rect->right || rect->top >= rect->bottom;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+// Minimal subset of ddraw.h for compiling platform independent DDrawCompat sources in tests
+
+#include <Windows.h>
+
+#define MAKEFOURCC(ch0, ch1, ch2, ch3) \
+	(static_cast<DWORD>(static_cast<BYTE>(ch0)) | (static_cast<DWORD>(static_cast<BYTE>(ch1)) << 8) | \
+	(static_cast<DWORD>(static_cast<BYTE>(ch2)) << 16) | (static_cast<DWORD>(static_cast<BYTE>(ch3)) << 24))
+
+#define DDPF_ALPHAPIXELS 0x00000001l
+#define DDPF_FOURCC 0x00000004l
+#define DDPF_PALETTEINDEXED8 0x00000020l
+#define DDPF_RGB 0x00000040l
+
+struct DDCOLORKEY
+{
+	DWORD dwColorSpaceLowValue;
+	DWORD dwColorSpaceHighValue;
+};
+
+struct DDPIXELFORMAT
+{
+	DWORD dwSize;
+	DWORD dwFlags;
+	DWORD dwFourCC;
+	DWORD dwRGBBitCount;
+	DWORD dwRBitMask;
+	DWORD dwGBitMask;
+	DWORD dwBBitMask;
+	DWORD dwRGBAlphaBitMask;
+};
@@ -0,0 +1,112 @@
+#include "DDraw/Surfaces/SurfaceDescCache.h"
+#include "Test.h"
+
+namespace
+{
+	struct FakeDesc
+	{
+		unsigned long dwSize;
+		unsigned long dwWidth;
+		unsigned long dwHeight;
+		void* lpSurface;
+	};
+
+	typedef DDraw::SurfaceDescCache<FakeDesc> SurfaceDescCache;
+
+	const long DD_OK = 0;
+	const long DDERR_SURFACELOST = -1;
+
+	// Mimics the hooked surface methods, which refresh the cached description after successful calls
+	class FakeSurface
+	{
+	public:
+		FakeSurface() : desc(), restoreResult(DD_OK), getDescCount(0)
+		{
+			desc.dwWidth = 640;
+			desc.dwHeight = 480;
+			cache.update([this](FakeDesc& d) { getDesc(d); });
+		}
+
+		void getDesc(FakeDesc& d)
+		{
+			++getDescCount;
+			d.dwWidth = desc.dwWidth;
+			d.dwHeight = desc.dwHeight;
+			d.lpSurface = desc.lpSurface;
+		}
+
+		long restore()
+		{
+			return SurfaceDescCache::updateAfter(
+				[this]() { return restoreResult; },
+				[this]() { cache.update([this](FakeDesc& d) { getDesc(d); }); });
+		}
+
+		long setSurfaceDesc(const FakeDesc& newDesc)
+		{
+			return SurfaceDescCache::updateAfter(
+				[&]()
+				{
+					if (0 == newDesc.dwWidth)
+					{
+						return DDERR_SURFACELOST;
+					}
+					desc = newDesc;
+					return DD_OK;
+				},
+				[this]() { cache.update([this](FakeDesc& d) { getDesc(d); }); });
+		}
+
+		FakeDesc desc;
+		long restoreResult;
+		int getDescCount;
+		SurfaceDescCache cache;
+	};
+}
+
+TEST(surfaceDescIsCachedWithoutSurfacePointer)
+{
+	FakeSurface surface;
+	char memory[4] = {};
+	surface.desc.lpSurface = memory;
+	surface.cache.update([&](FakeDesc& d) { surface.getDesc(d); });
+
+	const FakeDesc& desc = surface.cache.get();
+	CHECK_EQUAL(sizeof(FakeDesc), desc.dwSize);
+	CHECK_EQUAL(640ul, desc.dwWidth);
+	CHECK(nullptr == desc.lpSurface);
+	CHECK_EQUAL(2, surface.getDescCount);
+}
+
+TEST(setSurfaceDescRefreshesCachedDescOnSuccess)
+{
+	FakeSurface surface;
+	char memory[4] = {};
+	FakeDesc newDesc = { sizeof(FakeDesc), 320, 200, memory };
+	CHECK_EQUAL(DD_OK, surface.setSurfaceDesc(newDesc));
+	CHECK_EQUAL(320ul, surface.cache.get().dwWidth);
+	CHECK_EQUAL(200ul, surface.cache.get().dwHeight);
+	CHECK(nullptr == surface.cache.get().lpSurface);
+	CHECK_EQUAL(2, surface.getDescCount);
+
+	newDesc.dwWidth = 0;
+	CHECK_EQUAL(DDERR_SURFACELOST, surface.setSurfaceDesc(newDesc));
+	CHECK_EQUAL(320ul, surface.cache.get().dwWidth);
+	CHECK_EQUAL(2, surface.getDescCount);
+}
+
+TEST(restoreRefreshesCachedDescOnSuccess)
+{
+	FakeSurface surface;
+	// Like a surface recreated by the driver after a display mode change
+	surface.desc.dwWidth = 800;
+	surface.restoreResult = DDERR_SURFACELOST;
+	CHECK_EQUAL(DDERR_SURFACELOST, surface.restore());
+	CHECK_EQUAL(640ul, surface.cache.get().dwWidth);
+	CHECK_EQUAL(1, surface.getDescCount);
+
+	surface.restoreResult = DD_OK;
+	CHECK_EQUAL(DD_OK, surface.restore());
+	CHECK_EQUAL(800ul, surface.cache.get().dwWidth);
+	CHECK_EQUAL(2, surface.getDescCount);
+}
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <vector>
+
+#include "DDraw/SurfacePool.h"
+#include "Test.h"
+
+namespace
+{
+	struct FakeSurface
+	{
+		int id;
+		bool isLost;
+	};
+
+	typedef DDraw::SurfacePool<int, FakeSurface> SurfacePool;
+
+	class FakeOwner : public SurfacePool::Owner
+	{
+	public:
+		virtual bool restore(FakeSurface& surface) override
+		{
+			return !surface.isLost;
+		}
+
+		virtual void release(FakeSurface& surface) override
+		{
+			releasedIds.push_back(surface.id);
+		}
+
+		bool isReleased(int id) const
+		{
+			return std::find(releasedIds.begin(), releasedIds.end(), id) != releasedIds.end();
+		}
+
+		std::vector<int> releasedIds;
+	};
+
+	const unsigned long long BUDGET = 1000;
+}
+
+TEST(surfacePoolReturnsMostRecentSurfaceWithSameKey)
+{
+	FakeOwner owner;
+	SurfacePool pool(owner, BUDGET);
+	pool.put(1, { 10, false }, 100);
+	pool.put(2, { 20, false }, 100);
+	pool.put(1, { 11, false }, 100);
+
+	FakeSurface surface = {};
+	CHECK(!pool.get(3, surface));
+	CHECK(pool.get(1, surface));
+	CHECK_EQUAL(11, surface.id);
+	CHECK(pool.get(1, surface));
+	CHECK_EQUAL(10, surface.id);
+	CHECK(!pool.get(1, surface));
+
+	CHECK_EQUAL(1u, pool.getSurfaceCount());
+	CHECK_EQUAL(100ull, pool.getPooledSize());
+	CHECK(owner.releasedIds.empty());
+}
+
+TEST(surfacePoolEvictsLeastRecentlyPooledSurfacesOverBudget)
+{
+	FakeOwner owner;
+	SurfacePool pool(owner, BUDGET);
+	pool.put(1, { 10, false }, 400);
+	pool.put(2, { 20, false }, 400);
+	FakeSurface surface = {};
+	CHECK(pool.get(1, surface));
+	pool.put(1, surface, 400);
+
+	// Surface 20 is now the least recently pooled one
+	pool.put(3, { 30, false }, 400);
+	CHECK_EQUAL(1ull, pool.getEvictionCount());
+	CHECK(owner.isReleased(20));
+	CHECK(!pool.get(2, surface));
+	CHECK_EQUAL(800ull, pool.getPooledSize());
+
+	// A surface larger than the whole budget evicts everything, including itself
+	pool.put(4, { 40, false }, 1200);
+	CHECK_EQUAL(4ull, pool.getEvictionCount());
+	CHECK_EQUAL(0u, pool.getSurfaceCount());
+	CHECK_EQUAL(0ull, pool.getPooledSize());
+	CHECK(owner.isReleased(40));
+}
+
+TEST(surfacePoolReleasesLostSurfaces)
+{
+	FakeOwner owner;
+	SurfacePool pool(owner, BUDGET);
+	pool.put(1, { 10, false }, 100);
+	pool.put(1, { 11, true }, 100);
+	pool.put(2, { 20, true }, 100);
+
+	FakeSurface surface = {};
+	CHECK(pool.get(1, surface));
+	CHECK_EQUAL(10, surface.id);
+	CHECK(owner.isReleased(11));
+
+	CHECK(!pool.get(2, surface));
+	CHECK(owner.isReleased(20));
+	CHECK_EQUAL(0u, pool.getSurfaceCount());
+	CHECK_EQUAL(0ull, pool.getPooledSize());
+	CHECK_EQUAL(0ull, pool.getEvictionCount());
+}
+
+TEST(surfacePoolReleasesMatchingKeysOnly)
+{
+	FakeOwner owner;
+	SurfacePool pool(owner, BUDGET);
+	pool.put(1, { 10, false }, 100);
+	pool.put(2, { 20, false }, 100);
+	pool.put(3, { 30, false }, 100);
+
+	pool.releaseIf([](int key) { return 1 != key; });
+	CHECK_EQUAL(2u, owner.releasedIds.size());
+	CHECK_EQUAL(100ull, pool.getPooledSize());
+	CHECK_EQUAL(0ull, pool.getEvictionCount());
+
+	FakeSurface surface = {};
+	CHECK(pool.get(1, surface));
+	CHECK(!pool.get(3, surface));
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+
+// Minimal test framework for the platform independent parts of DDrawCompat
+
+namespace Test
+{
+	typedef void(*TestFunc)();
+
+	class Registrar
+	{
+	public:
+		Registrar(const char* name, TestFunc func);
+	};
+
+	void fail(const char* file, int line, const std::string& message);
+}
+
+#define TEST(name) \
+	static void name(); \
+	static Test::Registrar name##Registrar(#name, &name); \
+	static void name()
+
+#define CHECK(expr) \
+	do \
+	{ \
+		if (!(expr)) \
+		{ \
+			Test::fail(__FILE__, __LINE__, #expr); \
+			return; \
+		} \
+	} while (false)
+
+#define CHECK_EQUAL(expected, actual) \
+	do \
+	{ \
+		const auto& checkExpected = (expected); \
+		const auto& checkActual = (actual); \
+		if (!(checkExpected == checkActual)) \
+		{ \
+			std::ostringstream checkOs; \
+			checkOs << #actual << " is " << +checkActual << ", expected " << +checkExpected; \
+			Test::fail(__FILE__, __LINE__, checkOs.str()); \
+			return; \
+		} \
+	} while (false)
@@ -0,0 +1,110 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Common/TraceFormat.h"
+#include "Test.h"
+
+namespace
+{
+	using namespace Compat::Trace;
+
+	const std::int64_t QPC_FREQUENCY = 1000000;
+	// 12:34:56.000 on any day, in 100 ns units
+	const std::uint64_t FILE_TIME_BASE = (12 * 3600 + 34 * 60 + 56) * 10000000ULL;
+
+	struct TestStruct
+	{
+		std::uint32_t size;
+		std::uint32_t flags;
+		std::uint8_t bytes[2];
+	};
+
+	std::vector<unsigned char> createTrace()
+	{
+		FileHeader header = {};
+		header.pointerSize = 4;
+		header.qpcFrequency = QPC_FREQUENCY;
+		header.qpcBase = 0;
+		header.fileTimeBase = FILE_TIME_BASE;
+
+		std::vector<unsigned char> trace;
+		writeFileHeader(trace, header);
+		writeName(trace, 0, "Blt");
+
+		const TestStruct ts = { 12, 0x1007, { 0xAB, 0xCD } };
+		const std::int32_t rect[4] = { 1, 2, 3, 4 };
+
+		EventWriter enter;
+		enter.addInt(-5);
+		enter.addHex(0x10);
+		enter.addObjectPointer(0x1234);
+		enter.addStructPointer(0x2000, &ts, 8);
+		enter.addStructPointer(0x3000, nullptr, 8);
+		enter.addStruct(&ts, 10);
+		enter.addRectPointer(0x4000, rect);
+		writeEvent(trace, RecordType::ENTER, 0, 7, 1500, enter.getArgs().data(),
+			static_cast<std::uint32_t>(enter.getArgs().size()));
+
+		EventWriter leave;
+		leave.addString("a\"b");
+		leave.beginResult();
+		leave.addUInt(0x8876017C);
+		writeEvent(trace, RecordType::LEAVE, 0, 7, 2500, leave.getArgs().data(),
+			static_cast<std::uint32_t>(leave.getArgs().size()));
+		return trace;
+	}
+}
+
+TEST(traceStructArgsAreDecodedAsText)
+{
+	TraceData trace = {};
+	CHECK(decode(createTrace(), trace));
+	CHECK_EQUAL(2u, trace.events.size());
+
+	const Arg& structPointer = trace.events[0].args[3];
+	CHECK(ArgType::STRUCT_POINTER == structPointer.type);
+	CHECK_EQUAL(0x2000u, structPointer.value);
+	CHECK_EQUAL(8u, structPointer.str.size());
+	CHECK(trace.events[0].args[4].isNull);
+	CHECK_EQUAL(10u, trace.events[0].args[5].str.size());
+
+	CHECK(formatText(trace.header, trace.events[0]) ==
+		"7 12:34:56.001 --> Blt(-5, 0x10, 00001234, {0000000C,00001007}, null, {0000000C,00001007,AB,CD}, "
+		"{1,2,3,4})");
+	CHECK(formatText(trace.header, trace.events[1]) ==
+		"7 12:34:56.002 <-- Blt(a\"b) = 8876017c");
+}
+
+TEST(traceStructArgsAreDecodedAsChromeJson)
+{
+	TraceData trace = {};
+	CHECK(decode(createTrace(), trace));
+	CHECK(formatChromeJson(trace) ==
+		"{\"traceEvents\":["
+		"\n{\"name\":\"Blt\",\"ph\":\"B\",\"ts\":1500,\"pid\":0,\"tid\":7,\"args\":{\"params\":"
+		"\"-5, 0x10, 00001234, {0000000C,00001007}, null, {0000000C,00001007,AB,CD}, {1,2,3,4}\"}},"
+		"\n{\"name\":\"Blt\",\"ph\":\"E\",\"ts\":2500,\"pid\":0,\"tid\":7,\"args\":{\"params\":"
+		"\"a\\\"b\",\"result\":\"8876017c\"}}"
+		"\n],\"displayTimeUnit\":\"ms\"}\n");
+}
+
+TEST(truncatedStructArgFailsToDecode)
+{
+	auto data = createTrace();
+	data.resize(data.size() - 20);
+	TraceData trace = {};
+	CHECK(!decode(data, trace));
+	CHECK_EQUAL(1u, trace.events.size());
+}
+
+TEST(version1TraceIsDecoded)
+{
+	auto data = createTrace();
+	data[8] = 1;
+	TraceData trace = {};
+	CHECK(decode(data, trace));
+
+	data[8] = 3;
+	CHECK(!decode(data, trace));
+}
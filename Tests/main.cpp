@@ -0,0 +1,48 @@
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "Test.h"
+
+namespace
+{
+	std::vector<std::pair<const char*, Test::TestFunc>>& getTests()
+	{
+		static std::vector<std::pair<const char*, Test::TestFunc>> tests;
+		return tests;
+	}
+
+	bool g_isFailed = false;
+}
+
+namespace Test
+{
+	Registrar::Registrar(const char* name, TestFunc func)
+	{
+		getTests().push_back({ name, func });
+	}
+
+	void fail(const char* file, int line, const std::string& message)
+	{
+		std::cout << file << '(' << line << "): " << message << std::endl;
+		g_isFailed = true;
+	}
+}
+
+int main()
+{
+	unsigned int failedCount = 0;
+	for (const auto& test : getTests())
+	{
+		g_isFailed = false;
+		test.second();
+		std::cout << (g_isFailed ? "FAILED " : "passed ") << test.first << std::endl;
+		if (g_isFailed)
+		{
+			++failedCount;
+		}
+	}
+
+	std::cout << getTests().size() - failedCount << " of " << getTests().size() << " tests passed" << std::endl;
+	return 0 == failedCount ? 0 : 1;
+}
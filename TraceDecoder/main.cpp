@@ -0,0 +1,48 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "Common/TraceFormat.h"
+
+int main(int argc, char* argv[])
+{
+	const bool isJson = argc == 3 && 0 == std::strcmp(argv[1], "--json");
+	if (argc != 2 && !isJson)
+	{
+		std::cerr << "Usage: TraceDecoder [--json] ddraw.trace" << std::endl;
+		return 1;
+	}
+
+	std::ifstream file(argv[argc - 1], std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Failed to open " << argv[argc - 1] << std::endl;
+		return 1;
+	}
+
+	const std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	Compat::Trace::TraceData trace = {};
+	const bool isValid = Compat::Trace::decode(data, trace);
+
+	if (isJson)
+	{
+		std::cout << Compat::Trace::formatChromeJson(trace);
+	}
+	else
+	{
+		for (const auto& event : trace.events)
+		{
+			std::cout << Compat::Trace::formatText(trace.header, event) << '\n';
+		}
+	}
+
+	if (!isValid)
+	{
+		std::cerr << "Warning: the trace is truncated or corrupt, decoded " << trace.events.size() << " events"
+			<< std::endl;
+		return 2;
+	}
+	return 0;
+}